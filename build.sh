@@ -1,14 +1,30 @@
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/start.c -o start.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/kernel.c -o kernel.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/multiboot.c -o multiboot.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/screen.c -o screen.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/region.c -o region.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/blit.c -o blit.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/glyph.c -o glyph.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/raster.c -o raster.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/opengl.c -o opengl.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/console.c -o console.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/widget.c -o widget.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/frame.c -o frame.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/text_output.c -o text_output.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/bga.c -o bga.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/gpu.c -o gpu.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/keyboard/keyboard.c -o keyboard.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/lib/string.c -o string.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/lib/memory.c -o memory.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/lib/cpu.c -o cpu.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/lib/matrix.c -o matrix.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/lib/format.c -o format.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/lib/pages.c -o pages.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/lib/error_handler.c -o error_handler.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/shell/shell.c -o shell.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/shell/commands.c -o commands.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/fs/disk.c -o disk.o
+gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/fs/block_queue.c -o block_queue.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/fs/fat16.c -o fat16.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/tools/hexedit.c -o hexedit.o
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/game/snake/snake.c -o snake.o
@@ -19,9 +35,9 @@ gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c s
 gcc -m32 -ffreestanding -fno-pie -nostdlib -fno-stack-protector -O1 -I./src -c src/drivers/usb/usb_driver.c -o usb_driver.o
 # Создаем ELF-файл сначала
 ld -m elf_i386 -T linker.ld -o kernel.elf \
-    start.o kernel.o screen.o text_output.o keyboard.o string.o memory.o error_handler.o \
+    start.o kernel.o multiboot.o screen.o region.o blit.o glyph.o raster.o opengl.o console.o widget.o frame.o text_output.o bga.o gpu.o keyboard.o string.o memory.o cpu.o matrix.o format.o pages.o error_handler.o \
     shell.o commands.o \
-    disk.o fat16.o \
+    disk.o block_queue.o fat16.o \
     hexedit.o \
     snake.o tetris.o \
     pci.o wifi.o ax210.o usb_driver.o
@@ -41,6 +57,10 @@ fi
 
 mkdir -p iso/boot/grub
 cp kernel.bin iso/boot/
+# FAT16 образ диска (необязательно), подключается как Multiboot модуль
+if [ -f disk.img ]; then
+    cp disk.img iso/boot/
+fi
 mkdir -p iso/EFI/BOOT
 
 # Создаем UEFI загрузочный файл
@@ -67,6 +87,13 @@ menuentry "PureC OS (Multiboot2)" {
     boot
 }
 
+menuentry "PureC OS (Multiboot + disk image)" {
+    echo "Loading PureC OS kernel with /boot/disk.img..."
+    multiboot /boot/kernel.bin
+    module /boot/disk.img disk
+    boot
+}
+
 menuentry "PureC OS (Multiboot)" {
     echo "Loading PureC OS kernel with Multiboot..."
     multiboot /boot/kernel.bin
@@ -0,0 +1,175 @@
+// drivers/bga.c - Bochs Graphics Adapter (QEMU -vga std, VBE DISPI)
+#include "bga.h"
+#include "pci/pci.h"
+#include "text_output.h"
+
+#define VBE_DISPI_IOPORT_INDEX 0x01CE
+#define VBE_DISPI_IOPORT_DATA  0x01CF
+
+#define VBE_DISPI_INDEX_ID              0x0
+#define VBE_DISPI_INDEX_XRES            0x1
+#define VBE_DISPI_INDEX_YRES            0x2
+#define VBE_DISPI_INDEX_BPP             0x3
+#define VBE_DISPI_INDEX_ENABLE          0x4
+#define VBE_DISPI_INDEX_BANK            0x5
+#define VBE_DISPI_INDEX_VIRT_WIDTH      0x6
+#define VBE_DISPI_INDEX_VIRT_HEIGHT     0x7
+#define VBE_DISPI_INDEX_X_OFFSET        0x8
+#define VBE_DISPI_INDEX_Y_OFFSET        0x9
+#define VBE_DISPI_INDEX_VIDEO_MEMORY_64K 0xA
+
+#define VBE_DISPI_ID0 0xB0C0
+#define VBE_DISPI_ID4 0xB0C4
+#define VBE_DISPI_ID5 0xB0C5
+
+#define VBE_DISPI_DISABLED    0x00
+#define VBE_DISPI_ENABLED     0x01
+#define VBE_DISPI_GETCAPS     0x02
+#define VBE_DISPI_LFB_ENABLED 0x40
+
+// Старые версии адаптера не сообщают объем памяти
+#define BGA_DEFAULT_VRAM (4 * 1024 * 1024)
+
+static pci_device_t bga_device;
+static int bga_present = 0;
+static uint8_t* bga_lfb = 0;
+static uint32_t bga_vram_size = 0;
+
+static int mode_height = 0;
+static int mode_pitch = 0;
+static int mode_pages = 0;
+static int display_page = 0;
+
+static inline void outw(uint16_t port, uint16_t value) {
+    asm volatile ("outw %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t ret;
+    asm volatile ("inw %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static void bga_write(uint16_t index, uint16_t value) {
+    outw(VBE_DISPI_IOPORT_INDEX, index);
+    outw(VBE_DISPI_IOPORT_DATA, value);
+}
+
+static uint16_t bga_read(uint16_t index) {
+    outw(VBE_DISPI_IOPORT_INDEX, index);
+    return inw(VBE_DISPI_IOPORT_DATA);
+}
+
+int bga_init(void) {
+    if (bga_present) return 1;
+    
+    if (!pci_find_device(BGA_VENDOR_ID, BGA_DEVICE_ID, &bga_device)) {
+        return 0;
+    }
+    
+    uint16_t id = bga_read(VBE_DISPI_INDEX_ID);
+    if (id < VBE_DISPI_ID0 || id > VBE_DISPI_ID5) {
+        printf("BGA: Unsupported DISPI version %X\n", id);
+        return 0;
+    }
+    
+    // BAR0 - линейный framebuffer (память, не порты)
+    uint32_t bar0 = bga_device.base_addresses[0];
+    if ((bar0 & 1) || (bar0 & 0xFFFFFFF0) == 0) {
+        printf("BGA: BAR0 is not a memory region\n");
+        return 0;
+    }
+    bga_lfb = (uint8_t*)(bar0 & 0xFFFFFFF0);
+    
+    // Включаем декодирование памяти в регистре команд PCI
+    uint32_t command = pci_read_config(bga_device.bus, bga_device.slot, bga_device.func, 0x04);
+    pci_write_config(bga_device.bus, bga_device.slot, bga_device.func, 0x04, command | 0x02);
+    
+    bga_vram_size = BGA_DEFAULT_VRAM;
+    if (id >= VBE_DISPI_ID4) {
+        bga_vram_size = (uint32_t)bga_read(VBE_DISPI_INDEX_VIDEO_MEMORY_64K) * 65536;
+    }
+    
+    bga_present = 1;
+    printf("BGA: DISPI %X, LFB at 0x%x, %d KB video memory\n", id, (uint32_t)bga_lfb, bga_vram_size / 1024);
+    return 1;
+}
+
+int bga_available(void) {
+    return bga_present;
+}
+
+int bga_get_max_resolution(int* width, int* height) {
+    if (!bga_present) return 0;
+    
+    // С флагом GETCAPS регистры разрешения возвращают максимальные значения
+    uint16_t enable = bga_read(VBE_DISPI_INDEX_ENABLE);
+    bga_write(VBE_DISPI_INDEX_ENABLE, enable | VBE_DISPI_GETCAPS);
+    *width = bga_read(VBE_DISPI_INDEX_XRES);
+    *height = bga_read(VBE_DISPI_INDEX_YRES);
+    bga_write(VBE_DISPI_INDEX_ENABLE, enable);
+    return 1;
+}
+
+int bga_set_mode(int width, int height, int bpp) {
+    if (!bga_present) return 0;
+    if (bpp != 15 && bpp != 16 && bpp != 24 && bpp != 32) return 0;
+    
+    int max_width, max_height;
+    bga_get_max_resolution(&max_width, &max_height);
+    if (width <= 0 || height <= 0 || width > max_width || height > max_height) return 0;
+    
+    int bytes = (bpp + 7) / 8;
+    if ((uint32_t)width * bytes * height > bga_vram_size) return 0;
+    
+    bga_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_DISABLED);
+    bga_write(VBE_DISPI_INDEX_XRES, width);
+    bga_write(VBE_DISPI_INDEX_YRES, height);
+    bga_write(VBE_DISPI_INDEX_BPP, bpp);
+    bga_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_ENABLED | VBE_DISPI_LFB_ENABLED);
+    
+    // Виртуальный экран выше видимого: вторая страница для переключения
+    bga_write(VBE_DISPI_INDEX_VIRT_WIDTH, width);
+    bga_write(VBE_DISPI_INDEX_VIRT_HEIGHT, height * BGA_MAX_PAGES);
+    bga_write(VBE_DISPI_INDEX_X_OFFSET, 0);
+    bga_write(VBE_DISPI_INDEX_Y_OFFSET, 0);
+    
+    if (bga_read(VBE_DISPI_INDEX_XRES) != width || bga_read(VBE_DISPI_INDEX_YRES) != height ||
+        bga_read(VBE_DISPI_INDEX_BPP) != bpp) {
+        printf("BGA: Mode %dx%dx%d rejected by the adapter\n", width, height, bpp);
+        return 0;
+    }
+    
+    // Адаптер может выровнять строку и ограничить высоту объемом памяти
+    mode_pitch = bga_read(VBE_DISPI_INDEX_VIRT_WIDTH) * bytes;
+    mode_pages = bga_read(VBE_DISPI_INDEX_VIRT_HEIGHT) / height;
+    if (mode_pages > BGA_MAX_PAGES) mode_pages = BGA_MAX_PAGES;
+    if (mode_pages < 1) mode_pages = 1;
+    
+    mode_height = height;
+    display_page = 0;
+    return 1;
+}
+
+int bga_pitch(void) {
+    return mode_pitch;
+}
+
+int bga_page_count(void) {
+    return mode_pages;
+}
+
+uint8_t* bga_page_address(int page) {
+    if (page < 0 || page >= mode_pages) return 0;
+    return bga_lfb + page * mode_height * mode_pitch;
+}
+
+void bga_set_display_page(int page) {
+    if (!bga_present || page < 0 || page >= mode_pages) return;
+    bga_write(VBE_DISPI_INDEX_Y_OFFSET, page * mode_height);
+    display_page = page;
+}
+
+int bga_display_page(void) {
+    return display_page;
+}
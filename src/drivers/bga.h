@@ -0,0 +1,27 @@
+// drivers/bga.h - Bochs Graphics Adapter (QEMU -vga std, VBE DISPI)
+#ifndef BGA_H
+#define BGA_H
+
+#include <stdint.h>
+
+#define BGA_VENDOR_ID 0x1234
+#define BGA_DEVICE_ID 0x1111
+
+#define BGA_MAX_PAGES 2
+
+int bga_init(void);        // Поиск адаптера на шине PCI
+int bga_available(void);
+
+// Устанавливает режим; виртуальная высота вмещает до BGA_MAX_PAGES страниц
+int bga_set_mode(int width, int height, int bpp);
+int bga_get_max_resolution(int* width, int* height);
+
+int bga_pitch(void);       // Байт на строку
+int bga_page_count(void);
+uint8_t* bga_page_address(int page);
+
+// Переключение видимой страницы через Y_OFFSET
+void bga_set_display_page(int page);
+int bga_display_page(void);
+
+#endif
@@ -0,0 +1,339 @@
+// src/drivers/blit.c - Row kernels for fills, copies and alpha blending
+#include "blit.h"
+#include "text_output.h"
+#include "../lib/cpu.h"
+#include "../lib/string.h"
+
+// GCC vector types: the SSE intrinsic headers need a hosted libc
+typedef char v16qi __attribute__((vector_size(16)));
+typedef short v8hi __attribute__((vector_size(16)));
+typedef unsigned short v8hu __attribute__((vector_size(16)));
+typedef int v4si __attribute__((vector_size(16)));
+typedef int v4si_u __attribute__((vector_size(16), aligned(1), may_alias));
+
+typedef void (*fill_fn)(uint32_t* dst, uint32_t value, int count);
+typedef void (*blend_fn)(uint32_t* dst, const uint32_t* src, int count);
+
+// ==================== FILL ====================
+
+static void fill32_scalar(uint32_t* dst, uint32_t value, int count) {
+    for (int i = 0; i < count; i++) dst[i] = value;
+}
+
+static void fill32_rep(uint32_t* dst, uint32_t value, int count) {
+    unsigned long n = count;
+    asm volatile ("rep stosl" : "+D"(dst), "+c"(n) : "a"(value) : "memory");
+}
+
+__attribute__((target("sse2")))
+static void fill32_sse2(uint32_t* dst, uint32_t value, int count) {
+    // Align to 16 bytes, then two aligned stores per iteration
+    while (count > 0 && ((uintptr_t)dst & 15)) {
+        *dst++ = value;
+        count--;
+    }
+
+    v4si v = {(int)value, (int)value, (int)value, (int)value};
+    for (; count >= 8; count -= 8, dst += 8) {
+        ((v4si*)dst)[0] = v;
+        ((v4si*)dst)[1] = v;
+    }
+    for (int i = 0; i < count; i++) dst[i] = value;
+}
+
+// ==================== BLEND ====================
+
+static void blend32_scalar(uint32_t* dst, const uint32_t* src, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t color = src[i];
+        uint32_t alpha = color >> 24;
+        if (alpha == 0xFF) {
+            dst[i] = color;
+        } else if (alpha) {
+            dst[i] = blit_blend_argb(color, dst[i]);
+        }
+    }
+}
+
+// Fully opaque or fully transparent groups of four skip the arithmetic
+#define BLEND_SHORTCUT(s, dst)                                      \
+    uint32_t all = (uint32_t)s[0] & s[1] & s[2] & s[3];             \
+    uint32_t any = (uint32_t)s[0] | s[1] | s[2] | s[3];             \
+    if (all >= 0xFF000000) {                                        \
+        *(v4si_u*)(dst) = s;                                        \
+        continue;                                                   \
+    }                                                               \
+    if (any < 0x01000000) continue;
+
+// Blends 8 16-bit channels: (s * a + d * (255 - a)) / 255, rounded
+#define BLEND_WORDS(s, d, a)                                        \
+    ({                                                              \
+        v8hu t = (v8hu)(s) * (v8hu)(a) + (v8hu)(d) * (c255 - (v8hu)(a)) + c128; \
+        (t + (t >> 8)) >> 8;                                        \
+    })
+
+__attribute__((target("sse2")))
+static void blend32_sse2(uint32_t* dst, const uint32_t* src, int count) {
+    const v16qi zero = {0};
+    const v8hu c128 = {128, 128, 128, 128, 128, 128, 128, 128};
+    const v8hu c255 = {255, 255, 255, 255, 255, 255, 255, 255};
+    const v4si opaque = {(int)0xFF000000, (int)0xFF000000, (int)0xFF000000, (int)0xFF000000};
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        v4si s = *(const v4si_u*)(src + i);
+        BLEND_SHORTCUT(s, dst + i)
+
+        v4si d = *(const v4si_u*)(dst + i);
+        v8hi s_lo = (v8hi)__builtin_ia32_punpcklbw128((v16qi)s, zero);
+        v8hi s_hi = (v8hi)__builtin_ia32_punpckhbw128((v16qi)s, zero);
+        v8hi d_lo = (v8hi)__builtin_ia32_punpcklbw128((v16qi)d, zero);
+        v8hi d_hi = (v8hi)__builtin_ia32_punpckhbw128((v16qi)d, zero);
+
+        // Broadcast each pixel's alpha word to its four channels
+        v8hi a_lo = __builtin_ia32_pshufhw(__builtin_ia32_pshuflw(s_lo, 0xFF), 0xFF);
+        v8hi a_hi = __builtin_ia32_pshufhw(__builtin_ia32_pshuflw(s_hi, 0xFF), 0xFF);
+
+        v8hu r_lo = BLEND_WORDS(s_lo, d_lo, a_lo);
+        v8hu r_hi = BLEND_WORDS(s_hi, d_hi, a_hi);
+        v4si r = (v4si)__builtin_ia32_packuswb128((v8hi)r_lo, (v8hi)r_hi);
+        *(v4si_u*)(dst + i) = r | opaque;
+    }
+    blend32_scalar(dst + i, src + i, count - i);
+}
+
+// SSSE3: pshufb widens the channels and spreads alpha in one step each
+__attribute__((target("ssse3")))
+static void blend32_ssse3(uint32_t* dst, const uint32_t* src, int count) {
+    const v16qi widen_lo = {0, -128, 1, -128, 2, -128, 3, -128, 4, -128, 5, -128, 6, -128, 7, -128};
+    const v16qi widen_hi = {8, -128, 9, -128, 10, -128, 11, -128, 12, -128, 13, -128, 14, -128, 15, -128};
+    const v16qi alpha_lo = {3, -128, 3, -128, 3, -128, 3, -128, 7, -128, 7, -128, 7, -128, 7, -128};
+    const v16qi alpha_hi = {11, -128, 11, -128, 11, -128, 11, -128, 15, -128, 15, -128, 15, -128, 15, -128};
+    const v8hu c128 = {128, 128, 128, 128, 128, 128, 128, 128};
+    const v8hu c255 = {255, 255, 255, 255, 255, 255, 255, 255};
+    const v4si opaque = {(int)0xFF000000, (int)0xFF000000, (int)0xFF000000, (int)0xFF000000};
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        v4si s = *(const v4si_u*)(src + i);
+        BLEND_SHORTCUT(s, dst + i)
+
+        v4si d = *(const v4si_u*)(dst + i);
+        v8hi s_lo = (v8hi)__builtin_ia32_pshufb128((v16qi)s, widen_lo);
+        v8hi s_hi = (v8hi)__builtin_ia32_pshufb128((v16qi)s, widen_hi);
+        v8hi d_lo = (v8hi)__builtin_ia32_pshufb128((v16qi)d, widen_lo);
+        v8hi d_hi = (v8hi)__builtin_ia32_pshufb128((v16qi)d, widen_hi);
+        v8hi a_lo = (v8hi)__builtin_ia32_pshufb128((v16qi)s, alpha_lo);
+        v8hi a_hi = (v8hi)__builtin_ia32_pshufb128((v16qi)s, alpha_hi);
+
+        v8hu r_lo = BLEND_WORDS(s_lo, d_lo, a_lo);
+        v8hu r_hi = BLEND_WORDS(s_hi, d_hi, a_hi);
+        v4si r = (v4si)__builtin_ia32_packuswb128((v8hi)r_lo, (v8hi)r_hi);
+        *(v4si_u*)(dst + i) = r | opaque;
+    }
+    blend32_scalar(dst + i, src + i, count - i);
+}
+
+static void blend32_premultiplied_scalar(uint32_t* dst, const uint32_t* src, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t color = src[i];
+        if ((color >> 24) == 0xFF) {
+            dst[i] = color;
+        } else if (color) {
+            dst[i] = blit_blend_premultiplied(color, dst[i]);
+        }
+    }
+}
+
+__attribute__((target("sse2")))
+static void blend32_premultiplied_sse2(uint32_t* dst, const uint32_t* src, int count) {
+    const v16qi zero = {0};
+    const v8hu c128 = {128, 128, 128, 128, 128, 128, 128, 128};
+    const v8hi c255 = {255, 255, 255, 255, 255, 255, 255, 255};
+    const v4si opaque = {(int)0xFF000000, (int)0xFF000000, (int)0xFF000000, (int)0xFF000000};
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        v4si s = *(const v4si_u*)(src + i);
+        uint32_t all = (uint32_t)s[0] & s[1] & s[2] & s[3];
+        if (all >= 0xFF000000) {
+            *(v4si_u*)(dst + i) = s;
+            continue;
+        }
+        if ((s[0] | s[1] | s[2] | s[3]) == 0) continue;
+
+        v4si d = *(const v4si_u*)(dst + i);
+        v8hi s_lo = (v8hi)__builtin_ia32_punpcklbw128((v16qi)s, zero);
+        v8hi s_hi = (v8hi)__builtin_ia32_punpckhbw128((v16qi)s, zero);
+        v8hi d_lo = (v8hi)__builtin_ia32_punpcklbw128((v16qi)d, zero);
+        v8hi d_hi = (v8hi)__builtin_ia32_punpckhbw128((v16qi)d, zero);
+        v8hi ia_lo = c255 - __builtin_ia32_pshufhw(__builtin_ia32_pshuflw(s_lo, 0xFF), 0xFF);
+        v8hi ia_hi = c255 - __builtin_ia32_pshufhw(__builtin_ia32_pshuflw(s_hi, 0xFF), 0xFF);
+
+        v8hu t_lo = (v8hu)d_lo * (v8hu)ia_lo + c128;
+        v8hu t_hi = (v8hu)d_hi * (v8hu)ia_hi + c128;
+        t_lo = (t_lo + (t_lo >> 8)) >> 8;
+        t_hi = (t_hi + (t_hi >> 8)) >> 8;
+
+        // Saturating byte add of the source
+        v16qi scaled = __builtin_ia32_packuswb128((v8hi)t_lo, (v8hi)t_hi);
+        v4si r = (v4si)__builtin_ia32_paddusb128(scaled, (v16qi)s);
+        *(v4si_u*)(dst + i) = r | opaque;
+    }
+    blend32_premultiplied_scalar(dst + i, src + i, count - i);
+}
+
+// ==================== DISPATCH ====================
+
+// Safe defaults until blit_init runs: no SSE instructions
+static fill_fn fill_kernel = fill32_rep;
+static blend_fn blend_kernel = blend32_scalar;
+static blend_fn premultiplied_kernel = blend32_premultiplied_scalar;
+static const char* fill_name = "rep stosd";
+static const char* blend_name = "scalar";
+
+void blit_init(void) {
+    if (cpu_has(CPU_FEATURE_SSE2)) {
+        fill_kernel = fill32_sse2;
+        fill_name = "SSE2";
+        blend_kernel = blend32_sse2;
+        blend_name = "SSE2";
+        premultiplied_kernel = blend32_premultiplied_sse2;
+    }
+    if (cpu_has(CPU_FEATURE_SSSE3)) {
+        blend_kernel = blend32_ssse3;
+        blend_name = "SSSE3";
+    }
+}
+
+const char* blit_fill_kernel(void) {
+    return fill_name;
+}
+
+const char* blit_blend_kernel(void) {
+    return blend_name;
+}
+
+void blit_fill32(uint32_t* dst, uint32_t value, int count) {
+    if (count > 0) fill_kernel(dst, value, count);
+}
+
+void blit_blend32(uint32_t* dst, const uint32_t* src, int count) {
+    if (count > 0) blend_kernel(dst, src, count);
+}
+
+void blit_blend32_premultiplied(uint32_t* dst, const uint32_t* src, int count) {
+    if (count > 0) premultiplied_kernel(dst, src, count);
+}
+
+void blit_copy(void* dst, const void* src, unsigned int bytes) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    unsigned long dwords = bytes >> 2;
+    unsigned long tail = bytes & 3;
+
+    if (bytes == 0 || d == s) return;
+
+    if (d < s || d >= s + bytes) {
+        asm volatile ("rep movsl\n\t"
+                      "mov %3, %2\n\t"
+                      "rep movsb"
+                      : "+D"(d), "+S"(s), "+c"(dwords)
+                      : "r"(tail)
+                      : "memory");
+    } else {
+        // Destination overlaps the end of the source: copy backwards,
+        // first the odd tail bytes, then whole dwords
+        d += bytes - 1;
+        s += bytes - 1;
+        asm volatile ("std\n\t"
+                      "rep movsb\n\t"
+                      "sub $3, %0\n\t"
+                      "sub $3, %1\n\t"
+                      "mov %3, %2\n\t"
+                      "rep movsl\n\t"
+                      "cld"
+                      : "+D"(d), "+S"(s), "+c"(tail)
+                      : "r"(dwords)
+                      : "memory");
+    }
+}
+
+// ==================== BENCHMARK ====================
+
+#define BENCH_PIXELS (64 * 1024)  // 256 KB per buffer
+#define BENCH_PASSES 32
+
+static uint32_t bench_src[BENCH_PIXELS] __attribute__((aligned(16)));
+static uint32_t bench_dst[BENCH_PIXELS] __attribute__((aligned(16)));
+
+typedef struct {
+    const char* primitive;
+    const char* kernel;
+    int feature;   // CPU_FEATURE_* needed, 0 = always
+    void (*run)(void);
+} bench_case_t;
+
+static void run_fill_scalar(void) { fill32_scalar(bench_dst, 0xFF336699, BENCH_PIXELS); }
+static void run_fill_rep(void)    { fill32_rep(bench_dst, 0xFF336699, BENCH_PIXELS); }
+static void run_fill_sse2(void)   { fill32_sse2(bench_dst, 0xFF336699, BENCH_PIXELS); }
+static void run_copy_bytes(void)  { memcpy(bench_dst, bench_src, BENCH_PIXELS * 4); }
+static void run_copy_rep(void)    { blit_copy(bench_dst, bench_src, BENCH_PIXELS * 4); }
+static void run_copy_overlap(void){ blit_copy(bench_dst + 1, bench_dst, (BENCH_PIXELS - 1) * 4); }
+static void run_blend_scalar(void){ blend32_scalar(bench_dst, bench_src, BENCH_PIXELS); }
+static void run_blend_sse2(void)  { blend32_sse2(bench_dst, bench_src, BENCH_PIXELS); }
+static void run_blend_ssse3(void) { blend32_ssse3(bench_dst, bench_src, BENCH_PIXELS); }
+static void run_premul_scalar(void) { blend32_premultiplied_scalar(bench_dst, bench_src, BENCH_PIXELS); }
+static void run_premul_sse2(void) { blend32_premultiplied_sse2(bench_dst, bench_src, BENCH_PIXELS); }
+
+static const bench_case_t bench_cases[] = {
+    {"fill",  "scalar",       0,                   run_fill_scalar},
+    {"fill",  "rep stosd",    0,                   run_fill_rep},
+    {"fill",  "SSE2",         CPU_FEATURE_SSE2,    run_fill_sse2},
+    {"copy",  "byte loop",    0,                   run_copy_bytes},
+    {"copy",  "rep movsd",    0,                   run_copy_rep},
+    {"copy",  "rep movsd (overlap)", 0,            run_copy_overlap},
+    {"blend", "scalar",       0,                   run_blend_scalar},
+    {"blend", "SSE2",         CPU_FEATURE_SSE2,    run_blend_sse2},
+    {"blend", "SSSE3",        CPU_FEATURE_SSSE3,   run_blend_ssse3},
+    {"blend premultiplied", "scalar", 0,           run_premul_scalar},
+    {"blend premultiplied", "SSE2", CPU_FEATURE_SSE2, run_premul_sse2},
+};
+
+void blit_benchmark(void) {
+    // Mixed alpha: opaque, transparent and translucent runs
+    for (int i = 0; i < BENCH_PIXELS; i++) {
+        uint32_t alpha = ((i >> 4) * 37) & 0xFF;
+        bench_src[i] = (alpha << 24) | ((i * 2654435761u) & 0x00FFFFFF);
+    }
+
+    if (!cpu_tsc_khz()) {
+        printf("Blit: TSC rate unknown, cannot report Mpixels/s\n");
+        return;
+    }
+
+    printf("Blit kernels (%d pixels x %d passes, TSC %d MHz):\n",
+           BENCH_PIXELS, BENCH_PASSES, cpu_tsc_khz() / 1000);
+
+    for (unsigned int c = 0; c < sizeof(bench_cases) / sizeof(bench_cases[0]); c++) {
+        const bench_case_t* bc = &bench_cases[c];
+        if (bc->feature && !cpu_has(bc->feature)) {
+            printf("  %s %s: not supported\n", bc->primitive, bc->kernel);
+            continue;
+        }
+
+        bc->run();  // Warm the caches
+        uint64_t start = cpu_read_tsc();
+        for (int pass = 0; pass < BENCH_PASSES; pass++) {
+            bc->run();
+        }
+        uint32_t us = cpu_cycles_to_us(cpu_read_tsc() - start);
+        if (us == 0) us = 1;
+
+        // Pixels per microsecond = Mpixels/s, with one decimal
+        uint32_t rate10 = (uint32_t)BENCH_PIXELS * BENCH_PASSES / us * 10 +
+                          ((uint32_t)BENCH_PIXELS * BENCH_PASSES % us) * 10 / us;
+        printf("  %s %s: %d.%d Mpixels/s\n", bc->primitive, bc->kernel, rate10 / 10, rate10 % 10);
+    }
+    printf("Active: fill %s, blend %s\n", fill_name, blend_name);
+}
@@ -0,0 +1,50 @@
+// src/drivers/blit.h - Row kernels for fills, copies and alpha blending
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <stdint.h>
+
+// Picks SSE2/SSSE3 kernels when cpu_init reported them
+void blit_init(void);
+const char* blit_fill_kernel(void);
+const char* blit_blend_kernel(void);
+
+void blit_fill32(uint32_t* dst, uint32_t value, int count);
+// Blends ARGB source pixels over XRGB8888 destination pixels
+void blit_blend32(uint32_t* dst, const uint32_t* src, int count);
+// Same for premultiplied ARGB sources: dst = src + dst * (255 - alpha) / 255
+void blit_blend32_premultiplied(uint32_t* dst, const uint32_t* src, int count);
+// memmove with rep movsd; overlapping ranges are safe
+void blit_copy(void* dst, const void* src, unsigned int bytes);
+
+// Rounded x / 255 without a division: exact for x <= 255 * 255
+static inline uint32_t blit_div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// One pixel of blit_blend32; the result is opaque
+static inline uint32_t blit_blend_argb(uint32_t src, uint32_t dst) {
+    uint32_t a = src >> 24;
+    uint32_t ia = 255 - a;
+    uint32_t r = blit_div255(((src >> 16) & 0xFF) * a + ((dst >> 16) & 0xFF) * ia);
+    uint32_t g = blit_div255(((src >> 8) & 0xFF) * a + ((dst >> 8) & 0xFF) * ia);
+    uint32_t b = blit_div255((src & 0xFF) * a + (dst & 0xFF) * ia);
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+static inline uint32_t blit_blend_premultiplied(uint32_t src, uint32_t dst) {
+    uint32_t ia = 255 - (src >> 24);
+    uint32_t r = ((src >> 16) & 0xFF) + blit_div255(((dst >> 16) & 0xFF) * ia);
+    uint32_t g = ((src >> 8) & 0xFF) + blit_div255(((dst >> 8) & 0xFF) * ia);
+    uint32_t b = (src & 0xFF) + blit_div255((dst & 0xFF) * ia);
+    if (r > 255) r = 255;
+    if (g > 255) g = 255;
+    if (b > 255) b = 255;
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+// Mpixels/s of every available kernel (shell command "blitbench")
+void blit_benchmark(void);
+
+#endif
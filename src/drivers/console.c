@@ -0,0 +1,440 @@
+// src/drivers/console.c - Character-cell text console with ANSI escapes
+#include "console.h"
+#include "screen.h"
+#include "glyph.h"
+#include "../lib/string.h"
+
+#define CELL_WIDTH  GLYPH_WIDTH
+#define CELL_HEIGHT GLYPH_HEIGHT
+
+// Grid used until a framebuffer is configured
+#define DEFAULT_COLUMNS 80
+#define DEFAULT_ROWS    25
+
+#define DEFAULT_FOREGROUND (CONSOLE_WHITE | CONSOLE_BRIGHT)
+#define DEFAULT_BACKGROUND CONSOLE_BLACK
+
+#define ATTR(fg, bg) ((uint8_t)(((bg) << 4) | (fg)))
+#define ATTR_FG(a) ((a) & 0x0F)
+#define ATTR_BG(a) ((a) >> 4)
+
+#define MAX_PARAMS 8
+
+typedef struct {
+    uint8_t ch;
+    uint8_t attr;   // Foreground in the low nibble, background in the high one
+} cell_t;
+
+enum {
+    STATE_NORMAL,
+    STATE_ESCAPE,
+    STATE_CSI
+};
+
+static const uint32_t palette[16] = {
+    0xFF000000, 0xFFAA0000, 0xFF00AA00, 0xFFAA5500,
+    0xFF0000AA, 0xFFAA00AA, 0xFF00AAAA, 0xFFAAAAAA,
+    0xFF555555, 0xFFFF5555, 0xFF55FF55, 0xFFFFFF55,
+    0xFF5555FF, 0xFFFF55FF, 0xFF55FFFF, 0xFFFFFFFF
+};
+
+// Rows form a ring: logical row 0 is physical row head, so scrolling
+// moves head instead of copying cells
+static cell_t cells[CONSOLE_MAX_ROWS][CONSOLE_MAX_COLUMNS];
+static int head = 0;
+static int columns = DEFAULT_COLUMNS;
+static int rows = DEFAULT_ROWS;
+
+// Changed columns [dirty_from, dirty_to) of each physical row
+static int16_t dirty_from[CONSOLE_MAX_ROWS];
+static int16_t dirty_to[CONSOLE_MAX_ROWS];
+// Scrolls not yet applied to the framebuffer
+static int pending_scroll = 0;
+
+// Framebuffer size the grid was laid out for
+static int laid_out_width = 0;
+static int laid_out_height = 0;
+
+static int cursor_x = 0;
+static int cursor_y = 0;
+static int saved_x = 0;
+static int saved_y = 0;
+
+static int foreground = DEFAULT_FOREGROUND;
+static int background = DEFAULT_BACKGROUND;
+static int bold = 0;
+static int reverse = 0;
+
+static int state = STATE_NORMAL;
+static int params[MAX_PARAMS];
+static int param_count = 0;
+static int private_mode = 0;
+
+static char row_text[CONSOLE_MAX_COLUMNS];
+
+static inline cell_t* row_cells(int y) {
+    return cells[(head + y) % rows];
+}
+
+static uint8_t current_attr(void) {
+    int fg = foreground;
+    int bg = background;
+    if (bold && fg < CONSOLE_BRIGHT) fg |= CONSOLE_BRIGHT;
+    if (reverse) {
+        int t = fg;
+        fg = bg;
+        bg = t;
+    }
+    return ATTR(fg, bg);
+}
+
+static void mark_dirty(int y, int from, int to) {
+    int p = (head + y) % rows;
+    if (dirty_from[p] >= dirty_to[p]) {
+        dirty_from[p] = from;
+        dirty_to[p] = to;
+        return;
+    }
+    if (from < dirty_from[p]) dirty_from[p] = from;
+    if (to > dirty_to[p]) dirty_to[p] = to;
+}
+
+static void mark_clean(void) {
+    for (int p = 0; p < CONSOLE_MAX_ROWS; p++) {
+        dirty_from[p] = 0;
+        dirty_to[p] = 0;
+    }
+}
+
+static void mark_all_dirty(void) {
+    for (int y = 0; y < rows; y++) mark_dirty(y, 0, columns);
+}
+
+static void erase_cells(int y, int from, int to, uint8_t attr) {
+    if (from >= to) return;
+    cell_t* row = row_cells(y);
+    for (int x = from; x < to; x++) {
+        row[x].ch = ' ';
+        row[x].attr = attr;
+    }
+    mark_dirty(y, from, to);
+}
+
+static void scroll_up(void) {
+    // The old top row becomes the new, blank bottom row
+    head = (head + 1) % rows;
+    erase_cells(rows - 1, 0, columns, current_attr());
+    pending_scroll++;
+}
+
+static void new_line(void) {
+    cursor_x = 0;
+    cursor_y++;
+    if (cursor_y >= rows) {
+        scroll_up();
+        cursor_y = rows - 1;
+    }
+}
+
+static void swap_rows(int a, int b) {
+    cell_t t[CONSOLE_MAX_COLUMNS];
+    memcpy(t, cells[a], sizeof(t));
+    memcpy(cells[a], cells[b], sizeof(t));
+    memcpy(cells[b], t, sizeof(t));
+}
+
+static void reverse_rows(int from, int to) {
+    for (to--; from < to; from++, to--) swap_rows(from, to);
+}
+
+// Lays the grid out for the current framebuffer, keeping the text near the cursor
+static void console_layout(void) {
+    int new_columns = framebuffer_width / CELL_WIDTH;
+    int new_rows = framebuffer_height / CELL_HEIGHT;
+    if (new_columns > CONSOLE_MAX_COLUMNS) new_columns = CONSOLE_MAX_COLUMNS;
+    if (new_rows > CONSOLE_MAX_ROWS) new_rows = CONSOLE_MAX_ROWS;
+    if (new_columns < 1) new_columns = 1;
+    if (new_rows < 1) new_rows = 1;
+
+    // Unroll the ring so logical row y is physical row y
+    reverse_rows(0, head);
+    reverse_rows(head, rows);
+    reverse_rows(0, rows);
+    head = 0;
+
+    int kept = rows;
+    if (cursor_y >= new_rows) {
+        int shift = cursor_y - new_rows + 1;
+        for (int y = 0; y + shift < rows; y++) memcpy(cells[y], cells[y + shift], sizeof(cells[0]));
+        kept -= shift;
+        cursor_y -= shift;
+    }
+    int old_columns = columns;
+    columns = new_columns;
+    rows = new_rows;
+
+    uint8_t blank = ATTR(DEFAULT_FOREGROUND, DEFAULT_BACKGROUND);
+    for (int y = 0; y < rows; y++) {
+        if (y >= kept) erase_cells(y, 0, columns, blank);
+        else if (old_columns < columns) erase_cells(y, old_columns, columns, blank);
+    }
+    if (cursor_x >= columns) cursor_x = columns - 1;
+
+    laid_out_width = framebuffer_width;
+    laid_out_height = framebuffer_height;
+    pending_scroll = 0;
+    mark_all_dirty();
+}
+
+static void render_row(int y, int from, int to) {
+    const cell_t* row = row_cells(y);
+    for (int x = from; x < to; x++) row_text[x] = row[x].ch;
+
+    // One opaque glyph run per stretch of equal attributes
+    int px = y * CELL_HEIGHT;
+    while (from < to) {
+        uint8_t attr = row[from].attr;
+        int end = from + 1;
+        while (end < to && row[end].attr == attr) end++;
+        glyph_draw_string_opaque(from * CELL_WIDTH, px, row_text + from, end - from,
+                                 palette[ATTR_FG(attr)], palette[ATTR_BG(attr)]);
+        from = end;
+    }
+}
+
+void console_flush(void) {
+    if (!framebuffer) return;
+    if (framebuffer_width != laid_out_width || framebuffer_height != laid_out_height) {
+        console_layout();
+    }
+
+    // All scrolls since the last flush become one framebuffer move
+    if (pending_scroll) {
+        if (pending_scroll < rows) {
+            int shift = pending_scroll * CELL_HEIGHT;
+            framebuffer_copy_rect(0, shift, 0, 0, columns * CELL_WIDTH, rows * CELL_HEIGHT - shift);
+        } else {
+            mark_all_dirty();
+        }
+        pending_scroll = 0;
+    }
+
+    for (int y = 0; y < rows; y++) {
+        int p = (head + y) % rows;
+        if (dirty_from[p] < dirty_to[p]) {
+            render_row(y, dirty_from[p], dirty_to[p]);
+            dirty_from[p] = dirty_to[p] = 0;
+        }
+    }
+}
+
+// ==================== ANSI ESCAPES ====================
+
+static int param(int index, int fallback) {
+    if (index >= param_count || params[index] == 0) return fallback;
+    return params[index];
+}
+
+static void clamp_cursor(void) {
+    if (cursor_x < 0) cursor_x = 0;
+    if (cursor_y < 0) cursor_y = 0;
+    if (cursor_x >= columns) cursor_x = columns - 1;
+    if (cursor_y >= rows) cursor_y = rows - 1;
+}
+
+static void select_graphic_rendition(void) {
+    // ESC[m is ESC[0m
+    if (param_count == 0) {
+        params[0] = 0;
+        param_count = 1;
+    }
+
+    for (int i = 0; i < param_count; i++) {
+        int p = params[i];
+        if (p == 0) {
+            foreground = DEFAULT_FOREGROUND;
+            background = DEFAULT_BACKGROUND;
+            bold = reverse = 0;
+        }
+        else if (p == 1) bold = 1;
+        else if (p == 22) bold = 0;
+        else if (p == 7) reverse = 1;
+        else if (p == 27) reverse = 0;
+        else if (p >= 30 && p <= 37) foreground = p - 30;
+        else if (p == 39) foreground = DEFAULT_FOREGROUND;
+        else if (p >= 40 && p <= 47) background = p - 40;
+        else if (p == 49) background = DEFAULT_BACKGROUND;
+        else if (p >= 90 && p <= 97) foreground = p - 90 + CONSOLE_BRIGHT;
+        else if (p >= 100 && p <= 107) background = p - 100 + CONSOLE_BRIGHT;
+    }
+}
+
+static void erase_display(int mode) {
+    uint8_t attr = current_attr();
+    if (mode == 0) {
+        erase_cells(cursor_y, cursor_x, columns, attr);
+        for (int y = cursor_y + 1; y < rows; y++) erase_cells(y, 0, columns, attr);
+    } else if (mode == 1) {
+        for (int y = 0; y < cursor_y; y++) erase_cells(y, 0, columns, attr);
+        erase_cells(cursor_y, 0, cursor_x + 1, attr);
+    } else {
+        for (int y = 0; y < rows; y++) erase_cells(y, 0, columns, attr);
+    }
+}
+
+static void erase_line(int mode) {
+    uint8_t attr = current_attr();
+    if (mode == 0) erase_cells(cursor_y, cursor_x, columns, attr);
+    else if (mode == 1) erase_cells(cursor_y, 0, cursor_x + 1, attr);
+    else erase_cells(cursor_y, 0, columns, attr);
+}
+
+static void execute_csi(char command) {
+    // Private modes (cursor visibility and the like) are accepted and ignored
+    if (private_mode) return;
+
+    switch (command) {
+        case 'm': select_graphic_rendition(); break;
+        case 'H':
+        case 'f':
+            cursor_y = param(0, 1) - 1;
+            cursor_x = param(1, 1) - 1;
+            break;
+        case 'A': cursor_y -= param(0, 1); break;
+        case 'B': cursor_y += param(0, 1); break;
+        case 'C': cursor_x += param(0, 1); break;
+        case 'D': cursor_x -= param(0, 1); break;
+        case 'G': cursor_x = param(0, 1) - 1; break;
+        case 'J': erase_display(param_count ? params[0] : 0); break;
+        case 'K': erase_line(param_count ? params[0] : 0); break;
+        case 's':
+            saved_x = cursor_x;
+            saved_y = cursor_y;
+            break;
+        case 'u':
+            cursor_x = saved_x;
+            cursor_y = saved_y;
+            break;
+    }
+    clamp_cursor();
+}
+
+// Returns 1 if c was consumed by an escape sequence
+static int parse_escape(char c) {
+    if (state == STATE_ESCAPE) {
+        if (c == '[') {
+            state = STATE_CSI;
+            param_count = 0;
+            private_mode = 0;
+            params[0] = 0;
+        } else {
+            state = STATE_NORMAL;
+        }
+        return 1;
+    }
+
+    // STATE_CSI
+    if (c >= '0' && c <= '9') {
+        if (param_count == 0) param_count = 1;
+        int* p = &params[param_count - 1];
+        if (*p < 10000) *p = *p * 10 + (c - '0');
+    } else if (c == ';') {
+        if (param_count == 0) param_count = 1;
+        if (param_count < MAX_PARAMS) params[param_count++] = 0;
+    } else if (c == '?') {
+        private_mode = 1;
+    } else if (c >= 0x40 && c <= 0x7E) {
+        execute_csi(c);
+        state = STATE_NORMAL;
+    } else {
+        // Malformed sequence: drop it
+        state = STATE_NORMAL;
+    }
+    return 1;
+}
+
+// ==================== OUTPUT ====================
+
+int console_putchar(int c) {
+    if (state != STATE_NORMAL && parse_escape(c)) return c;
+
+    switch (c) {
+        case 0x1B:
+            state = STATE_ESCAPE;
+            break;
+        case '\n':
+            new_line();
+            break;
+        case '\r':
+            cursor_x = 0;
+            break;
+        case '\t':
+            cursor_x = (cursor_x + 8) & ~7;
+            if (cursor_x >= columns) new_line();
+            break;
+        case '\b':
+            if (cursor_x > 0) {
+                cursor_x--;
+                erase_cells(cursor_y, cursor_x, cursor_x + 1, current_attr());
+            }
+            break;
+        default:
+            if (c >= 32 && c < 127) {
+                cell_t* cell = &row_cells(cursor_y)[cursor_x];
+                cell->ch = c;
+                cell->attr = current_attr();
+                mark_dirty(cursor_y, cursor_x, cursor_x + 1);
+                if (++cursor_x >= columns) new_line();
+            }
+            break;
+    }
+    return c;
+}
+
+void console_write(const char* str, int length) {
+    for (int i = 0; i < length; i++) console_putchar((unsigned char)str[i]);
+}
+
+void console_set_cursor(int x, int y) {
+    cursor_x = x;
+    cursor_y = y;
+    clamp_cursor();
+}
+
+void console_get_cursor(int* x, int* y) {
+    *x = cursor_x;
+    *y = cursor_y;
+}
+
+void console_set_color(int fg, int bg) {
+    foreground = fg & 0x0F;
+    background = bg & 0x0F;
+}
+
+int console_columns(void) {
+    return columns;
+}
+
+int console_rows(void) {
+    return rows;
+}
+
+void console_clear(void) {
+    if (framebuffer && (framebuffer_width != laid_out_width || framebuffer_height != laid_out_height)) {
+        console_layout();
+    }
+
+    uint8_t blank = ATTR(DEFAULT_FOREGROUND, DEFAULT_BACKGROUND);
+    head = 0;
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < columns; x++) {
+            cells[y][x].ch = ' ';
+            cells[y][x].attr = blank;
+        }
+    }
+    // The pixels are already black
+    mark_clean();
+    pending_scroll = 0;
+    cursor_x = 0;
+    cursor_y = 0;
+}
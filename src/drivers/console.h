@@ -0,0 +1,39 @@
+// src/drivers/console.h - Character-cell text console with ANSI escapes
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+
+// The grid follows the framebuffer resolution up to these limits
+#define CONSOLE_MAX_COLUMNS 256
+#define CONSOLE_MAX_ROWS    256
+
+// ANSI color indices (SGR 30-37 / 90-97)
+#define CONSOLE_BLACK   0
+#define CONSOLE_RED     1
+#define CONSOLE_GREEN   2
+#define CONSOLE_YELLOW  3
+#define CONSOLE_BLUE    4
+#define CONSOLE_MAGENTA 5
+#define CONSOLE_CYAN    6
+#define CONSOLE_WHITE   7
+#define CONSOLE_BRIGHT  8
+
+// Updates cells only; pixels are produced by console_flush.
+// Understands \n \r \t \b and ESC [ ... m/H/f/A/B/C/D/G/J/K/s/u
+int console_putchar(int c);
+void console_write(const char* str, int length);
+
+// Renders changed cells and pending scrolls (called from gpu_swap_buffers)
+void console_flush(void);
+
+void console_set_cursor(int x, int y);
+void console_get_cursor(int* x, int* y);
+void console_set_color(int foreground, int background);
+int console_columns(void);
+int console_rows(void);
+
+// Blanks the cell buffer to match a framebuffer the caller has just cleared to black
+void console_clear(void);
+
+#endif
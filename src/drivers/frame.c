@@ -0,0 +1,148 @@
+// src/drivers/frame.c - Frame scheduler and frame-time profiler overlay
+#include "frame.h"
+#include "screen.h"
+#include "gpu.h"
+#include "glyph.h"
+#include "text_output.h"
+#include "../lib/cpu.h"
+#include "../lib/format.h"
+#include "../lib/string.h"
+
+#define OVERLAY_LINES   6
+#define OVERLAY_CHARS   24
+#define OVERLAY_MARGIN  8
+#define OVERLAY_PADDING 4
+#define OVERLAY_COLOR      0xFF00FF00
+#define OVERLAY_BACKGROUND COLOR_BLACK
+
+// TSC cycles per refresh; 0 = compose on every tick
+static uint32_t interval_cycles = 0;
+static uint64_t last_frame = 0;
+static uint64_t first_request = 0;
+static uint32_t pending = 0;
+static frame_stats_t stats;
+
+static int overlay_visible = 0;
+static char overlay_text[OVERLAY_LINES][OVERLAY_CHARS + 1];
+
+static uint64_t frame_clock(void) {
+    return cpu_has(CPU_FEATURE_TSC) ? cpu_read_tsc() : 0;
+}
+
+void frame_init(void) {
+    interval_cycles = cpu_tsc_khz() / FRAME_RATE * 1000;
+    last_frame = frame_clock();
+    pending = 0;
+}
+
+void frame_request(void) {
+    if (!pending) first_request = frame_clock();
+    pending++;
+}
+
+// ==================== OVERLAY ====================
+
+static void overlay_bounds(rect_t* r) {
+    r->width = OVERLAY_CHARS * GLYPH_WIDTH + 2 * OVERLAY_PADDING;
+    r->height = OVERLAY_LINES * GLYPH_HEIGHT + 2 * OVERLAY_PADDING;
+    r->x = framebuffer_width - r->width - OVERLAY_MARGIN;
+    r->y = OVERLAY_MARGIN;
+}
+
+// Text is prepared once per frame; the overlay is drawn once per damaged rectangle
+static void overlay_format(void) {
+    uint32_t fps = stats.frame_us ? 1000000 / stats.frame_us : 0;
+
+    snprintf(overlay_text[0], OVERLAY_CHARS + 1, "frame   %8u us %4u", stats.frame_us, fps);
+    snprintf(overlay_text[1], OVERLAY_CHARS + 1, "latency %8u us", stats.latency_us);
+    snprintf(overlay_text[2], OVERLAY_CHARS + 1, "compose %8u us", stats.compose_us);
+    snprintf(overlay_text[3], OVERLAY_CHARS + 1, "pixels  %8d", stats.pixels);
+    snprintf(overlay_text[4], OVERLAY_CHARS + 1, "rects   %8d", stats.damage_rects);
+    snprintf(overlay_text[5], OVERLAY_CHARS + 1, "frame # %8u req %u", stats.frames, stats.requests);
+}
+
+static void overlay_draw(void) {
+    rect_t r;
+    overlay_bounds(&r);
+
+    fill_rect(r.x, r.y, r.width, r.height, OVERLAY_BACKGROUND);
+    for (int i = 0; i < OVERLAY_LINES; i++) {
+        glyph_draw_string_opaque(r.x + OVERLAY_PADDING, r.y + OVERLAY_PADDING + i * GLYPH_HEIGHT,
+                                 overlay_text[i], strlen(overlay_text[i]),
+                                 OVERLAY_COLOR, OVERLAY_BACKGROUND);
+    }
+}
+
+void frame_toggle_overlay(void) {
+    rect_t r;
+
+    overlay_visible = !overlay_visible;
+    desktop_set_overlay(overlay_visible ? overlay_draw : 0);
+    // Shown or uncovered by the next frame
+    overlay_bounds(&r);
+    desktop_invalidate(r.x, r.y, r.width, r.height);
+    frame_request();
+}
+
+// ==================== FRAMES ====================
+
+static int frame_compose(int force) {
+    if (!pending) return 0;
+
+    uint64_t start = frame_clock();
+    if (!force && interval_cycles && start - last_frame < interval_cycles) return 0;
+
+    // The overlay shows the previous frame's figures
+    if (overlay_visible) {
+        rect_t r;
+        overlay_format();
+        overlay_bounds(&r);
+        desktop_invalidate(r.x, r.y, r.width, r.height);
+    }
+
+    // A frame with no damage (cursor plane moved) only needs presenting
+    int composed = desktop_has_damage() && global_desktop;
+    if (composed) {
+        desktop_compose(global_desktop);
+    } else {
+        gpu_swap_buffers();
+    }
+    uint64_t end = frame_clock();
+
+    const compose_stats_t* compose = desktop_compose_stats();
+    stats.frames++;
+    stats.frame_us = cpu_cycles_to_us(start - last_frame);
+    stats.latency_us = cpu_cycles_to_us(end - first_request);
+    stats.compose_us = cpu_cycles_to_us(end - start);
+    stats.requests = pending;
+    stats.damage_rects = composed ? compose->damage_rects : 0;
+    if (framebuffer_has_back_buffer()) {
+        stats.pixels = compose->presented_pixels;
+    } else {
+        stats.pixels = composed ? compose->damage_pixels : 0;
+    }
+
+    last_frame = start;
+    pending = 0;
+    return 1;
+}
+
+int frame_tick(void) {
+    return frame_compose(0);
+}
+
+int frame_flush(void) {
+    return frame_compose(1);
+}
+
+void desktop_repaint_now(void) {
+    clear_screen();
+    if (!global_desktop) return;
+
+    desktop_paint(global_desktop);
+    frame_flush();
+}
+
+const frame_stats_t* frame_stats(void) {
+    return &stats;
+}
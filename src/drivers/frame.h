@@ -0,0 +1,41 @@
+// src/drivers/frame.h - Frame scheduler and frame-time profiler overlay
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+
+// Composites per second at most
+#define FRAME_RATE 60
+
+typedef struct {
+    uint32_t frames;
+    uint32_t frame_us;      // From the previous composite to this one
+    uint32_t latency_us;    // From the first request to the end of the composite
+    uint32_t compose_us;    // desktop_compose, present included
+    uint32_t requests;      // Requests coalesced into the frame
+    int damage_rects;
+    int pixels;             // Pushed to video memory (composed, without a back buffer)
+} frame_stats_t;
+
+// Measures the refresh interval on the TSC; without it every tick composes
+void frame_init(void);
+
+// Something changed on the desktop or the console: it is composed by the next due tick.
+// Any number of requests within one refresh interval make one frame
+void frame_request(void);
+// Composes when a frame is pending and the interval has passed; returns 1 if it did.
+// Called wherever the kernel waits (keyboard_getchar)
+int frame_tick(void);
+// Composes a pending frame now, whatever the interval. For code that repaints
+// the desktop and then prints over it: a later tick would fill over the text
+int frame_flush(void);
+// Clears the screen and composes the whole desktop before returning, for
+// code that drew over the screen and prints its results next
+void desktop_repaint_now(void);
+
+// Frame time, composite time, pixels and damage rectangles in a corner of
+// the screen (hotkey F12)
+void frame_toggle_overlay(void);
+const frame_stats_t* frame_stats(void);
+
+#endif
@@ -0,0 +1,351 @@
+// src/drivers/glyph.c - Glyph cache and text rendering for the 8x8 font
+#include "glyph.h"
+#include "screen.h"
+#include "frame.h"
+#include "text_output.h"
+#include "../lib/cpu.h"
+#include "../lib/string.h"
+
+// Longest run of text assembled into one scanline per call
+#define GLYPH_LINE_CHARS 128
+
+typedef struct {
+    uint32_t color, background;
+    uint8_t ch;
+    uint8_t used;
+    int16_t hash_next;
+    int16_t lru_prev, lru_next;   // lru_prev toward most recently used
+    uint32_t pixels[GLYPH_HEIGHT][GLYPH_WIDTH];
+} glyph_entry_t;
+
+static glyph_entry_t cache[GLYPH_CACHE_SIZE];
+static int16_t hash_heads[GLYPH_HASH_SIZE];
+static int16_t lru_head = -1;   // Most recently used
+static int16_t lru_tail = -1;   // Eviction candidate
+static int cache_ready = 0;
+static glyph_cache_stats_t stats;
+
+// Runs of set bits for every font row value: count, then (start, length) pairs
+static uint8_t row_runs[256][9];
+
+static uint32_t line[GLYPH_HEIGHT][GLYPH_LINE_CHARS * GLYPH_WIDTH];
+
+static void build_row_runs(void) {
+    for (int bits = 0; bits < 256; bits++) {
+        uint8_t* r = row_runs[bits];
+        int n = 0;
+        int x = 0;
+        while (x < 8) {
+            if (bits & (0x80 >> x)) {
+                int start = x;
+                while (x < 8 && (bits & (0x80 >> x))) x++;
+                r[1 + n * 2] = start;
+                r[2 + n * 2] = x - start;
+                n++;
+            } else {
+                x++;
+            }
+        }
+        r[0] = n;
+    }
+}
+
+void glyph_cache_flush(void) {
+    for (int i = 0; i < GLYPH_HASH_SIZE; i++) hash_heads[i] = -1;
+
+    // All entries free, chained in index order
+    for (int i = 0; i < GLYPH_CACHE_SIZE; i++) {
+        cache[i].used = 0;
+        cache[i].hash_next = -1;
+        cache[i].lru_prev = i - 1;
+        cache[i].lru_next = (i + 1 < GLYPH_CACHE_SIZE) ? i + 1 : -1;
+    }
+    lru_head = 0;
+    lru_tail = GLYPH_CACHE_SIZE - 1;
+}
+
+static void glyph_init(void) {
+    build_row_runs();
+    glyph_cache_flush();
+    cache_ready = 1;
+}
+
+static inline unsigned int glyph_hash(uint8_t ch, uint32_t color, uint32_t background) {
+    uint32_t h = ch * 0x9E3779B1u ^ color ^ (background * 31);
+    return (h ^ (h >> 16)) & (GLYPH_HASH_SIZE - 1);
+}
+
+static void lru_unlink(int i) {
+    glyph_entry_t* e = &cache[i];
+    if (e->lru_prev >= 0) cache[e->lru_prev].lru_next = e->lru_next;
+    else lru_head = e->lru_next;
+    if (e->lru_next >= 0) cache[e->lru_next].lru_prev = e->lru_prev;
+    else lru_tail = e->lru_prev;
+}
+
+static void lru_push_front(int i) {
+    cache[i].lru_prev = -1;
+    cache[i].lru_next = lru_head;
+    if (lru_head >= 0) cache[lru_head].lru_prev = i;
+    lru_head = i;
+    if (lru_tail < 0) lru_tail = i;
+}
+
+static void hash_remove(int i) {
+    int16_t* link = &hash_heads[glyph_hash(cache[i].ch, cache[i].color, cache[i].background)];
+    while (*link >= 0) {
+        if (*link == i) {
+            *link = cache[i].hash_next;
+            return;
+        }
+        link = &cache[*link].hash_next;
+    }
+}
+
+// Returns the expanded cell for (ch, color, background), rendering it on a miss
+static const glyph_entry_t* glyph_lookup(uint8_t ch, uint32_t color, uint32_t background) {
+    if (!cache_ready) glyph_init();
+
+    unsigned int h = glyph_hash(ch, color, background);
+    for (int i = hash_heads[h]; i >= 0; i = cache[i].hash_next) {
+        glyph_entry_t* e = &cache[i];
+        if (e->ch == ch && e->color == color && e->background == background) {
+            stats.hits++;
+            if (lru_head != i) {
+                lru_unlink(i);
+                lru_push_front(i);
+            }
+            return e;
+        }
+    }
+
+    // Miss: reuse the least recently used entry
+    stats.misses++;
+    int i = lru_tail;
+    glyph_entry_t* e = &cache[i];
+    if (e->used) hash_remove(i);
+    lru_unlink(i);
+    lru_push_front(i);
+
+    e->ch = ch;
+    e->color = color;
+    e->background = background;
+    e->used = 1;
+    e->hash_next = hash_heads[h];
+    hash_heads[h] = i;
+
+    const unsigned char* bits = font_8x8[ch & 0x7F];
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+        for (int col = 0; col < GLYPH_WIDTH; col++) {
+            e->pixels[row][col] = (bits[row] & (0x80 >> col)) ? color : background;
+        }
+    }
+    return e;
+}
+
+static int printable(char c) {
+    return c >= 32 && c < 127;
+}
+
+// Rows [*first, *last) of a glyph line at y that survive the clip rectangle
+static int clip_rows(int y, const rect_t* clip, int* first, int* last) {
+    *first = (clip->y > y) ? clip->y - y : 0;
+    *last = (clip->y + clip->height < y + GLYPH_HEIGHT) ? clip->y + clip->height - y : GLYPH_HEIGHT;
+    return *first < *last;
+}
+
+// Characters [*first, *last) of a run at x that touch the clip rectangle
+static int clip_chars(int x, int length, const rect_t* clip, int* first, int* last) {
+    *first = (clip->x > x) ? (clip->x - x) / GLYPH_WIDTH : 0;
+    *last = length;
+    int end = clip->x + clip->width - x;
+    if (end < length * GLYPH_WIDTH) *last = (end + GLYPH_WIDTH - 1) / GLYPH_WIDTH;
+    return *first < *last;
+}
+
+static void draw_mask_rows(int x, int y, char c, uint32_t color, int first_row, int last_row) {
+    const unsigned char* bits = font_8x8[(int)c];
+    for (int row = first_row; row < last_row; row++) {
+        const uint8_t* r = row_runs[bits[row]];
+        for (int i = 0; i < r[0]; i++) {
+            framebuffer_fill_span(x + r[1 + i * 2], y + row, r[2 + i * 2], color);
+        }
+    }
+}
+
+void glyph_draw(int x, int y, char c, uint32_t color) {
+    if (!printable(c)) return;
+    if (!cache_ready) glyph_init();
+
+    rect_t clip;
+    int first, last;
+    framebuffer_get_clip(&clip);
+    if (!clip_rows(y, &clip, &first, &last)) return;
+    draw_mask_rows(x, y, c, color, first, last);
+}
+
+void glyph_draw_string(int x, int y, const char* str, uint32_t color) {
+    if (!cache_ready) glyph_init();
+
+    // One clip test for the whole run, then only the visible characters
+    rect_t clip;
+    int first_row, last_row, first, last;
+    int length = strlen(str);
+    framebuffer_get_clip(&clip);
+    if (!clip_rows(y, &clip, &first_row, &last_row)) return;
+    if (!clip_chars(x, length, &clip, &first, &last)) return;
+
+    for (int i = first; i < last; i++) {
+        if (printable(str[i])) {
+            draw_mask_rows(x + i * GLYPH_WIDTH, y, str[i], color, first_row, last_row);
+        }
+    }
+}
+
+void glyph_draw_opaque(int x, int y, char c, uint32_t color, uint32_t background) {
+    glyph_draw_string_opaque(x, y, &c, 1, color, background);
+}
+
+void glyph_draw_string_opaque(int x, int y, const char* str, int length,
+                              uint32_t color, uint32_t background) {
+    rect_t clip;
+    int first_row, last_row, first, last;
+    framebuffer_get_clip(&clip);
+    if (!clip_rows(y, &clip, &first_row, &last_row)) return;
+    if (!clip_chars(x, length, &clip, &first, &last)) return;
+
+    // Assemble each scanline of the run from cached cells, then write it as one span
+    while (first < last) {
+        int count = last - first;
+        if (count > GLYPH_LINE_CHARS) count = GLYPH_LINE_CHARS;
+
+        for (int i = 0; i < count; i++) {
+            char c = str[first + i];
+            const glyph_entry_t* e = glyph_lookup(printable(c) ? c : ' ', color, background);
+            for (int row = first_row; row < last_row; row++) {
+                memcpy(&line[row][i * GLYPH_WIDTH], e->pixels[row], GLYPH_WIDTH * 4);
+            }
+        }
+
+        for (int row = first_row; row < last_row; row++) {
+            framebuffer_draw_span(x + first * GLYPH_WIDTH, y + row, line[row],
+                                  count * GLYPH_WIDTH, SPAN_COPY);
+        }
+        first += count;
+    }
+}
+
+void glyph_render_string(uint32_t* buffer, int stride, const rect_t* clip, int x, int y,
+                         const char* str, int length, uint32_t color, uint32_t background) {
+    int first_row, last_row, first, last;
+    if (!clip_rows(y, clip, &first_row, &last_row)) return;
+    if (!clip_chars(x, length, clip, &first, &last)) return;
+
+    // Cells are copied straight from the cache, cut at the clip edges
+    int left = clip->x;
+    int right = clip->x + clip->width;
+    for (int i = first; i < last; i++) {
+        char c = str[i];
+        const glyph_entry_t* e = glyph_lookup(printable(c) ? c : ' ', color, background);
+        int cx = x + i * GLYPH_WIDTH;
+        int from = (left > cx) ? left - cx : 0;
+        int to = (right < cx + GLYPH_WIDTH) ? right - cx : GLYPH_WIDTH;
+        for (int row = first_row; row < last_row; row++) {
+            memcpy(&buffer[(y + row) * stride + cx + from], &e->pixels[row][from], (to - from) * 4);
+        }
+    }
+}
+
+const glyph_cache_stats_t* glyph_cache_stats(void) {
+    return &stats;
+}
+
+// ==================== BENCHMARK ====================
+
+#define BENCH_LINES 48
+#define BENCH_COLUMNS 96
+
+// The old renderer: every font bit through framebuffer_put_pixel
+static void draw_char_per_pixel(int x, int y, char c, uint32_t color) {
+    unsigned char* char_data = font_8x8[(int)c];
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            if (char_data[row] & (1 << (7 - col))) {
+                framebuffer_put_pixel(x + col, y + row, color);
+            }
+        }
+    }
+}
+
+static char bench_text[BENCH_COLUMNS + 1];
+
+static void bench_per_pixel(int y) {
+    for (int i = 0; i < BENCH_COLUMNS; i++) draw_char_per_pixel(i * 8, y, bench_text[i], COLOR_WHITE);
+}
+
+static void bench_mask(int y) {
+    for (int i = 0; i < BENCH_COLUMNS; i++) glyph_draw(i * 8, y, bench_text[i], COLOR_WHITE);
+}
+
+static void bench_mask_string(int y) {
+    glyph_draw_string(0, y, bench_text, COLOR_WHITE);
+}
+
+static void bench_opaque(int y) {
+    for (int i = 0; i < BENCH_COLUMNS; i++) {
+        glyph_draw_opaque(i * 8, y, bench_text[i], COLOR_WHITE, COLOR_BLACK);
+    }
+}
+
+static void bench_opaque_string(int y) {
+    glyph_draw_string_opaque(0, y, bench_text, BENCH_COLUMNS, COLOR_WHITE, COLOR_BLACK);
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(int y);
+    uint32_t kchars;   // Thousands of characters per second
+} text_bench_t;
+
+static text_bench_t benches[] = {
+    {"put_pixel per bit (old)", bench_per_pixel, 0},
+    {"mask spans, per char", bench_mask, 0},
+    {"mask spans, string", bench_mask_string, 0},
+    {"opaque cached, per char", bench_opaque, 0},
+    {"opaque cached, string", bench_opaque_string, 0},
+};
+
+void glyph_benchmark(void) {
+    if (!framebuffer || !cpu_tsc_khz()) {
+        printf("Text: no framebuffer or TSC rate unknown\n");
+        return;
+    }
+
+    for (int i = 0; i < BENCH_COLUMNS; i++) bench_text[i] = 'A' + (i * 7) % 58;
+    bench_text[BENCH_COLUMNS] = '\0';
+    for (int i = 0; i < BENCH_COLUMNS; i++) {
+        if (!printable(bench_text[i])) bench_text[i] = '#';
+    }
+
+    int lines = BENCH_LINES;
+    if (lines * 8 > framebuffer_height) lines = framebuffer_height / 8;
+
+    for (unsigned int b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+        uint64_t start = cpu_read_tsc();
+        for (int l = 0; l < lines; l++) {
+            benches[b].run(l * 8);
+        }
+        uint32_t us = cpu_cycles_to_us(cpu_read_tsc() - start);
+        if (us == 0) us = 1;
+        benches[b].kchars = (uint32_t)lines * BENCH_COLUMNS * 1000 / us;
+    }
+
+    // The benchmark drew over the screen
+    desktop_repaint_now();
+
+    printf("Text rendering (%d chars per path):\n", lines * BENCH_COLUMNS);
+    for (unsigned int b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+        printf("  %s: %d Kchars/s\n", benches[b].name, benches[b].kchars);
+    }
+    printf("Glyph cache: %d hits, %d misses\n", stats.hits, stats.misses);
+}
@@ -0,0 +1,40 @@
+// src/drivers/glyph.h - Glyph cache and text rendering for the 8x8 font
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <stdint.h>
+#include "region.h"
+
+#define GLYPH_WIDTH  8
+#define GLYPH_HEIGHT 8
+
+// Rendered colored glyphs kept in an LRU cache
+#define GLYPH_CACHE_SIZE 128
+#define GLYPH_HASH_SIZE  64
+
+// Transparent background: only the set bits of the glyph are written
+void glyph_draw(int x, int y, char c, uint32_t color);
+void glyph_draw_string(int x, int y, const char* str, uint32_t color);
+
+// Opaque background: whole 8x8 cells are written, the destination is never read
+void glyph_draw_opaque(int x, int y, char c, uint32_t color, uint32_t background);
+void glyph_draw_string_opaque(int x, int y, const char* str, int length,
+                              uint32_t color, uint32_t background);
+
+// Opaque cells into a pixel buffer (a window surface) instead of the
+// framebuffer; clip is in buffer coordinates and must lie inside it
+void glyph_render_string(uint32_t* buffer, int stride, const rect_t* clip, int x, int y,
+                         const char* str, int length, uint32_t color, uint32_t background);
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+} glyph_cache_stats_t;
+
+const glyph_cache_stats_t* glyph_cache_stats(void);
+void glyph_cache_flush(void);
+
+// Characters per second of each path (shell command "textbench")
+void glyph_benchmark(void);
+
+#endif
@@ -46,22 +46,9 @@ typedef struct {
     uint8_t* mmio_base;
     uint32_t irq_num;
     int accelerated;
+    int pages;             // Страниц в видеопамяти (>1 - возможен page flip)
 } gpu_context_t;
 
-// OpenGL Context for hardware acceleration
-typedef struct {
-    gpu_context_t* gpu;
-    uint32_t current_texture;
-    uint32_t viewport_x;
-    uint32_t viewport_y;
-    uint32_t viewport_width;
-    uint32_t viewport_height;
-    uint32_t clear_color;
-    float* vertex_buffer;
-    uint32_t vertex_count;
-    uint32_t max_vertices;
-} opengl_context_t;
-
 // GPU initialization and control
 int gpu_init(void);
 gpu_context_t* gpu_get_context(void);
@@ -76,35 +63,4 @@ void gpu_draw_circle_hw(int x, int y, int radius, uint32_t color);
 void gpu_fill_rect_hw(int x, int y, int width, int height, uint32_t color);
 void gpu_blit(uint32_t src_addr, int src_x, int src_y, int dst_x, int dst_y, int width, int height);
 
-// OpenGL-like API for 3D acceleration
-opengl_context_t* opengl_create_context(gpu_context_t* gpu);
-void opengl_destroy_context(opengl_context_t* ctx);
-void opengl_clear(opengl_context_t* ctx, uint32_t mask);
-void opengl_viewport(opengl_context_t* ctx, int x, int y, int width, int height);
-void opengl_clear_color(opengl_context_t* ctx, float r, float g, float b, float a);
-void opengl_begin(opengl_context_t* ctx, uint32_t mode);
-void opengl_end(opengl_context_t* ctx);
-void opengl_vertex2f(opengl_context_t* ctx, float x, float y);
-void opengl_vertex3f(opengl_context_t* ctx, float x, float y, float z);
-void opengl_color3f(opengl_context_t* ctx, float r, float g, float b);
-void opengl_color4f(opengl_context_t* ctx, float r, float g, float b, float a);
-
-// Texture management
-uint32_t opengl_gen_texture(opengl_context_t* ctx);
-void opengl_bind_texture(opengl_context_t* ctx, uint32_t texture);
-void opengl_tex_image2d(opengl_context_t* ctx, int width, int height, const void* data);
-void opengl_tex_parameteri(opengl_context_t* ctx, uint32_t param, int value);
-
-// Matrix operations (для 3D трансформаций)
-void opengl_matrix_mode(opengl_context_t* ctx, uint32_t mode);
-void opengl_load_identity(opengl_context_t* ctx);
-void opengl_translatef(opengl_context_t* ctx, float x, float y, float z);
-void opengl_scalef(opengl_context_t* ctx, float x, float y, float z);
-void opengl_rotatef(opengl_context_t* ctx, float angle, float x, float y, float z);
-
-// Shader support (если GPU поддерживает)
-int opengl_supports_shaders(gpu_context_t* gpu);
-uint32_t opengl_create_shader(opengl_context_t* ctx, const char* source, int type);
-uint32_t opengl_create_program(opengl_context_t* ctx, uint32_t vertex_shader, uint32_t fragment_shader);
-
 #endif
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "keyboard.h"
 #include "../screen.h"
 #include "../text_output.h"
+#include "../gpu.h"
+#include "../frame.h"
 
 #define KEYBOARD_DATA_PORT 0x60
 #define KEYBOARD_STATUS_PORT 0x64
@@ -63,6 +65,9 @@ char scancode_to_char(unsigned char scancode) {
             return ' ';
         case 0x01: // Escape
             return 27;
+        case 0x58: // F12: frame profiler overlay
+            frame_toggle_overlay();
+            return 0;
     }
     
     // Regular keys
@@ -82,6 +87,9 @@ int kbhit() {
 }
 
 char keyboard_getchar() {
+    // Пока ждем ввода, показываем все, что успели нарисовать: накопленный
+    // вывод консоли или то, что нарисовано в обход кадров
+    if (!frame_flush()) gpu_swap_buffers();
     while (1) {
         if (kbhit()) {
             unsigned char scancode = keyboard_read_scancode();
@@ -92,6 +100,8 @@ char keyboard_getchar() {
                 return c;
             }
         }
+        // Пока клавиш нет, выводим накопившиеся изменения экрана (не чаще FRAME_RATE)
+        frame_tick();
         // Увеличиваем задержку для стабильности
         for (volatile int i = 0; i < 5000; i++);
     }
@@ -1,80 +1,83 @@
-// drivers/opengl.c - OpenGL implementation for hardware acceleration
-#include "gpu.h"
-#include "memory.h"
-#include "string.h"
-#include "math.h"
+// drivers/opengl.c - Программный конвейер OpenGL 1.x
+#include "opengl.h"
+#include "screen.h"
+#include "frame.h"
+#include "raster.h"
+#include "blit.h"
+#include "text_output.h"
+#include "../lib/string.h"
+#include "../lib/math.h"
+#include "../lib/matrix.h"
+#include "../lib/pages.h"
+#include "../lib/cpu.h"
 
 // OpenGL state machine
-static struct {
-    opengl_context_t* current_ctx;
-    uint32_t matrix_mode;
-    float modelview_matrix[16];
-    float projection_matrix[16];
-    float texture_matrix[16];
-    float* current_matrix;
-    uint32_t active_texture;
-    uint32_t blend_enabled;
-    uint32_t depth_test_enabled;
-    uint32_t cull_face_enabled;
-} gl_state;
+gl_state_t gl_state;
 
 // OpenGL context pool
 #define MAX_OPENGL_CONTEXTS 8
 static opengl_context_t opengl_contexts[MAX_OPENGL_CONTEXTS];
 static int opengl_context_count = 0;
 
-// Matrix operations
-static void matrix_identity(float* m) {
-    m[0] = 1.0f; m[1] = 0.0f; m[2] = 0.0f; m[3] = 0.0f;
-    m[4] = 0.0f; m[5] = 1.0f; m[6] = 0.0f; m[7] = 0.0f;
-    m[8] = 0.0f; m[9] = 0.0f; m[10] = 1.0f; m[11] = 0.0f;
-    m[12] = 0.0f; m[13] = 0.0f; m[14] = 0.0f; m[15] = 1.0f;
-}
-
-static void matrix_multiply(float* result, const float* a, const float* b) {
-    for (int i = 0; i < 4; i++) {
-        for (int j = 0; j < 4; j++) {
-            result[i * 4 + j] = 0.0f;
-            for (int k = 0; k < 4; k++) {
-                result[i * 4 + j] += a[i * 4 + k] * b[k * 4 + j];
-            }
-        }
+#define MAX_VERTICES 65536
+
+// Треугольник после отсечения шестью плоскостями: не больше 3 + 6 вершин
+#define CLIP_MAX_VERTICES 9
+
+// Плоскости пирамиды видимости в пространстве отсечения
+#define CLIP_LEFT   0x01    // x >= -w
+#define CLIP_RIGHT  0x02    // x <= w
+#define CLIP_BOTTOM 0x04    // y >= -w
+#define CLIP_TOP    0x08    // y <= w
+#define CLIP_NEAR   0x10    // z >= -w
+#define CLIP_FAR    0x20    // z <= w
+
+// Matrix operations (по столбцам, как в OpenGL: элемент (r, c) - m[c * 4 + r]);
+// умножение и преобразование вершин - в lib/matrix.c, с ядрами SSE
+
+// m = m * other: преобразование применяется к вершинам раньше уже накопленных
+static void matrix_apply(float* m, const float* other) {
+    matrix_multiply(m, m, other);
+}
+
+// Стеки glPushMatrix/glPopMatrix: по одному на режим, общие для контекстов,
+// как и сами матрицы. Глубина - минимум OpenGL для GL_MODELVIEW
+#define MATRIX_STACK_DEPTH 32
+
+static float matrix_stacks[3][MATRIX_STACK_DEPTH][16];
+static uint32_t matrix_stack_depth[3];
+
+static int matrix_stack_index(void) {
+    switch (gl_state.matrix_mode) {
+        case GL_PROJECTION: return 1;
+        case GL_TEXTURE: return 2;
+        default: return 0;
     }
 }
 
-static void matrix_translate(float* m, float x, float y, float z) {
-    float translation[16];
-    matrix_identity(translation);
-    translation[12] = x;
-    translation[13] = y;
-    translation[14] = z;
-    
-    float result[16];
-    matrix_multiply(result, m, translation);
-    memcpy(m, result, sizeof(float) * 16);
+// Матрицы операций: текущая матрица на них умножается
+static void matrix_translation(float* m, float x, float y, float z) {
+    matrix_identity(m);
+    m[12] = x;
+    m[13] = y;
+    m[14] = z;
 }
 
-static void matrix_scale(float* m, float x, float y, float z) {
-    float scale[16];
-    matrix_identity(scale);
-    scale[0] = x;
-    scale[5] = y;
-    scale[10] = z;
-    
-    float result[16];
-    matrix_multiply(result, m, scale);
-    memcpy(m, result, sizeof(float) * 16);
+static void matrix_scaling(float* m, float x, float y, float z) {
+    matrix_identity(m);
+    m[0] = x;
+    m[5] = y;
+    m[10] = z;
 }
 
-static void matrix_rotate(float* m, float angle, float x, float y, float z) {
-    float rad = angle * 3.14159265f / 180.0f;
+static void matrix_rotation(float* m, float angle, float x, float y, float z) {
+    float rad = angle * (float)M_PI / 180.0f;
     float c = cosf(rad);
     float s = sinf(rad);
     float one_minus_c = 1.0f - c;
-    
-    float rotation[16];
-    matrix_identity(rotation);
-    
+
+    matrix_identity(m);
+
     // Нормализуем ось вращения
     float length = sqrtf(x*x + y*y + z*z);
     if (length > 0.0f) {
@@ -82,22 +85,263 @@ static void matrix_rotate(float* m, float angle, float x, float y, float z) {
         y /= length;
         z /= length;
     }
-    
-    rotation[0] = x*x*one_minus_c + c;
-    rotation[1] = x*y*one_minus_c + z*s;
-    rotation[2] = x*z*one_minus_c - y*s;
-    
-    rotation[4] = x*y*one_minus_c - z*s;
-    rotation[5] = y*y*one_minus_c + c;
-    rotation[6] = y*z*one_minus_c + x*s;
-    
-    rotation[8] = x*z*one_minus_c + y*s;
-    rotation[9] = y*z*one_minus_c - x*s;
-    rotation[10] = z*z*one_minus_c + c;
-    
-    float result[16];
-    matrix_multiply(result, m, rotation);
-    memcpy(m, result, sizeof(float) * 16);
+
+    m[0] = x*x*one_minus_c + c;
+    m[1] = x*y*one_minus_c + z*s;
+    m[2] = x*z*one_minus_c - y*s;
+
+    m[4] = x*y*one_minus_c - z*s;
+    m[5] = y*y*one_minus_c + c;
+    m[6] = y*z*one_minus_c + x*s;
+
+    m[8] = x*z*one_minus_c + y*s;
+    m[9] = y*z*one_minus_c - x*s;
+    m[10] = z*z*one_minus_c + c;
+}
+
+// ==================== ЗАПИСЬ СПИСКОВ ====================
+
+#define MAX_LISTS 256
+#define LIST_MAX_NESTING 64     // Глубина glCallList, как GL_MAX_LIST_NESTING
+
+// Команда списка: слово (код | длина в словах с этим словом << 8), затем аргументы
+#define LIST_DRAW           1   // mode, count, цвет[4], текстура[2], вершины
+#define LIST_LOAD_MATRIX    2   // 16 float
+#define LIST_MULT_MATRIX    3   // 16 float
+#define LIST_MATRIX_MODE    4
+#define LIST_COLOR          5   // 4 float
+#define LIST_TEXCOORD       6   // 2 float
+#define LIST_ENABLE         7
+#define LIST_DISABLE        8
+#define LIST_BIND_TEXTURE   9
+#define LIST_DEPTH_FUNC     10
+#define LIST_CLEAR          11
+#define LIST_CALL           12
+#define LIST_PUSH_MATRIX    13
+#define LIST_POP_MATRIX     14
+#define LIST_DEPTH_MASK     15
+#define LIST_CLEAR_COLOR    16  // 4 float
+#define LIST_CLEAR_DEPTH    17  // float
+#define LIST_TEX_PARAMETER  18  // параметр, значение
+#define LIST_TEX_IMAGE      19  // ширина, высота, тексели
+#define LIST_VIEWPORT       20  // x, y, ширина, высота
+
+#define LIST_DRAW_HEADER    9   // Слов до вершин
+#define VERTEX_WORDS        (sizeof(gl_vertex_t) / 4)
+
+typedef struct {
+    int allocated;
+    uint32_t* commands;
+    uint32_t size;              // Слов записано
+    uint32_t pages;
+    uint32_t last;              // Начало последней команды
+} gl_list_t;
+
+static gl_list_t lists[MAX_LISTS];
+
+// Компилируемый список; он заменяет старое содержимое в opengl_end_list
+static gl_list_t list_building;
+
+// Вызов выполняется, а не только записывается
+static inline int list_executes(const opengl_context_t* ctx) {
+    return !ctx->list_compiling || ctx->list_mode == GL_COMPILE_AND_EXECUTE;
+}
+
+// Место под команду из words слов аргументов; NULL - нет памяти
+static uint32_t* list_command(uint32_t opcode, uint32_t words) {
+    gl_list_t* list = &list_building;
+    uint32_t need = list->size + 1 + words;
+
+    if (need * 4 > list->pages * PAGE_SIZE) {
+        // Растет вдвое, чтобы копирований было O(log n)
+        uint32_t pages = list->pages ? list->pages * 2 : 1;
+        while (pages * PAGE_SIZE < need * 4) pages *= 2;
+        uint32_t* commands = page_alloc(pages);
+        if (!commands) {
+            printf("GL: out of memory for a display list\n");
+            return NULL;
+        }
+        if (list->commands) {
+            memcpy(commands, list->commands, list->size * 4);
+            page_free(list->commands, list->pages);
+        }
+        list->commands = commands;
+        list->pages = pages;
+    }
+
+    uint32_t* command = &list->commands[list->size];
+    command[0] = opcode | ((1 + words) << 8);
+    list->last = list->size;
+    list->size = need;
+    return command + 1;
+}
+
+static void list_record(uint32_t opcode, const void* args, uint32_t words) {
+    uint32_t* command = list_command(opcode, words);
+    if (command && words) memcpy(command, args, words * 4);
+}
+
+// Подряд идущие операции над матрицей сворачиваются в одну готовую матрицу
+static void list_record_matrix(uint32_t opcode, const float* m) {
+    gl_list_t* list = &list_building;
+    if (list->size) {
+        uint32_t* last = &list->commands[list->last];
+        uint32_t last_opcode = last[0] & 0xFF;
+        if (last_opcode == LIST_LOAD_MATRIX || last_opcode == LIST_MULT_MATRIX) {
+            if (opcode == LIST_LOAD_MATRIX) {
+                // Загрузка отменяет накопленное
+                last[0] = LIST_LOAD_MATRIX | (17 << 8);
+                memcpy(last + 1, m, 16 * 4);
+            } else {
+                matrix_apply((float*)(last + 1), m);
+            }
+            return;
+        }
+    }
+    list_record(opcode, m, 16);
+}
+
+// Вершины копируются в список вместе с цветом и текстурой после них
+static void list_record_draw(opengl_context_t* ctx, uint32_t mode, const gl_vertex_t* vertices, uint32_t count) {
+    uint32_t* command = list_command(LIST_DRAW, LIST_DRAW_HEADER - 1 + count * VERTEX_WORDS);
+    if (!command) return;
+
+    command[0] = mode;
+    command[1] = count;
+    memcpy(command + 2, ctx->current_color, 4 * 4);
+    memcpy(command + 6, ctx->current_texcoord, 2 * 4);
+    memcpy(command + 8, vertices, count * sizeof(gl_vertex_t));
+}
+
+// Матрица операции: в список, в текущую матрицу или в оба
+static void matrix_op(opengl_context_t* ctx, const float* m) {
+    if (ctx->list_compiling) list_record_matrix(LIST_MULT_MATRIX, m);
+    if (list_executes(ctx)) matrix_apply(gl_state.current_matrix, m);
+}
+
+// ==================== БУФЕР ГЛУБИНЫ ====================
+
+static inline uint32_t depth_max(const opengl_context_t* ctx) {
+    return ctx->depth_bits == 16 ? 0xFFFF : 0xFFFFFFFF;
+}
+
+// Очистка только помечает плитки: в буфер она попадает при первом касании плитки
+static void depth_clear_tiles(opengl_context_t* ctx) {
+    int tiles = ctx->depth_tiles_x * ctx->depth_tiles_y;
+    for (int i = 0; i < tiles; i++) {
+        ctx->tile_min[i] = ctx->clear_depth;
+        ctx->tile_max[i] = ctx->clear_depth;
+        ctx->tile_cleared[i] = 1;
+    }
+}
+
+static void depth_fill_tile(opengl_context_t* ctx, int tile, int x, int y) {
+    int width = (x + RASTER_TILE <= ctx->width) ? RASTER_TILE : ctx->width - x;
+    int height = (y + RASTER_TILE <= ctx->height) ? RASTER_TILE : ctx->height - y;
+
+    for (int row = 0; row < height; row++) {
+        int offset = (y + row) * ctx->width + x;
+        if (ctx->depth_bits == 16) {
+            uint16_t* d = (uint16_t*)ctx->depth_buffer + offset;
+            for (int i = 0; i < width; i++) d[i] = (uint16_t)ctx->clear_depth;
+        } else {
+            blit_fill32((uint32_t*)ctx->depth_buffer + offset, ctx->clear_depth, width);
+        }
+    }
+    ctx->tile_cleared[tile] = 0;
+}
+
+static int depth_alloc(opengl_context_t* ctx) {
+    int tiles_x = (ctx->width + RASTER_TILE - 1) / RASTER_TILE;
+    int tiles_y = (ctx->height + RASTER_TILE - 1) / RASTER_TILE;
+    uint32_t tiles = (uint32_t)tiles_x * tiles_y;
+    // Значения, границы плиток и флаги очистки - одним куском
+    uint32_t buffer_bytes = ((uint32_t)ctx->width * ctx->height * (ctx->depth_bits / 8) + 3) & ~3u;
+    uint32_t pages = pages_for_bytes(buffer_bytes + tiles * 2 * sizeof(uint32_t) + tiles);
+
+    uint8_t* memory = page_alloc(pages);
+    if (!memory) return 0;
+
+    ctx->depth_buffer = memory;
+    ctx->depth_pages = pages;
+    ctx->depth_tiles_x = tiles_x;
+    ctx->depth_tiles_y = tiles_y;
+    ctx->tile_min = (uint32_t*)(memory + buffer_bytes);
+    ctx->tile_max = ctx->tile_min + tiles;
+    ctx->tile_cleared = (uint8_t*)(ctx->tile_max + tiles);
+    depth_clear_tiles(ctx);
+    return 1;
+}
+
+static void depth_free(opengl_context_t* ctx) {
+    if (!ctx->depth_buffer) return;
+    page_free(ctx->depth_buffer, ctx->depth_pages);
+    ctx->depth_buffer = NULL;
+    ctx->tile_min = ctx->tile_max = NULL;
+    ctx->tile_cleared = NULL;
+}
+
+int opengl_depth_bits(opengl_context_t* ctx, int bits) {
+    if (bits != 16 && bits != 32) return 0;
+
+    depth_free(ctx);
+    if (bits != ctx->depth_bits) {
+        ctx->clear_depth = (bits == 16) ? ctx->clear_depth >> 16 : ctx->clear_depth * 0x10001;
+        ctx->depth_bits = bits;
+    }
+    return depth_alloc(ctx);
+}
+
+void opengl_depth_func(opengl_context_t* ctx, uint32_t func) {
+    if (ctx->list_compiling) list_record(LIST_DEPTH_FUNC, &func, 1);
+    if (!list_executes(ctx)) return;
+    if (func >= GL_NEVER && func <= GL_ALWAYS) ctx->depth_func = func;
+}
+
+void opengl_depth_mask(opengl_context_t* ctx, int write) {
+    if (ctx->list_compiling) list_record(LIST_DEPTH_MASK, &write, 1);
+    if (!list_executes(ctx)) return;
+    ctx->depth_write = write;
+}
+
+void opengl_clear_depth(opengl_context_t* ctx, float depth) {
+    if (ctx->list_compiling) list_record(LIST_CLEAR_DEPTH, &depth, 1);
+    if (!list_executes(ctx)) return;
+    if (depth < 0.0f) depth = 0.0f;
+    if (depth > 1.0f) depth = 1.0f;
+    ctx->clear_depth = (uint32_t)(int64_t)((double)depth * depth_max(ctx));
+}
+
+// Буфер глубины для отрисовки: нужен, только если тест включен
+static int depth_ready(opengl_context_t* ctx) {
+    if (!gl_state.depth_test_enabled) return 0;
+    return ctx->depth_buffer || depth_alloc(ctx);
+}
+
+static inline int depth_pass(uint32_t func, uint32_t value, uint32_t stored) {
+    switch (func) {
+        case GL_LESS: return value < stored;
+        case GL_LEQUAL: return value <= stored;
+        case GL_GREATER: return value > stored;
+        case GL_GEQUAL: return value >= stored;
+        case GL_EQUAL: return value == stored;
+        case GL_NOTEQUAL: return value != stored;
+        case GL_ALWAYS: return 1;
+        default: return 0;
+    }
+}
+
+// Ни один пиксель треугольника со значениями [low, high] не пройдет тест
+// против значений плитки [tile_min, tile_max]
+static int depth_tile_hidden(uint32_t func, uint32_t low, uint32_t high, uint32_t tile_min, uint32_t tile_max) {
+    switch (func) {
+        case GL_LESS: return low >= tile_max;
+        case GL_LEQUAL: return low > tile_max;
+        case GL_GREATER: return high <= tile_min;
+        case GL_GEQUAL: return high < tile_min;
+        case GL_EQUAL: return high < tile_min || low > tile_max;
+        default: return 0;
+    }
 }
 
 // OpenGL context management
@@ -105,110 +349,1008 @@ opengl_context_t* opengl_create_context(gpu_context_t* gpu) {
     if (opengl_context_count >= MAX_OPENGL_CONTEXTS) {
         return NULL;
     }
-    
+
+    int width = (gpu && gpu->width) ? (int)gpu->width : framebuffer_width;
+    int height = (gpu && gpu->height) ? (int)gpu->height : framebuffer_height;
+    if (width <= 0 || height <= 0) return NULL;
+
+    // Вершины и их преобразованные копии - одним куском
+    uint32_t vertex_bytes = MAX_VERTICES * sizeof(gl_vertex_t);
+    uint32_t vertex_pages = pages_for_bytes(vertex_bytes + MAX_VERTICES * sizeof(gl_clip_vertex_t));
+    uint8_t* vertices = page_alloc(vertex_pages);
+    if (!vertices) return NULL;
+
+    uint32_t color_pages = pages_for_bytes((uint32_t)width * height * 4);
+    uint32_t* color_buffer = page_alloc(color_pages);
+    if (!color_buffer) {
+        page_free(vertices, vertex_pages);
+        return NULL;
+    }
+
     opengl_context_t* ctx = &opengl_contexts[opengl_context_count++];
-    
+    memset(ctx, 0, sizeof(*ctx));
+
     ctx->gpu = gpu;
-    ctx->current_texture = 0;
-    ctx->viewport_x = 0;
-    ctx->viewport_y = 0;
-    ctx->viewport_width = gpu->width;
-    ctx->viewport_height = gpu->height;
+    ctx->viewport_width = width;
+    ctx->viewport_height = height;
     ctx->clear_color = 0xFF000000; // Черный
-    
-    // Выделяем память под вершинный буфер
-    ctx->max_vertices = 65536; // Максимум 65536 вершин
-    ctx->vertex_buffer = (float*)kmalloc(ctx->max_vertices * 8 * sizeof(float)); // x,y,z,r,g,b,a,u,v
-    ctx->vertex_count = 0;
-    
-    // Инициализируем матрицы
-    matrix_identity(gl_state.modelview_matrix);
-    matrix_identity(gl_state.projection_matrix);
-    matrix_identity(gl_state.texture_matrix);
-    
+
+    ctx->max_vertices = MAX_VERTICES;
+    ctx->vertex_buffer = (gl_vertex_t*)vertices;
+    ctx->clip_buffer = (gl_clip_vertex_t*)(vertices + vertex_bytes);
+    ctx->vertex_pages = vertex_pages;
+    ctx->primitive_mode = GL_TRIANGLES;
+    ctx->current_color[0] = ctx->current_color[1] = ctx->current_color[2] = ctx->current_color[3] = 1.0f;
+
+    ctx->color_buffer = color_buffer;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->color_pages = color_pages;
+
+    // Буфер глубины выделяется при первой отрисовке с GL_DEPTH_TEST
+    ctx->depth_bits = 32;
+    ctx->depth_func = GL_LESS;
+    ctx->depth_write = 1;
+    ctx->clear_depth = 0xFFFFFFFF;
+
+    if (!gl_state.current_ctx) {
+        // Инициализируем матрицы
+        matrix_identity(gl_state.modelview_matrix);
+        matrix_identity(gl_state.projection_matrix);
+        matrix_identity(gl_state.texture_matrix);
+        gl_state.matrix_mode = GL_MODELVIEW;
+        gl_state.current_matrix = gl_state.modelview_matrix;
+        gl_state.current_ctx = ctx;
+    }
+
     return ctx;
 }
 
 void opengl_destroy_context(opengl_context_t* ctx) {
-    if (ctx && ctx->vertex_buffer) {
-        kfree(ctx->vertex_buffer);
+    if (!ctx) return;
+
+    if (ctx->vertex_buffer) {
+        page_free(ctx->vertex_buffer, ctx->vertex_pages);
         ctx->vertex_buffer = NULL;
+        ctx->clip_buffer = NULL;
+    }
+    if (ctx->color_buffer) {
+        page_free(ctx->color_buffer, ctx->color_pages);
+        ctx->color_buffer = NULL;
+    }
+    depth_free(ctx);
+    if (gl_state.current_ctx == ctx) gl_state.current_ctx = NULL;
+}
+
+void opengl_make_current(opengl_context_t* ctx) {
+    gl_state.current_ctx = ctx;
+}
+
+void opengl_present(opengl_context_t* ctx, int x, int y) {
+    if (!ctx || !ctx->color_buffer) return;
+
+    framebuffer_reset_clip();
+    for (int row = 0; row < ctx->height; row++) {
+        framebuffer_draw_span(x, y + row, &ctx->color_buffer[row * ctx->width], ctx->width, SPAN_COPY);
     }
 }
 
 void opengl_clear(opengl_context_t* ctx, uint32_t mask) {
-    if (mask & GL_COLOR_BUFFER_BIT) {
-        gpu_clear(ctx->clear_color);
+    if (ctx->list_compiling) list_record(LIST_CLEAR, &mask, 1);
+    if (!list_executes(ctx)) return;
+    if ((mask & GL_COLOR_BUFFER_BIT) && ctx->color_buffer) {
+        blit_fill32(ctx->color_buffer, ctx->clear_color, ctx->width * ctx->height);
+    }
+    if ((mask & GL_DEPTH_BUFFER_BIT) && ctx->depth_buffer) {
+        depth_clear_tiles(ctx);
     }
 }
 
 void opengl_viewport(opengl_context_t* ctx, int x, int y, int width, int height) {
+    if (ctx->list_compiling) {
+        int viewport[4] = {x, y, width, height};
+        list_record(LIST_VIEWPORT, viewport, 4);
+    }
+    if (!list_executes(ctx)) return;
     ctx->viewport_x = x;
     ctx->viewport_y = y;
     ctx->viewport_width = width;
     ctx->viewport_height = height;
-    
-    // Устанавливаем viewport в GPU
-    if (ctx->gpu && ctx->gpu->mmio_base) {
-        // Здесь будет вызов GPU viewport функции
-    }
 }
 
 void opengl_clear_color(opengl_context_t* ctx, float r, float g, float b, float a) {
+    if (ctx->list_compiling) {
+        float color[4] = {r, g, b, a};
+        list_record(LIST_CLEAR_COLOR, color, 4);
+    }
+    if (!list_executes(ctx)) return;
+
     // Конвертируем float цвет в 32-битный ARGB
     uint8_t red = (uint8_t)(r * 255.0f);
     uint8_t green = (uint8_t)(g * 255.0f);
     uint8_t blue = (uint8_t)(b * 255.0f);
     uint8_t alpha = (uint8_t)(a * 255.0f);
-    
+
     ctx->clear_color = (alpha << 24) | (red << 16) | (green << 8) | blue;
 }
 
+void opengl_enable(opengl_context_t* ctx, uint32_t capability) {
+    if (ctx->list_compiling) list_record(LIST_ENABLE, &capability, 1);
+    if (!list_executes(ctx)) return;
+    switch (capability) {
+        case GL_DEPTH_TEST: gl_state.depth_test_enabled = 1; break;
+        case GL_BLEND: gl_state.blend_enabled = 1; break;
+        case GL_CULL_FACE: gl_state.cull_face_enabled = 1; break;
+        case GL_TEXTURE_2D: gl_state.texture_2d_enabled = 1; break;
+    }
+}
+
+void opengl_disable(opengl_context_t* ctx, uint32_t capability) {
+    if (ctx->list_compiling) list_record(LIST_DISABLE, &capability, 1);
+    if (!list_executes(ctx)) return;
+    switch (capability) {
+        case GL_DEPTH_TEST: gl_state.depth_test_enabled = 0; break;
+        case GL_BLEND: gl_state.blend_enabled = 0; break;
+        case GL_CULL_FACE: gl_state.cull_face_enabled = 0; break;
+        case GL_TEXTURE_2D: gl_state.texture_2d_enabled = 0; break;
+    }
+}
+
+// ==================== ТЕКСТУРЫ ====================
+
+#define MAX_TEXTURES 64
+#define TEXTURE_MAX_SIZE 1024
+#define TEXTURE_MAX_LEVELS 11           // 1024 .. 1
+#define TEXTURE_DEFAULT_BUDGET 2048     // Страниц (8 МБ)
+
+// Уровень хранится плитками 4x4: 16 соседних по вертикали и горизонтали
+// текселей - в одной 64-байтной строке кэша
+typedef struct {
+    uint32_t* texels;
+    int width, height;
+    int tiles_x;
+} gl_texture_level_t;
+
+typedef struct {
+    int allocated;
+    int levels;                 // 0 - данных нет (не загружена или вытеснена)
+    gl_texture_level_t level[TEXTURE_MAX_LEVELS];
+    uint32_t pages;
+    uint32_t min_filter, mag_filter;
+    uint32_t wrap_s, wrap_t;
+    int generate_mipmap;
+    uint32_t last_used;         // Для вытеснения давно не использованных
+} gl_texture_t;
+
+static gl_texture_t textures[MAX_TEXTURES];
+static uint32_t texture_budget = TEXTURE_DEFAULT_BUDGET;
+static uint32_t texture_pages = 0;
+static uint32_t texture_evictions = 0;
+static uint32_t texture_clock = 0;
+
+static gl_texture_t* texture_get(uint32_t id) {
+    if (id == 0 || id > MAX_TEXTURES || !textures[id - 1].allocated) return NULL;
+    return &textures[id - 1];
+}
+
+static inline uint32_t* texel_address(const gl_texture_level_t* level, int x, int y) {
+    return &level->texels[(((y >> 2) * level->tiles_x + (x >> 2)) << 4) + ((y & 3) << 2) + (x & 3)];
+}
+
+static void texture_release(gl_texture_t* texture) {
+    if (!texture->levels) return;
+    page_free(texture->level[0].texels, texture->pages);
+    texture_pages -= texture->pages;
+    texture->levels = 0;
+}
+
+// Освобождает давно не использованные текстуры, пока не поместится pages
+static int texture_make_room(uint32_t pages, const gl_texture_t* keep) {
+    while (texture_pages + pages > texture_budget) {
+        gl_texture_t* oldest = NULL;
+        for (int i = 0; i < MAX_TEXTURES; i++) {
+            gl_texture_t* t = &textures[i];
+            if (t == keep || !t->levels) continue;
+            if (!oldest || t->last_used < oldest->last_used) oldest = t;
+        }
+        if (!oldest) return 0;
+        texture_release(oldest);
+        texture_evictions++;
+    }
+    return 1;
+}
+
+static inline int is_power_of_two(int x) {
+    return x > 0 && (x & (x - 1)) == 0;
+}
+
+// Уровень level из предыдущего: среднее 2x2 (2x1 у вытянутых текстур)
+static void texture_downsample(gl_texture_t* texture, int level) {
+    const gl_texture_level_t* src = &texture->level[level - 1];
+    gl_texture_level_t* dst = &texture->level[level];
+    int sx = src->width > 1 ? 1 : 0;
+    int sy = src->height > 1 ? 1 : 0;
+
+    for (int y = 0; y < dst->height; y++) {
+        for (int x = 0; x < dst->width; x++) {
+            uint32_t p[4] = {
+                *texel_address(src, x << sx, y << sy),
+                *texel_address(src, (x << sx) + sx, y << sy),
+                *texel_address(src, x << sx, (y << sy) + sy),
+                *texel_address(src, (x << sx) + sx, (y << sy) + sy),
+            };
+            uint32_t result = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t sum = 2;
+                for (int i = 0; i < 4; i++) sum += (p[i] >> shift) & 0xFF;
+                result |= (sum >> 2) << shift;
+            }
+            *texel_address(dst, x, y) = result;
+        }
+    }
+}
+
+uint32_t opengl_gen_texture(opengl_context_t* ctx) {
+    for (int i = 0; i < MAX_TEXTURES; i++) {
+        gl_texture_t* t = &textures[i];
+        if (t->allocated) continue;
+
+        memset(t, 0, sizeof(*t));
+        t->allocated = 1;
+        t->min_filter = GL_NEAREST_MIPMAP_LINEAR;     // Значения по умолчанию OpenGL
+        t->mag_filter = GL_LINEAR;
+        t->wrap_s = GL_REPEAT;
+        t->wrap_t = GL_REPEAT;
+        return i + 1;
+    }
+    return 0;
+}
+
+void opengl_delete_texture(opengl_context_t* ctx, uint32_t texture) {
+    gl_texture_t* t = texture_get(texture);
+    if (!t) return;
+
+    texture_release(t);
+    t->allocated = 0;
+    if (ctx && ctx->current_texture == texture) ctx->current_texture = 0;
+}
+
+void opengl_bind_texture(opengl_context_t* ctx, uint32_t texture) {
+    if (ctx->list_compiling) list_record(LIST_BIND_TEXTURE, &texture, 1);
+    if (!list_executes(ctx)) return;
+    ctx->current_texture = texture;
+}
+
+void opengl_tex_image2d(opengl_context_t* ctx, int width, int height, const void* data) {
+    if (!data) return;
+    if (!is_power_of_two(width) || !is_power_of_two(height) ||
+        width > TEXTURE_MAX_SIZE || height > TEXTURE_MAX_SIZE) {
+        printf("GL: texture size %dx%d is not a power of two up to %d\n", width, height, TEXTURE_MAX_SIZE);
+        return;
+    }
+
+    // Как в OpenGL 1.0: список хранит копию изображения
+    if (ctx->list_compiling) {
+        uint32_t* command = list_command(LIST_TEX_IMAGE, 2 + width * height);
+        if (command) {
+            command[0] = width;
+            command[1] = height;
+            memcpy(command + 2, data, width * height * 4);
+        }
+    }
+    if (!list_executes(ctx)) return;
+
+    gl_texture_t* t = texture_get(ctx->current_texture);
+    if (!t) return;
+
+    texture_release(t);
+
+    // Размеры уровней; каждый дополнен до целых плиток
+    gl_texture_level_t levels[TEXTURE_MAX_LEVELS];
+    int count = 0;
+    uint32_t texels = 0;
+    int w = width, h = height;
+    while (count < TEXTURE_MAX_LEVELS) {
+        levels[count].width = w;
+        levels[count].height = h;
+        levels[count].tiles_x = (w + 3) / 4;
+        texels += (uint32_t)levels[count].tiles_x * ((h + 3) / 4) * 16;
+        count++;
+        if (!t->generate_mipmap || (w == 1 && h == 1)) break;
+        if (w > 1) w >>= 1;
+        if (h > 1) h >>= 1;
+    }
+
+    uint32_t pages = pages_for_bytes(texels * 4);
+    if (pages > texture_budget || !texture_make_room(pages, t)) {
+        printf("GL: texture %dx%d exceeds the texture memory budget\n", width, height);
+        return;
+    }
+    uint32_t* memory = page_alloc(pages);
+    // Физической памяти не хватило: вытесняем все остальное и пробуем еще раз
+    if (!memory && texture_make_room(texture_budget, t)) memory = page_alloc(pages);
+    if (!memory) {
+        printf("GL: out of memory for a %dx%d texture\n", width, height);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        levels[i].texels = memory;
+        memory += levels[i].tiles_x * ((levels[i].height + 3) / 4) * 16;
+        t->level[i] = levels[i];
+    }
+    t->levels = count;
+    t->pages = pages;
+    t->last_used = ++texture_clock;
+    texture_pages += pages;
+
+    const uint32_t* src = data;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            *texel_address(&t->level[0], x, y) = src[y * width + x];
+        }
+    }
+    for (int i = 1; i < count; i++) texture_downsample(t, i);
+}
+
+void opengl_tex_parameteri(opengl_context_t* ctx, uint32_t param, int value) {
+    if (ctx->list_compiling) {
+        uint32_t args[2] = {param, (uint32_t)value};
+        list_record(LIST_TEX_PARAMETER, args, 2);
+    }
+    if (!list_executes(ctx)) return;
+
+    gl_texture_t* t = texture_get(ctx->current_texture);
+    if (!t) return;
+
+    switch (param) {
+        case GL_TEXTURE_MIN_FILTER: t->min_filter = value; break;
+        case GL_TEXTURE_MAG_FILTER: t->mag_filter = value; break;
+        case GL_TEXTURE_WRAP_S: t->wrap_s = value; break;
+        case GL_TEXTURE_WRAP_T: t->wrap_t = value; break;
+        // Как в OpenGL 1.4: мипмапы строятся при следующей загрузке
+        case GL_GENERATE_MIPMAP: t->generate_mipmap = value; break;
+    }
+}
+
+int opengl_texture_resident(uint32_t texture) {
+    gl_texture_t* t = texture_get(texture);
+    return t && t->levels;
+}
+
+void opengl_texture_budget(uint32_t pages) {
+    texture_budget = pages;
+    texture_make_room(0, NULL);
+}
+
+void opengl_texture_stats(uint32_t* resident, uint32_t* pages, uint32_t* evictions) {
+    uint32_t count = 0;
+    for (int i = 0; i < MAX_TEXTURES; i++) {
+        if (textures[i].allocated && textures[i].levels) count++;
+    }
+    *resident = count;
+    *pages = texture_pages;
+    *evictions = texture_evictions;
+}
+
+// Текстура для отрисовки: включена, привязана и загружена
+static gl_texture_t* texture_active(opengl_context_t* ctx) {
+    if (!gl_state.texture_2d_enabled) return NULL;
+    gl_texture_t* t = texture_get(ctx->current_texture);
+    return (t && t->levels) ? t : NULL;
+}
+
+// Координата текселя в пределах уровня
+static inline int texture_wrap(int x, int size, uint32_t mode) {
+    if (mode == GL_REPEAT) return x & (size - 1);
+    if (x < 0) return 0;
+    if (x >= size) return size - 1;
+    return x;
+}
+
+// Смесь двух ARGB с весом f (0..256) у b: два канала за одно умножение
+static inline uint32_t texel_lerp(uint32_t a, uint32_t b, uint32_t f) {
+    uint32_t rb = (((a & 0xFF00FF) * (256 - f) + (b & 0xFF00FF) * f) >> 8) & 0xFF00FF;
+    uint32_t ag = (((a >> 8) & 0xFF00FF) * (256 - f) + ((b >> 8) & 0xFF00FF) * f) & 0xFF00FF00;
+    return rb | ag;
+}
+
+// u, v - в текселях уровня, 16.16
+static inline uint32_t texture_sample(const gl_texture_level_t* level, int32_t u, int32_t v,
+                                      int linear, uint32_t wrap_s, uint32_t wrap_t) {
+    if (!linear) {
+        return *texel_address(level, texture_wrap(u >> 16, level->width, wrap_s),
+                              texture_wrap(v >> 16, level->height, wrap_t));
+    }
+
+    // Центры текселей - в половинах
+    u -= 0x8000;
+    v -= 0x8000;
+    int x0 = texture_wrap(u >> 16, level->width, wrap_s);
+    int x1 = texture_wrap((u >> 16) + 1, level->width, wrap_s);
+    int y0 = texture_wrap(v >> 16, level->height, wrap_t);
+    int y1 = texture_wrap((v >> 16) + 1, level->height, wrap_t);
+    uint32_t fx = ((uint32_t)u >> 8) & 0xFF;
+    uint32_t fy = ((uint32_t)v >> 8) & 0xFF;
+
+    uint32_t top = texel_lerp(*texel_address(level, x0, y0), *texel_address(level, x1, y0), fx);
+    uint32_t bottom = texel_lerp(*texel_address(level, x0, y1), *texel_address(level, x1, y1), fx);
+    return texel_lerp(top, bottom, fy);
+}
+
+// ==================== РАСТЕРИЗАЦИЯ ====================
+
+// Треугольник для span-функции: цвет линейно по экрану, в 16.16
+typedef struct {
+    opengl_context_t* ctx;
+    const rect_t* clip;
+    int flat;               // Все вершины одного цвета
+    uint32_t color;
+    float origin_x, origin_y;
+    float base[4];          // r, g, b, a (0..255 << 16) в origin
+    float dx[4], dy[4];     // На пиксель вправо / вниз
+    int32_t step[4];
+
+    // Глубина в единицах буфера: в origin и на пиксель; в span - 48.16
+    int depth;
+    double z_base, z_dx, z_dy;
+    int64_t z_step;
+
+    // Текстура: линейны по экрану u / w, v / w и 1 / w
+    const gl_texture_t* texture;
+    const gl_texture_level_t* level;
+    int linear;
+    float uq_base, uq_dx, uq_dy;
+    float vq_base, vq_dx, vq_dy;
+    float q_base, q_dx, q_dy;
+} shade_t;
+
+static inline uint32_t channel(int32_t value) {
+    if (value < 0) return 0;
+    if (value > 0xFFFFFF) return 255;
+    return (uint32_t)value >> 16;
+}
+
+static uint32_t pack_color(const gl_clip_vertex_t* v) {
+    return (channel((int32_t)(v->a * 0xFFFFFF)) << 24) | (channel((int32_t)(v->r * 0xFFFFFF)) << 16) |
+           (channel((int32_t)(v->g * 0xFFFFFF)) << 8) | channel((int32_t)(v->b * 0xFFFFFF));
+}
+
+static inline uint32_t pack_channels(const int32_t* c) {
+    return (channel(c[3]) << 24) | (channel(c[0]) << 16) | (channel(c[1]) << 8) | channel(c[2]);
+}
+
+static inline uint32_t depth_clamp(int64_t z, uint32_t max) {
+    if (z < 0) return 0;
+    if (z > (int64_t)max) return max;
+    return (uint32_t)z;
+}
+
+// Глубина первого пикселя span в 48.16
+static int64_t span_depth(const shade_t* s, int x0, int y) {
+    double fx = x0 + 0.5 - s->origin_x;
+    double fy = y + 0.5 - s->origin_y;
+    return (int64_t)((s->z_base + s->z_dx * fx + s->z_dy * fy) * 65536.0);
+}
+
+// Тест глубины пикселя offset; прошедшее тест значение записывается
+static inline int depth_test(opengl_context_t* ctx, int offset, uint32_t value) {
+    if (ctx->depth_bits == 16) {
+        uint16_t* d = (uint16_t*)ctx->depth_buffer + offset;
+        if (!depth_pass(ctx->depth_func, value, *d)) return 0;
+        if (ctx->depth_write) *d = (uint16_t)value;
+    } else {
+        uint32_t* d = (uint32_t*)ctx->depth_buffer + offset;
+        if (!depth_pass(ctx->depth_func, value, *d)) return 0;
+        if (ctx->depth_write) *d = value;
+    }
+    return 1;
+}
+
+// Пиксели, не прошедшие тест глубины, не закрашиваются
+static void shade_span_depth(shade_t* s, uint32_t* dst, int y, int x0, int count, int32_t* c) {
+    opengl_context_t* ctx = s->ctx;
+    uint32_t max = depth_max(ctx);
+    int offset = y * ctx->width + x0;
+    uint32_t color = s->color;
+    int64_t z = span_depth(s, x0, y);
+
+    for (int i = 0; i < count; i++) {
+        if (depth_test(ctx, offset + i, depth_clamp(z >> 16, max))) {
+            if (!s->flat) color = pack_channels(c);
+            dst[i] = color;
+        }
+        z += s->z_step;
+        if (!s->flat) {
+            for (int k = 0; k < 4; k++) c[k] += s->step[k];
+        }
+    }
+}
+
+static void shade_span(int y, int x0, int x1, void* context) {
+    shade_t* s = context;
+    uint32_t* dst = &s->ctx->color_buffer[y * s->ctx->width + x0];
+    int count = x1 - x0;
+
+    if (s->flat && !s->depth) {
+        blit_fill32(dst, s->color, count);
+        return;
+    }
+
+    // Одно преобразование float -> int на канал за span, дальше сложения
+    float fx = x0 + 0.5f - s->origin_x;
+    float fy = y + 0.5f - s->origin_y;
+    int32_t c[4];
+    if (!s->flat) {
+        for (int k = 0; k < 4; k++) {
+            c[k] = (int32_t)(s->base[k] + s->dx[k] * fx + s->dy[k] * fy);
+        }
+    }
+    if (s->depth) {
+        shade_span_depth(s, dst, y, x0, count, c);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        dst[i] = pack_channels(c);
+        for (int k = 0; k < 4; k++) c[k] += s->step[k];
+    }
+}
+
+// Точное деление на w - на границах отрезков такой длины, внутри линейно
+#define TEXTURE_SEGMENT 16
+
+static inline uint32_t modulate(uint32_t texel, uint32_t color) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t t = (texel >> shift) & 0xFF;
+        uint32_t c = (color >> shift) & 0xFF;
+        result |= ((t * (c + 1)) >> 8) << shift;
+    }
+    return result;
+}
+
+// Тексели в 16.16; дальше 32K текселей координата не уходит
+static inline int32_t texture_fixed(float x) {
+    if (x > 32767.0f) x = 32767.0f;
+    if (x < -32767.0f) x = -32767.0f;
+    return (int32_t)(x * 65536.0f);
+}
+
+static void texture_span(int y, int x0, int x1, void* context) {
+    shade_t* s = context;
+    opengl_context_t* ctx = s->ctx;
+    const gl_texture_level_t* level = s->level;
+    uint32_t wrap_s = s->texture->wrap_s;
+    uint32_t wrap_t = s->texture->wrap_t;
+    int offset = y * ctx->width + x0;
+    uint32_t* dst = &ctx->color_buffer[offset];
+    int count = x1 - x0;
+    float fx = x0 + 0.5f - s->origin_x;
+    float fy = y + 0.5f - s->origin_y;
+
+    uint32_t color = s->color;
+    int32_t c[4];
+    if (!s->flat) {
+        for (int k = 0; k < 4; k++) c[k] = (int32_t)(s->base[k] + s->dx[k] * fx + s->dy[k] * fy);
+    }
+    // Белый цвет вершин текстуру не меняет
+    int plain = s->flat && color == 0xFFFFFFFF;
+    uint32_t max = depth_max(ctx);
+    int64_t z = s->depth ? span_depth(s, x0, y) : 0;
+
+    float width = level->width;
+    float height = level->height;
+    float uq = s->uq_base + s->uq_dx * fx + s->uq_dy * fy;
+    float vq = s->vq_base + s->vq_dx * fx + s->vq_dy * fy;
+    float q = s->q_base + s->q_dx * fx + s->q_dy * fy;
+    float u0 = uq / q * width;
+    float v0 = vq / q * height;
+
+    for (int i = 0; i < count;) {
+        int n = (count - i < TEXTURE_SEGMENT) ? count - i : TEXTURE_SEGMENT;
+        uq += s->uq_dx * n;
+        vq += s->vq_dx * n;
+        q += s->q_dx * n;
+        if (q < 1e-6f) q = 1e-6f;
+        float u1 = uq / q * width;
+        float v1 = vq / q * height;
+
+        // Целые повторы текстуры вычитаются, чтобы хватило 16.16
+        float ou = (wrap_s == GL_REPEAT) ? floorf(u0 / width) * width : 0.0f;
+        float ov = (wrap_t == GL_REPEAT) ? floorf(v0 / height) * height : 0.0f;
+        int32_t u = texture_fixed(u0 - ou);
+        int32_t v = texture_fixed(v0 - ov);
+        int32_t du = (texture_fixed(u1 - ou) - u) / n;
+        int32_t dv = (texture_fixed(v1 - ov) - v) / n;
+
+        for (int k = 0; k < n; k++, i++) {
+            if (!s->depth || depth_test(ctx, offset + i, depth_clamp(z >> 16, max))) {
+                uint32_t texel = texture_sample(level, u, v, s->linear, wrap_s, wrap_t);
+                if (!s->flat) color = pack_channels(c);
+                dst[i] = plain ? texel : modulate(texel, color);
+            }
+            u += du;
+            v += dv;
+            z += s->z_step;
+            if (!s->flat) {
+                for (int j = 0; j < 4; j++) c[j] += s->step[j];
+            }
+        }
+        u0 = u1;
+        v0 = v1;
+    }
+}
+
+// Уровень и фильтр по отношению площадей треугольника в текселях и в пикселях
+static void texture_setup(shade_t* s, const gl_texture_t* t, float area,
+                          const gl_clip_vertex_t* a, const gl_clip_vertex_t* b, const gl_clip_vertex_t* c) {
+    float du1 = (b->u - a->u) * t->level[0].width;
+    float dv1 = (b->v - a->v) * t->level[0].height;
+    float du2 = (c->u - a->u) * t->level[0].width;
+    float dv2 = (c->v - a->v) * t->level[0].height;
+    float ratio = fabsf(du1 * dv2 - du2 * dv1) / fabsf(area);
+
+    int level = 0;
+    uint32_t filter = t->mag_filter;
+    if (ratio > 1.0f) {
+        filter = t->min_filter;
+        if (filter != GL_NEAREST && filter != GL_LINEAR) {
+            // Каждый уровень - вчетверо меньше текселей
+            while (ratio >= 4.0f && level + 1 < t->levels) {
+                ratio *= 0.25f;
+                level++;
+            }
+        }
+    }
+
+    s->texture = t;
+    s->level = &t->level[level];
+    s->linear = filter == GL_LINEAR || filter == GL_LINEAR_MIPMAP_NEAREST || filter == GL_LINEAR_MIPMAP_LINEAR;
+}
+
+// Ранний отказ по границам глубины плитки; затем в плитку записывается
+// отложенная очистка, а границы сужаются или расширяются под запись
+static int shade_tile(int x, int y, int full, void* context) {
+    shade_t* s = context;
+    opengl_context_t* ctx = s->ctx;
+    int tile = (y / RASTER_TILE) * ctx->depth_tiles_x + x / RASTER_TILE;
+    uint32_t max = depth_max(ctx);
+
+    // Плоскость глубины линейна: крайние значения - в углах плитки. На единицу
+    // шире из-за округления пошагового счета в span
+    double z = s->z_base + s->z_dx * (x + 0.5 - s->origin_x) + s->z_dy * (y + 0.5 - s->origin_y);
+    double ex = s->z_dx * (RASTER_TILE - 1);
+    double ey = s->z_dy * (RASTER_TILE - 1);
+    uint32_t low = depth_clamp((int64_t)(z + (ex < 0 ? ex : 0) + (ey < 0 ? ey : 0)) - 1, max);
+    uint32_t high = depth_clamp((int64_t)(z + (ex > 0 ? ex : 0) + (ey > 0 ? ey : 0)) + 1, max);
+
+    uint32_t* tile_min = &ctx->tile_min[tile];
+    uint32_t* tile_max = &ctx->tile_max[tile];
+    if (depth_tile_hidden(ctx->depth_func, low, high, *tile_min, *tile_max)) {
+        ctx->tiles_rejected++;
+        return 0;
+    }
+    if (ctx->tile_cleared[tile]) depth_fill_tile(ctx, tile, x, y);
+    if (!ctx->depth_write) return 1;
+
+    // Треугольник пишет во все пиксели плитки
+    int covered = full && x >= s->clip->x && y >= s->clip->y &&
+                  x + RASTER_TILE <= s->clip->x + s->clip->width &&
+                  y + RASTER_TILE <= s->clip->y + s->clip->height;
+    switch (ctx->depth_func) {
+        case GL_NEVER:
+        case GL_EQUAL:
+            break;
+        case GL_LESS:
+        case GL_LEQUAL:
+            // Новое значение - меньшее из старого и треугольника
+            if (covered && high < *tile_max) *tile_max = high;
+            if (low < *tile_min) *tile_min = low;
+            break;
+        case GL_GREATER:
+        case GL_GEQUAL:
+            if (covered && low > *tile_min) *tile_min = low;
+            if (high > *tile_max) *tile_max = high;
+            break;
+        default:
+            if (covered && ctx->depth_func == GL_ALWAYS) {
+                *tile_min = low;
+                *tile_max = high;
+                break;
+            }
+            if (low < *tile_min) *tile_min = low;
+            if (high > *tile_max) *tile_max = high;
+            break;
+    }
+    return 1;
+}
+
+// Вершины уже в экранных координатах
+static void shade_triangle(opengl_context_t* ctx, const rect_t* clip, int depth, const gl_texture_t* texture,
+                           const gl_clip_vertex_t* a, const gl_clip_vertex_t* b, const gl_clip_vertex_t* c) {
+    float area = (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+    if (area == 0.0f) return;
+    // Ось y экрана направлена вниз: у лицевых (CCW) граней площадь отрицательна
+    if (gl_state.cull_face_enabled && area > 0.0f) return;
+
+    raster_point_t p[3] = {
+        {(int)(a->x * RASTER_ONE), (int)(a->y * RASTER_ONE)},
+        {(int)(b->x * RASTER_ONE), (int)(b->y * RASTER_ONE)},
+        {(int)(c->x * RASTER_ONE), (int)(c->y * RASTER_ONE)},
+    };
+
+    shade_t s;
+    s.ctx = ctx;
+    s.clip = clip;
+    s.origin_x = a->x;
+    s.origin_y = a->y;
+    s.color = pack_color(a);
+    s.flat = s.color == pack_color(b) && s.color == pack_color(c);
+    if (!s.flat) {
+        const float* fa[4] = {&a->r, &a->g, &a->b, &a->a};
+        const float* fb[4] = {&b->r, &b->g, &b->b, &b->a};
+        const float* fc[4] = {&c->r, &c->g, &c->b, &c->a};
+        float scale = 255.0f * 65536.0f;
+        float inv_area = 1.0f / area;
+
+        for (int k = 0; k < 4; k++) {
+            float d1 = (*fb[k] - *fa[k]) * scale;
+            float d2 = (*fc[k] - *fa[k]) * scale;
+            s.base[k] = *fa[k] * scale;
+            s.dx[k] = (d1 * (c->y - a->y) - d2 * (b->y - a->y)) * inv_area;
+            s.dy[k] = (d2 * (b->x - a->x) - d1 * (c->x - a->x)) * inv_area;
+            s.step[k] = (int32_t)s.dx[k];
+        }
+    }
+
+    s.depth = depth;
+    if (depth) {
+        // z после деления на w - в [-1, 1]; в буфере 0 - ближняя плоскость
+        double scale = 0.5 * depth_max(ctx);
+        double za = (a->z + 1.0) * scale;
+        double d1 = (b->z + 1.0) * scale - za;
+        double d2 = (c->z + 1.0) * scale - za;
+        double inv_area = 1.0 / area;
+
+        s.z_base = za;
+        s.z_dx = (d1 * (c->y - a->y) - d2 * (b->y - a->y)) * inv_area;
+        s.z_dy = (d2 * (b->x - a->x) - d1 * (c->x - a->x)) * inv_area;
+        s.z_step = (int64_t)(s.z_dx * 65536.0);
+    }
+
+    if (texture) {
+        // w вершин после деления уже 1 / w
+        float inv_area = 1.0f / area;
+        float qa = a->w, qb = b->w, qc = c->w;
+        float values[3][3] = {
+            {a->u * qa, b->u * qb, c->u * qc},
+            {a->v * qa, b->v * qb, c->v * qc},
+            {qa, qb, qc},
+        };
+        float* out[3][3] = {
+            {&s.uq_base, &s.uq_dx, &s.uq_dy},
+            {&s.vq_base, &s.vq_dx, &s.vq_dy},
+            {&s.q_base, &s.q_dx, &s.q_dy},
+        };
+        for (int k = 0; k < 3; k++) {
+            float d1 = values[k][1] - values[k][0];
+            float d2 = values[k][2] - values[k][0];
+            *out[k][0] = values[k][0];
+            *out[k][1] = (d1 * (c->y - a->y) - d2 * (b->y - a->y)) * inv_area;
+            *out[k][2] = (d2 * (b->x - a->x) - d1 * (c->x - a->x)) * inv_area;
+        }
+        texture_setup(&s, texture, area, a, b, c);
+    }
+
+    ctx->triangles++;
+    ctx->pixels += raster_triangle_tiles(&p[0], &p[1], &p[2], clip, texture ? texture_span : shade_span,
+                                         depth ? shade_tile : 0, &s);
+}
+
+// ==================== ОТСЕЧЕНИЕ ====================
+
+static int clip_outcode(const gl_clip_vertex_t* v) {
+    int code = 0;
+    if (v->x < -v->w) code |= CLIP_LEFT;
+    if (v->x > v->w) code |= CLIP_RIGHT;
+    if (v->y < -v->w) code |= CLIP_BOTTOM;
+    if (v->y > v->w) code |= CLIP_TOP;
+    if (v->z < -v->w) code |= CLIP_NEAR;
+    if (v->z > v->w) code |= CLIP_FAR;
+    return code;
+}
+
+// >= 0 с внутренней стороны плоскости
+static float clip_distance(const gl_clip_vertex_t* v, int plane) {
+    switch (plane) {
+        case CLIP_LEFT: return v->w + v->x;
+        case CLIP_RIGHT: return v->w - v->x;
+        case CLIP_BOTTOM: return v->w + v->y;
+        case CLIP_TOP: return v->w - v->y;
+        case CLIP_NEAR: return v->w + v->z;
+        default: return v->w - v->z;
+    }
+}
+
+static void clip_lerp(gl_clip_vertex_t* out, const gl_clip_vertex_t* a, const gl_clip_vertex_t* b, float t) {
+    out->x = a->x + (b->x - a->x) * t;
+    out->y = a->y + (b->y - a->y) * t;
+    out->z = a->z + (b->z - a->z) * t;
+    out->w = a->w + (b->w - a->w) * t;
+    out->r = a->r + (b->r - a->r) * t;
+    out->g = a->g + (b->g - a->g) * t;
+    out->b = a->b + (b->b - a->b) * t;
+    out->a = a->a + (b->a - a->a) * t;
+    out->u = a->u + (b->u - a->u) * t;
+    out->v = a->v + (b->v - a->v) * t;
+}
+
+// Многоугольник внутри пирамиды: деление на w, viewport и веер треугольников
+static void draw_polygon(opengl_context_t* ctx, gl_clip_vertex_t* v, int count) {
+    float half_width = ctx->viewport_width * 0.5f;
+    float half_height = ctx->viewport_height * 0.5f;
+
+    for (int i = 0; i < count; i++) {
+        if (v[i].w <= 0.0f) return;
+        float inv_w = 1.0f / v[i].w;
+        v[i].x = (v[i].x * inv_w + 1.0f) * half_width + ctx->viewport_x;
+        v[i].y = (1.0f - v[i].y * inv_w) * half_height + ctx->viewport_y;
+        v[i].z = v[i].z * inv_w;
+        v[i].w = inv_w;
+    }
+
+    // Viewport, обрезанный по буферу цвета
+    rect_t clip = {ctx->viewport_x, ctx->viewport_y, ctx->viewport_width, ctx->viewport_height};
+    rect_t buffer = {0, 0, ctx->width, ctx->height};
+    if (!rect_intersect(&clip, &buffer, &clip)) return;
+
+    int depth = depth_ready(ctx);
+    if (depth && ctx->depth_func == GL_NEVER) return;
+    const gl_texture_t* texture = texture_active(ctx);
+    for (int i = 1; i + 1 < count; i++) {
+        shade_triangle(ctx, &clip, depth, texture, &v[0], &v[i], &v[i + 1]);
+    }
+}
+
+static void clip_triangle(opengl_context_t* ctx, const gl_clip_vertex_t* a,
+                          const gl_clip_vertex_t* b, const gl_clip_vertex_t* c) {
+    // Все три вершины снаружи одной плоскости
+    if (a->outcode & b->outcode & c->outcode) return;
+
+    gl_clip_vertex_t buffers[2][CLIP_MAX_VERTICES];
+    gl_clip_vertex_t* in = buffers[0];
+    gl_clip_vertex_t* out = buffers[1];
+    in[0] = *a;
+    in[1] = *b;
+    in[2] = *c;
+    int count = 3;
+
+    // Sutherland-Hodgman только по пересекаемым плоскостям
+    int planes = a->outcode | b->outcode | c->outcode;
+    for (int plane = CLIP_LEFT; plane <= CLIP_FAR; plane <<= 1) {
+        if (!(planes & plane)) continue;
+
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            const gl_clip_vertex_t* current = &in[i];
+            const gl_clip_vertex_t* next = &in[(i + 1) % count];
+            float dc = clip_distance(current, plane);
+            float dn = clip_distance(next, plane);
+
+            if (dc >= 0.0f) out[n++] = *current;
+            if ((dc >= 0.0f) != (dn >= 0.0f)) clip_lerp(&out[n++], current, next, dc / (dc - dn));
+        }
+
+        gl_clip_vertex_t* swap = in;
+        in = out;
+        out = swap;
+        count = n;
+        if (count < 3) return;
+    }
+
+    draw_polygon(ctx, in, count);
+}
+
+// ==================== КОНВЕЙЕР ====================
+
+// Все вершины пакета одной матрицей projection * modelview; координаты
+// текстуры - матрицей текстуры (s, t, 0, 1, без деления на q)
+static void transform_vertices(const float* m, const float* tm, const gl_vertex_t* in,
+                               gl_clip_vertex_t* out, uint32_t count) {
+    // Позиции - ядром SSE, четыре вершины за итерацию
+    matrix_transform_points(m, &in[0].x, sizeof(gl_vertex_t), &out[0].x, sizeof(gl_clip_vertex_t), count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        out[i].r = in[i].r;
+        out[i].g = in[i].g;
+        out[i].b = in[i].b;
+        out[i].a = in[i].a;
+        out[i].u = tm[0] * in[i].u + tm[4] * in[i].v + tm[12];
+        out[i].v = tm[1] * in[i].u + tm[5] * in[i].v + tm[13];
+        out[i].outcode = clip_outcode(&out[i]);
+    }
+}
+
+// Пакет вершин (накопленных, из буфера или из списка): преобразование и
+// сборка примитивов
+static void render_batch(opengl_context_t* ctx, uint32_t mode, const gl_vertex_t* vertices, uint32_t n) {
+    if (!ctx->clip_buffer || !ctx->color_buffer || n > ctx->max_vertices) return;
+
+    float mvp[16];
+    matrix_multiply(mvp, gl_state.projection_matrix, gl_state.modelview_matrix);
+    transform_vertices(mvp, gl_state.texture_matrix, vertices, ctx->clip_buffer, n);
+
+    gl_texture_t* texture = texture_active(ctx);
+    if (texture) texture->last_used = ++texture_clock;
+
+    const gl_clip_vertex_t* v = ctx->clip_buffer;
+    switch (mode) {
+        case GL_TRIANGLES:
+            for (uint32_t i = 0; i + 2 < n; i += 3) clip_triangle(ctx, &v[i], &v[i + 1], &v[i + 2]);
+            break;
+        case GL_TRIANGLE_STRIP:
+            // Каждый второй треугольник перевернут: сохраняем обход
+            for (uint32_t i = 0; i + 2 < n; i++) {
+                if (i & 1) clip_triangle(ctx, &v[i + 1], &v[i], &v[i + 2]);
+                else clip_triangle(ctx, &v[i], &v[i + 1], &v[i + 2]);
+            }
+            break;
+        case GL_TRIANGLE_FAN:
+        case GL_POLYGON:
+            for (uint32_t i = 1; i + 1 < n; i++) clip_triangle(ctx, &v[0], &v[i], &v[i + 1]);
+            break;
+        case GL_QUADS:
+            for (uint32_t i = 0; i + 3 < n; i += 4) {
+                clip_triangle(ctx, &v[i], &v[i + 1], &v[i + 2]);
+                clip_triangle(ctx, &v[i], &v[i + 2], &v[i + 3]);
+            }
+            break;
+        case GL_QUAD_STRIP:
+            // Четырехугольник i, i+1, i+3, i+2
+            for (uint32_t i = 0; i + 3 < n; i += 2) {
+                clip_triangle(ctx, &v[i], &v[i + 1], &v[i + 3]);
+                clip_triangle(ctx, &v[i], &v[i + 3], &v[i + 2]);
+            }
+            break;
+        default:
+            // Точки и линии не растеризуются
+            break;
+    }
+}
+
 void opengl_begin(opengl_context_t* ctx, uint32_t mode) {
     ctx->vertex_count = 0;
-    // Здесь будет установка режима примитивов
+    ctx->primitive_mode = mode;
+    ctx->in_begin = 1;
 }
 
 void opengl_end(opengl_context_t* ctx) {
+    ctx->in_begin = 0;
     // Рисуем накопленные вершины
     if (ctx->vertex_count > 0) {
-        render_vertices(ctx);
+        if (ctx->list_compiling) list_record_draw(ctx, ctx->primitive_mode, ctx->vertex_buffer, ctx->vertex_count);
+        if (list_executes(ctx)) render_batch(ctx, ctx->primitive_mode, ctx->vertex_buffer, ctx->vertex_count);
     }
     ctx->vertex_count = 0;
 }
 
 void opengl_vertex2f(opengl_context_t* ctx, float x, float y) {
-    if (ctx->vertex_count >= ctx->max_vertices) return;
-    
-    float* vertex = &ctx->vertex_buffer[ctx->vertex_count * 8];
-    vertex[0] = x;     // x
-    vertex[1] = y;     // y
-    vertex[2] = 0.0f;  // z
-    vertex[3] = 1.0f;  // r
-    vertex[4] = 1.0f;  // g
-    vertex[5] = 1.0f;  // b
-    vertex[6] = 1.0f;  // a
-    vertex[7] = 0.0f;  // u
-    vertex[8] = 0.0f;  // v
-    
-    ctx->vertex_count++;
+    opengl_vertex3f(ctx, x, y, 0.0f);
 }
 
 void opengl_vertex3f(opengl_context_t* ctx, float x, float y, float z) {
-    if (ctx->vertex_count >= ctx->max_vertices) return;
-    
-    float* vertex = &ctx->vertex_buffer[ctx->vertex_count * 8];
-    vertex[0] = x;     // x
-    vertex[1] = y;     // y
-    vertex[2] = z;     // z
-    vertex[3] = 1.0f;  // r
-    vertex[4] = 1.0f;  // g
-    vertex[5] = 1.0f;  // b
-    vertex[6] = 1.0f;  // a
-    vertex[7] = 0.0f;  // u
-    vertex[8] = 0.0f;  // v
-    
-    ctx->vertex_count++;
+    if (!ctx->vertex_buffer || ctx->vertex_count >= ctx->max_vertices) return;
+
+    gl_vertex_t* vertex = &ctx->vertex_buffer[ctx->vertex_count++];
+    vertex->x = x;
+    vertex->y = y;
+    vertex->z = z;
+    vertex->r = ctx->current_color[0];
+    vertex->g = ctx->current_color[1];
+    vertex->b = ctx->current_color[2];
+    vertex->a = ctx->current_color[3];
+    vertex->u = ctx->current_texcoord[0];
+    vertex->v = ctx->current_texcoord[1];
 }
 
 void opengl_color3f(opengl_context_t* ctx, float r, float g, float b) {
@@ -216,21 +1358,38 @@ void opengl_color3f(opengl_context_t* ctx, float r, float g, float b) {
 }
 
 void opengl_color4f(opengl_context_t* ctx, float r, float g, float b, float a) {
-    // Устанавливаем цвет для последующих вершин
-    // Здесь будет реализация текущего цвета
+    // Между begin и end цвет попадает в список с вершинами
+    if (ctx->list_compiling && !ctx->in_begin) {
+        float color[4] = {r, g, b, a};
+        list_record(LIST_COLOR, color, 4);
+    }
+    // Цвет для последующих вершин
+    ctx->current_color[0] = r;
+    ctx->current_color[1] = g;
+    ctx->current_color[2] = b;
+    ctx->current_color[3] = a;
+}
+
+void opengl_texcoord2f(opengl_context_t* ctx, float u, float v) {
+    if (ctx->list_compiling && !ctx->in_begin) {
+        float texcoord[2] = {u, v};
+        list_record(LIST_TEXCOORD, texcoord, 2);
+    }
+    ctx->current_texcoord[0] = u;
+    ctx->current_texcoord[1] = v;
 }
 
 // Matrix operations
 void opengl_matrix_mode(opengl_context_t* ctx, uint32_t mode) {
+    if (ctx->list_compiling) list_record(LIST_MATRIX_MODE, &mode, 1);
+    if (!list_executes(ctx)) return;
+
     gl_state.matrix_mode = mode;
     switch (mode) {
-        case 0x1700: // GL_MODELVIEW
-            gl_state.current_matrix = gl_state.modelview_matrix;
-            break;
-        case 0x1701: // GL_PROJECTION
+        case GL_PROJECTION:
             gl_state.current_matrix = gl_state.projection_matrix;
             break;
-        case 0x1702: // GL_TEXTURE
+        case GL_TEXTURE:
             gl_state.current_matrix = gl_state.texture_matrix;
             break;
         default:
@@ -240,46 +1399,294 @@ void opengl_matrix_mode(opengl_context_t* ctx, uint32_t mode) {
 }
 
 void opengl_load_identity(opengl_context_t* ctx) {
-    matrix_identity(gl_state.current_matrix);
+    float m[16];
+    matrix_identity(m);
+    if (ctx->list_compiling) list_record_matrix(LIST_LOAD_MATRIX, m);
+    if (list_executes(ctx)) matrix_identity(gl_state.current_matrix);
+}
+
+void opengl_push_matrix(opengl_context_t* ctx) {
+    if (ctx->list_compiling) list_record(LIST_PUSH_MATRIX, NULL, 0);
+    if (!list_executes(ctx)) return;
+
+    int stack = matrix_stack_index();
+    if (matrix_stack_depth[stack] >= MATRIX_STACK_DEPTH) {
+        printf("GL: matrix stack overflow\n");
+        return;
+    }
+    memcpy(matrix_stacks[stack][matrix_stack_depth[stack]++], gl_state.current_matrix, 16 * 4);
+}
+
+void opengl_pop_matrix(opengl_context_t* ctx) {
+    if (ctx->list_compiling) list_record(LIST_POP_MATRIX, NULL, 0);
+    if (!list_executes(ctx)) return;
+
+    int stack = matrix_stack_index();
+    if (matrix_stack_depth[stack] == 0) {
+        printf("GL: matrix stack underflow\n");
+        return;
+    }
+    memcpy(gl_state.current_matrix, matrix_stacks[stack][--matrix_stack_depth[stack]], 16 * 4);
 }
 
 void opengl_translatef(opengl_context_t* ctx, float x, float y, float z) {
-    matrix_translate(gl_state.current_matrix, x, y, z);
+    float m[16];
+    matrix_translation(m, x, y, z);
+    matrix_op(ctx, m);
 }
 
 void opengl_scalef(opengl_context_t* ctx, float x, float y, float z) {
-    matrix_scale(gl_state.current_matrix, x, y, z);
+    float m[16];
+    matrix_scaling(m, x, y, z);
+    matrix_op(ctx, m);
 }
 
 void opengl_rotatef(opengl_context_t* ctx, float angle, float x, float y, float z) {
-    matrix_rotate(gl_state.current_matrix, angle, x, y, z);
+    float m[16];
+    matrix_rotation(m, angle, x, y, z);
+    matrix_op(ctx, m);
 }
 
-// Texture management
-uint32_t opengl_gen_texture(opengl_context_t* ctx) {
-    static uint32_t texture_id_counter = 1;
-    return texture_id_counter++;
+void opengl_ortho(opengl_context_t* ctx, float left, float right, float bottom, float top, float near, float far) {
+    float m[16];
+    matrix_identity(m);
+    m[0] = 2.0f / (right - left);
+    m[5] = 2.0f / (top - bottom);
+    m[10] = -2.0f / (far - near);
+    m[12] = -(right + left) / (right - left);
+    m[13] = -(top + bottom) / (top - bottom);
+    m[14] = -(far + near) / (far - near);
+    matrix_op(ctx, m);
 }
 
-void opengl_bind_texture(opengl_context_t* ctx, uint32_t texture) {
-    ctx->current_texture = texture;
+void opengl_frustum(opengl_context_t* ctx, float left, float right, float bottom, float top, float near, float far) {
+    float m[16];
+    memset(m, 0, sizeof(m));
+    m[0] = 2.0f * near / (right - left);
+    m[5] = 2.0f * near / (top - bottom);
+    m[8] = (right + left) / (right - left);
+    m[9] = (top + bottom) / (top - bottom);
+    m[10] = -(far + near) / (far - near);
+    m[11] = -1.0f;
+    m[14] = -2.0f * far * near / (far - near);
+    matrix_op(ctx, m);
 }
 
-void opengl_tex_image2d(opengl_context_t* ctx, int width, int height, const void* data) {
-    // Здесь будет загрузка текстуры в GPU
-    if (ctx->gpu && ctx->gpu->mmio_base) {
-        // Отправляем текстуру в GPU
+// ==================== БУФЕРЫ ВЕРШИН ====================
+
+#define MAX_BUFFERS 64
+
+typedef struct {
+    int allocated;
+    gl_vertex_t* vertices;
+    uint32_t count;
+    uint32_t pages;
+} gl_buffer_t;
+
+static gl_buffer_t buffers[MAX_BUFFERS];
+
+static gl_buffer_t* buffer_get(uint32_t id) {
+    if (id == 0 || id > MAX_BUFFERS || !buffers[id - 1].allocated) return NULL;
+    return &buffers[id - 1];
+}
+
+static void buffer_release(gl_buffer_t* buffer) {
+    if (!buffer->vertices) return;
+    page_free(buffer->vertices, buffer->pages);
+    buffer->vertices = NULL;
+    buffer->count = 0;
+}
+
+uint32_t opengl_gen_buffer(opengl_context_t* ctx) {
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (buffers[i].allocated) continue;
+        memset(&buffers[i], 0, sizeof(buffers[i]));
+        buffers[i].allocated = 1;
+        return i + 1;
     }
+    return 0;
 }
 
-void opengl_tex_parameteri(opengl_context_t* ctx, uint32_t param, int value) {
-    // Устанавливаем параметры текстуры
+void opengl_delete_buffer(opengl_context_t* ctx, uint32_t buffer) {
+    gl_buffer_t* b = buffer_get(buffer);
+    if (!b) return;
+
+    buffer_release(b);
+    b->allocated = 0;
+    if (ctx && ctx->current_buffer == buffer) ctx->current_buffer = 0;
+}
+
+void opengl_bind_buffer(opengl_context_t* ctx, uint32_t buffer) {
+    ctx->current_buffer = buffer;
+}
+
+int opengl_buffer_data(opengl_context_t* ctx, const gl_vertex_t* vertices, uint32_t count) {
+    gl_buffer_t* b = buffer_get(ctx->current_buffer);
+    if (!b) return 0;
+    // Пакет целиком проходит через буфер преобразованных вершин
+    if (count > MAX_VERTICES) {
+        printf("GL: buffer of %u vertices, at most %d\n", count, MAX_VERTICES);
+        return 0;
+    }
+
+    buffer_release(b);
+    if (!count) return 1;
+
+    uint32_t pages = pages_for_bytes(count * sizeof(gl_vertex_t));
+    b->vertices = page_alloc(pages);
+    if (!b->vertices) return 0;
+    b->pages = pages;
+    b->count = count;
+    memcpy(b->vertices, vertices, count * sizeof(gl_vertex_t));
+    return 1;
+}
+
+void opengl_draw_arrays(opengl_context_t* ctx, uint32_t mode, uint32_t first, uint32_t count) {
+    gl_buffer_t* b = buffer_get(ctx->current_buffer);
+    if (!b || first > b->count || count > b->count - first || !count) return;
+
+    // Как в OpenGL, список хранит сами вершины, а не ссылку на буфер
+    if (ctx->list_compiling) list_record_draw(ctx, mode, &b->vertices[first], count);
+    if (list_executes(ctx)) render_batch(ctx, mode, &b->vertices[first], count);
+}
+
+// ==================== СПИСКИ ====================
+
+static gl_list_t* list_get(uint32_t id) {
+    if (id == 0 || id > MAX_LISTS || !lists[id - 1].allocated) return NULL;
+    return &lists[id - 1];
+}
+
+static void list_release(gl_list_t* list) {
+    if (list->commands) page_free(list->commands, list->pages);
+    list->commands = NULL;
+    list->pages = 0;
+    list->size = 0;
+}
+
+uint32_t opengl_gen_lists(opengl_context_t* ctx, uint32_t range) {
+    if (range == 0 || range > MAX_LISTS) return 0;
+
+    for (uint32_t first = 0; first + range <= MAX_LISTS; first++) {
+        uint32_t n = 0;
+        while (n < range && !lists[first + n].allocated) n++;
+        if (n < range) {
+            first += n;
+            continue;
+        }
+        for (n = 0; n < range; n++) {
+            memset(&lists[first + n], 0, sizeof(gl_list_t));
+            lists[first + n].allocated = 1;
+        }
+        return first + 1;
+    }
+    return 0;
+}
+
+void opengl_delete_lists(opengl_context_t* ctx, uint32_t list, uint32_t range) {
+    for (uint32_t i = 0; i < range; i++) {
+        gl_list_t* l = list_get(list + i);
+        if (!l) continue;
+        list_release(l);
+        l->allocated = 0;
+    }
+}
+
+void opengl_new_list(opengl_context_t* ctx, uint32_t list, uint32_t mode) {
+    // Компилируется один список за раз
+    if (!list_get(list) || list_building.allocated || ctx->in_begin) return;
+    if (mode != GL_COMPILE && mode != GL_COMPILE_AND_EXECUTE) return;
+
+    memset(&list_building, 0, sizeof(list_building));
+    list_building.allocated = 1;
+    ctx->list_compiling = list;
+    ctx->list_mode = mode;
+    memcpy(ctx->list_saved_color, ctx->current_color, sizeof(ctx->current_color));
+    memcpy(ctx->list_saved_texcoord, ctx->current_texcoord, sizeof(ctx->current_texcoord));
+}
+
+void opengl_end_list(opengl_context_t* ctx) {
+    gl_list_t* list = list_get(ctx->list_compiling);
+    if (!ctx->list_compiling) return;
+
+    // Вершины копили текущий цвет; без выполнения он не должен был меняться
+    if (ctx->list_mode == GL_COMPILE) {
+        memcpy(ctx->current_color, ctx->list_saved_color, sizeof(ctx->current_color));
+        memcpy(ctx->current_texcoord, ctx->list_saved_texcoord, sizeof(ctx->current_texcoord));
+    }
+
+    if (list) {
+        list_release(list);
+        list->commands = list_building.commands;
+        list->pages = list_building.pages;
+        list->size = list_building.size;
+    } else {
+        // Список удалили во время компиляции
+        list_release(&list_building);
+    }
+    memset(&list_building, 0, sizeof(list_building));
+    ctx->list_compiling = 0;
+}
+
+static void list_run(opengl_context_t* ctx, uint32_t id, int nesting) {
+    gl_list_t* list = list_get(id);
+    if (!list || nesting >= LIST_MAX_NESTING) return;
+
+    uint32_t* command = list->commands;
+    uint32_t* end = command + list->size;
+    while (command < end) {
+        uint32_t* args = command + 1;
+        float* f = (float*)args;
+
+        switch (command[0] & 0xFF) {
+            case LIST_DRAW:
+                render_batch(ctx, args[0], (const gl_vertex_t*)(args + LIST_DRAW_HEADER - 1), args[1]);
+                memcpy(ctx->current_color, f + 2, 4 * 4);
+                memcpy(ctx->current_texcoord, f + 6, 2 * 4);
+                break;
+            case LIST_LOAD_MATRIX:
+                memcpy(gl_state.current_matrix, f, 16 * 4);
+                break;
+            case LIST_MULT_MATRIX:
+                matrix_apply(gl_state.current_matrix, f);
+                break;
+            case LIST_MATRIX_MODE: opengl_matrix_mode(ctx, args[0]); break;
+            case LIST_COLOR: opengl_color4f(ctx, f[0], f[1], f[2], f[3]); break;
+            case LIST_TEXCOORD: opengl_texcoord2f(ctx, f[0], f[1]); break;
+            case LIST_ENABLE: opengl_enable(ctx, args[0]); break;
+            case LIST_DISABLE: opengl_disable(ctx, args[0]); break;
+            case LIST_BIND_TEXTURE: opengl_bind_texture(ctx, args[0]); break;
+            case LIST_DEPTH_FUNC: opengl_depth_func(ctx, args[0]); break;
+            case LIST_CLEAR: opengl_clear(ctx, args[0]); break;
+            case LIST_CALL: list_run(ctx, args[0], nesting + 1); break;
+            case LIST_PUSH_MATRIX: opengl_push_matrix(ctx); break;
+            case LIST_POP_MATRIX: opengl_pop_matrix(ctx); break;
+            case LIST_DEPTH_MASK: opengl_depth_mask(ctx, args[0]); break;
+            case LIST_CLEAR_COLOR: opengl_clear_color(ctx, f[0], f[1], f[2], f[3]); break;
+            case LIST_CLEAR_DEPTH: opengl_clear_depth(ctx, f[0]); break;
+            case LIST_TEX_PARAMETER: opengl_tex_parameteri(ctx, args[0], args[1]); break;
+            case LIST_TEX_IMAGE: opengl_tex_image2d(ctx, args[0], args[1], args + 2); break;
+            case LIST_VIEWPORT: opengl_viewport(ctx, args[0], args[1], args[2], args[3]); break;
+        }
+        command += command[0] >> 8;
+    }
+}
+
+void opengl_call_list(opengl_context_t* ctx, uint32_t list) {
+    if (ctx->list_compiling) list_record(LIST_CALL, &list, 1);
+    if (!list_executes(ctx)) return;
+
+    // Команды списка выполняются, а не записываются повторно
+    uint32_t compiling = ctx->list_compiling;
+    ctx->list_compiling = 0;
+    list_run(ctx, list, 0);
+    ctx->list_compiling = compiling;
 }
 
 // Shader support
 int opengl_supports_shaders(gpu_context_t* gpu) {
     // Проверяем поддержку шейдеров в GPU
-    return (gpu->vendor_id == GPU_VENDOR_NVIDIA || 
+    return (gpu->vendor_id == GPU_VENDOR_NVIDIA ||
             gpu->vendor_id == GPU_VENDOR_AMD ||
             gpu->vendor_id == GPU_VENDOR_INTEL) && gpu->accelerated;
 }
@@ -288,7 +1695,7 @@ uint32_t opengl_create_shader(opengl_context_t* ctx, const char* source, int typ
     if (!opengl_supports_shaders(ctx->gpu)) {
         return 0;
     }
-    
+
     // Здесь будет компиляция шейдера
     static uint32_t shader_id_counter = 1000;
     return shader_id_counter++;
@@ -298,62 +1705,263 @@ uint32_t opengl_create_program(opengl_context_t* ctx, uint32_t vertex_shader, ui
     if (!opengl_supports_shaders(ctx->gpu)) {
         return 0;
     }
-    
+
     // Здесь будет линковка программы
     static uint32_t program_id_counter = 2000;
     return program_id_counter++;
 }
 
-// Внутренняя функция рендеринга
-static void render_vertices(opengl_context_t* ctx) {
-    if (!ctx->vertex_buffer || ctx->vertex_count == 0) return;
-    
-    // Применяем трансформации
-    for (uint32_t i = 0; i < ctx->vertex_count; i++) {
-        float* vertex = &ctx->vertex_buffer[i * 8];
-        float x = vertex[0];
-        float y = vertex[1];
-        float z = vertex[2];
-        
-        // Применяем матрицу моделирования-вида-проекции
-        float transformed[4] = {x, y, z, 1.0f};
-        float result[4] = {0, 0, 0, 0};
-        
-        // Умножаем на модел-вида
-        for (int j = 0; j < 4; j++) {
-            for (int k = 0; k < 4; k++) {
-                result[j] += gl_state.modelview_matrix[j * 4 + k] * transformed[k];
-            }
-        }
-        
-        // Умножаем на проекцию
-        float final[4] = {0, 0, 0, 0};
-        for (int j = 0; j < 4; j++) {
-            for (int k = 0; k < 4; k++) {
-                final[j] += gl_state.projection_matrix[j * 4 + k] * result[k];
-            }
+// ==================== ДЕМО ====================
+
+#define DEMO_FRAMES 240
+
+// Вершина куба i: биты 0, 1, 2 - знаки x, y, z; они же - ее цвет
+static const uint8_t demo_faces[6][4] = {
+    {4, 5, 7, 6}, {1, 0, 2, 3},     // +z, -z
+    {5, 1, 3, 7}, {0, 4, 6, 2},     // +x, -x
+    {6, 7, 3, 2}, {0, 1, 5, 4},     // +y, -y
+};
+
+// Углы грани в координатах текстуры: текстура повторяется дважды
+static const float demo_texcoords[4][2] = {{0.0f, 2.0f}, {2.0f, 2.0f}, {2.0f, 0.0f}, {0.0f, 0.0f}};
+
+#define DEMO_TEXTURE_SIZE 64
+static uint32_t demo_texels[DEMO_TEXTURE_SIZE * DEMO_TEXTURE_SIZE];
+
+// Шахматная доска с рамкой, с мипмапами
+static uint32_t demo_texture(opengl_context_t* ctx) {
+    static uint32_t texture = 0;
+    if (texture && opengl_texture_resident(texture)) return texture;
+
+    for (int y = 0; y < DEMO_TEXTURE_SIZE; y++) {
+        for (int x = 0; x < DEMO_TEXTURE_SIZE; x++) {
+            int border = x < 2 || y < 2 || x >= DEMO_TEXTURE_SIZE - 2 || y >= DEMO_TEXTURE_SIZE - 2;
+            int check = ((x >> 3) ^ (y >> 3)) & 1;
+            demo_texels[y * DEMO_TEXTURE_SIZE + x] = border ? 0xFF202020 : (check ? 0xFFFFFFFF : 0xFF8080C0);
         }
-        
-        // Perspective divide
-        if (final[3] != 0.0f) {
-            final[0] /= final[3];
-            final[1] /= final[3];
-            final[2] /= final[3];
+    }
+    if (!texture) texture = opengl_gen_texture(ctx);
+    opengl_bind_texture(ctx, texture);
+    opengl_tex_parameteri(ctx, GL_GENERATE_MIPMAP, GL_TRUE);
+    opengl_tex_parameteri(ctx, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    opengl_tex_parameteri(ctx, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    opengl_tex_image2d(ctx, DEMO_TEXTURE_SIZE, DEMO_TEXTURE_SIZE, demo_texels);
+    return texture;
+}
+
+static void demo_cube(opengl_context_t* ctx) {
+    opengl_begin(ctx, GL_QUADS);
+    for (int f = 0; f < 6; f++) {
+        for (int i = 0; i < 4; i++) {
+            int corner = demo_faces[f][i];
+            opengl_texcoord2f(ctx, demo_texcoords[i][0], demo_texcoords[i][1]);
+            float x = (corner & 1) ? 1.0f : -1.0f;
+            float y = (corner & 2) ? 1.0f : -1.0f;
+            float z = (corner & 4) ? 1.0f : -1.0f;
+            opengl_color3f(ctx, (corner & 1) ? 1.0f : 0.2f, (corner & 2) ? 1.0f : 0.2f, (corner & 4) ? 1.0f : 0.2f);
+            opengl_vertex3f(ctx, x, y, z);
         }
-        
-        // Конвертируем в экранные координаты
-        int screen_x = (int)((final[0] + 1.0f) * ctx->viewport_width / 2.0f) + ctx->viewport_x;
-        int screen_y = (int)((1.0f - final[1]) * ctx->viewport_height / 2.0f) + ctx->viewport_y;
-        
-        // Рисуем пиксель (упрощенно)
-        if (screen_x >= 0 && screen_x < ctx->gpu->width && 
-            screen_y >= 0 && screen_y < ctx->gpu->height) {
-            uint32_t color = ((uint8_t)(vertex[6] * 255) << 24) |
-                           ((uint8_t)(vertex[3] * 255) << 16) |
-                           ((uint8_t)(vertex[4] * 255) << 8) |
-                           ((uint8_t)(vertex[5] * 255));
-            
-            gpu_draw_rect_hw(screen_x, screen_y, 2, 2, color);
+    }
+    opengl_end(ctx);
+}
+
+// Контекст демо и бенчмарка создается один раз
+static opengl_context_t* demo_context(void) {
+    static opengl_context_t* ctx = NULL;
+
+    if (!framebuffer) {
+        printf("GL: no framebuffer\n");
+        return NULL;
+    }
+    if (!ctx) ctx = opengl_create_context(gpu_get_context());
+    if (!ctx) printf("GL: out of memory for the context\n");
+    return ctx;
+}
+
+// Куб стены компилируется в список один раз
+static uint32_t demo_cube_list(opengl_context_t* ctx) {
+    static uint32_t list = 0;
+    if (list) return list;
+
+    list = opengl_gen_lists(ctx, 1);
+    if (!list) return 0;
+    opengl_new_list(ctx, list, GL_COMPILE);
+    demo_cube(ctx);
+    opengl_end_list(ctx);
+    return list;
+}
+
+void opengl_demo(void) {
+    opengl_context_t* ctx = demo_context();
+    if (!ctx) return;
+    // Вывод консоли дорисовывается до демо: иначе его прокрутка сдвинет кадр
+    frame_flush();
+
+    opengl_context_t* previous = gl_state.current_ctx;
+    opengl_make_current(ctx);
+    opengl_viewport(ctx, 0, 0, ctx->width, ctx->height);
+    opengl_clear_color(ctx, 0.05f, 0.05f, 0.15f, 1.0f);
+    opengl_enable(ctx, GL_CULL_FACE);
+    opengl_enable(ctx, GL_DEPTH_TEST);
+
+    float aspect = (float)ctx->width / ctx->height;
+    opengl_matrix_mode(ctx, GL_PROJECTION);
+    opengl_load_identity(ctx);
+    opengl_frustum(ctx, -0.5f * aspect, 0.5f * aspect, -0.5f, 0.5f, 1.0f, 20.0f);
+    opengl_matrix_mode(ctx, GL_MODELVIEW);
+    uint32_t texture = demo_texture(ctx);
+    uint32_t cube_list = demo_cube_list(ctx);
+
+    uint32_t triangles = ctx->triangles;
+    uint32_t pixels = ctx->pixels;
+    uint32_t tiles = ctx->tiles_rejected;
+    uint64_t start = cpu_read_tsc();
+
+    for (int frame = 0; frame < DEMO_FRAMES; frame++) {
+        float t = frame * 0.03f;
+
+        opengl_clear(ctx, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        opengl_load_identity(ctx);
+        // Куб подлетает к камере и пересекает ближнюю плоскость
+        opengl_translatef(ctx, 0.0f, 0.0f, -4.5f + 3.0f * sinf(t));
+        opengl_rotatef(ctx, frame * 2.0f, 0.0f, 1.0f, 0.0f);
+        opengl_rotatef(ctx, frame * 1.3f, 1.0f, 0.0f, 0.0f);
+        demo_cube(ctx);
+
+        // Стена текстурированных кубов позади него: закрытые плитки
+        // отбрасываются целиком
+        opengl_bind_texture(ctx, texture);
+        opengl_enable(ctx, GL_TEXTURE_2D);
+        opengl_load_identity(ctx);
+        opengl_translatef(ctx, 0.0f, 0.0f, -9.0f);
+        for (int i = 0; i < 9; i++) {
+            opengl_push_matrix(ctx);
+            opengl_translatef(ctx, (i % 3 - 1) * 2.5f, (i / 3 - 1) * 2.5f, 0.0f);
+            opengl_rotatef(ctx, frame * 1.0f + i * 40.0f, 1.0f, 1.0f, 0.0f);
+            if (cube_list) opengl_call_list(ctx, cube_list);
+            else demo_cube(ctx);
+            opengl_pop_matrix(ctx);
         }
+        opengl_disable(ctx, GL_TEXTURE_2D);
+
+        opengl_present(ctx, 0, 0);
+        gpu_swap_buffers();
     }
-}
\ No newline at end of file
+
+    uint32_t us = cpu_tsc_khz() ? cpu_cycles_to_us(cpu_read_tsc() - start) : 0;
+    triangles = ctx->triangles - triangles;
+    pixels = ctx->pixels - pixels;
+    tiles = ctx->tiles_rejected - tiles;
+    opengl_disable(ctx, GL_CULL_FACE);
+    opengl_disable(ctx, GL_DEPTH_TEST);
+    opengl_make_current(previous ? previous : ctx);
+
+    // Демо рисовало поверх экрана
+    desktop_repaint_now();
+
+    printf("GL: %d frames, %u triangles, %u Kpixels, %u tiles hidden by depth bounds\n",
+           DEMO_FRAMES, triangles, pixels / 1000, tiles);
+    if (us) {
+        printf("GL: %u fps (%u us per frame, present included)\n",
+               (uint32_t)DEMO_FRAMES * 1000000 / us, us / DEMO_FRAMES);
+    }
+}
+
+// ==================== БЕНЧМАРК ====================
+
+#define BENCH_VERTICES 3072
+#define BENCH_ROUNDS   16
+
+static gl_vertex_t bench_vertices[BENCH_VERTICES];
+
+// Треугольники вне объема видимости (z < -w при единичных матрицах):
+// отбрасываются по кодам отсечения, так что измеряется только передняя
+// часть конвейера - вызовы, копирование и преобразование вершин
+static void bench_geometry(void) {
+    for (int i = 0; i < BENCH_VERTICES; i++) {
+        gl_vertex_t* v = &bench_vertices[i];
+        memset(v, 0, sizeof(*v));
+        v->x = (float)(i % 7) * 0.25f - 0.75f;
+        v->y = (float)(i % 5) * 0.25f - 0.5f;
+        v->z = -2.0f - (float)(i & 3);
+        v->r = v->g = v->b = v->a = 1.0f;
+    }
+}
+
+static void bench_immediate(opengl_context_t* ctx) {
+    opengl_begin(ctx, GL_TRIANGLES);
+    for (int i = 0; i < BENCH_VERTICES; i++) {
+        const gl_vertex_t* v = &bench_vertices[i];
+        opengl_color3f(ctx, v->r, v->g, v->b);
+        opengl_vertex3f(ctx, v->x, v->y, v->z);
+    }
+    opengl_end(ctx);
+}
+
+// Тысячи вершин в секунду
+static uint32_t bench_rate(uint64_t start) {
+    uint32_t us = cpu_cycles_to_us(cpu_read_tsc() - start);
+    if (us == 0) us = 1;
+    return (uint32_t)BENCH_VERTICES * BENCH_ROUNDS * 1000 / us;
+}
+
+void opengl_benchmark(void) {
+    if (!cpu_tsc_khz()) {
+        printf("GL: TSC rate unknown\n");
+        return;
+    }
+    opengl_context_t* ctx = demo_context();
+    if (!ctx) return;
+
+    opengl_context_t* previous = gl_state.current_ctx;
+    opengl_make_current(ctx);
+    opengl_matrix_mode(ctx, GL_PROJECTION);
+    opengl_load_identity(ctx);
+    opengl_matrix_mode(ctx, GL_MODELVIEW);
+    opengl_load_identity(ctx);
+    bench_geometry();
+
+    uint32_t buffer = opengl_gen_buffer(ctx);
+    opengl_bind_buffer(ctx, buffer);
+    int buffered = opengl_buffer_data(ctx, bench_vertices, BENCH_VERTICES);
+
+    uint32_t list = opengl_gen_lists(ctx, 1);
+    if (list) {
+        opengl_new_list(ctx, list, GL_COMPILE);
+        bench_immediate(ctx);
+        opengl_end_list(ctx);
+    }
+
+    uint32_t triangles = ctx->triangles;
+    uint64_t start = cpu_read_tsc();
+    for (int i = 0; i < BENCH_ROUNDS; i++) bench_immediate(ctx);
+    uint32_t immediate = bench_rate(start);
+
+    uint32_t arrays = 0;
+    if (buffered) {
+        start = cpu_read_tsc();
+        for (int i = 0; i < BENCH_ROUNDS; i++) opengl_draw_arrays(ctx, GL_TRIANGLES, 0, BENCH_VERTICES);
+        arrays = bench_rate(start);
+    }
+
+    uint32_t listed = 0;
+    if (list) {
+        start = cpu_read_tsc();
+        for (int i = 0; i < BENCH_ROUNDS; i++) opengl_call_list(ctx, list);
+        listed = bench_rate(start);
+    }
+
+    opengl_delete_lists(ctx, list, 1);
+    opengl_delete_buffer(ctx, buffer);
+    opengl_make_current(previous ? previous : ctx);
+
+    printf("GL: %d vertices x %d, all outside the view volume (%u triangles drawn)\n",
+           BENCH_VERTICES, BENCH_ROUNDS, ctx->triangles - triangles);
+    printf("GL: immediate %6u Kvertices/s\n", immediate);
+    printf("GL: draw_arrays %4u Kvertices/s\n", arrays);
+    printf("GL: call_list %6u Kvertices/s\n", listed);
+
+    // Ядра преобразования сами по себе: скалярное против SSE
+    printf("GL: matrix kernels in use: %s\n", matrix_kernel());
+    matrix_benchmark();
+}
@@ -1,6 +1,7 @@
 #ifndef OPENGL_H
 #define OPENGL_H
 
+#include <stdint.h>
 #include "gpu.h"
 
 // OpenGL constants
@@ -34,6 +35,16 @@
 #define GL_BLEND                          0x0BE2
 #define GL_CULL_FACE                      0x0B44
 
+// Depth functions
+#define GL_NEVER                          0x0200
+#define GL_LESS                           0x0201
+#define GL_EQUAL                          0x0202
+#define GL_LEQUAL                         0x0203
+#define GL_GREATER                        0x0204
+#define GL_NOTEQUAL                       0x0205
+#define GL_GEQUAL                         0x0206
+#define GL_ALWAYS                         0x0207
+
 // Texture targets
 #define GL_TEXTURE_2D                     0x0DE1
 #define GL_TEXTURE_1D                     0x0DE0
@@ -44,73 +55,203 @@
 #define GL_TEXTURE_WRAP_S                 0x2802
 #define GL_TEXTURE_WRAP_T                 0x2803
 
+#define GL_GENERATE_MIPMAP                0x8191
+
 #define GL_NEAREST                        0x2600
 #define GL_LINEAR                         0x2601
+#define GL_NEAREST_MIPMAP_NEAREST         0x2700
+#define GL_LINEAR_MIPMAP_NEAREST          0x2701
+#define GL_NEAREST_MIPMAP_LINEAR          0x2702
+#define GL_LINEAR_MIPMAP_LINEAR           0x2703
 #define GL_REPEAT                         0x2901
 #define GL_CLAMP                          0x2900
 
+// Display lists
+#define GL_COMPILE                        0x1300
+#define GL_COMPILE_AND_EXECUTE            0x1301
+
+// Buffer objects
+#define GL_ARRAY_BUFFER                   0x8892
+#define GL_STATIC_DRAW                    0x88E4
+
 // Shader types
 #define GL_VERTEX_SHADER                  0x8B31
 #define GL_FRAGMENT_SHADER                0x8B30
 
+// Front face winding
+#define GL_CW                             0x0900
+#define GL_CCW                            0x0901
+
+// One immediate-mode vertex with its color and texture coordinates
+typedef struct {
+    float x, y, z;
+    float r, g, b, a;
+    float u, v;
+} gl_vertex_t;
+
+// A vertex after the transform: clip-space position (x, y, z, w), and
+// after the perspective divide screen x, y, depth z and w = 1 / w
+typedef struct {
+    float x, y, z, w;
+    float r, g, b, a;
+    float u, v;
+    int outcode;        // Frustum planes the vertex is outside of
+} gl_clip_vertex_t;
+
 // OpenGL context structure
 typedef struct opengl_context {
     gpu_context_t* gpu;
     uint32_t current_texture;
     
-    // Viewport
+    // Viewport (top-left origin, inside the color buffer)
     int viewport_x, viewport_y;
     int viewport_width, viewport_height;
     
     // Clear color
     uint32_t clear_color;
     
-    // Vertex buffer
-    float* vertex_buffer;
+    // Vertices between opengl_begin and opengl_end
+    gl_vertex_t* vertex_buffer;
+    gl_clip_vertex_t* clip_buffer;   // The same vertices transformed by opengl_end
     uint32_t vertex_count;
     uint32_t max_vertices;
+    uint32_t vertex_pages;           // Both buffers
     
     // Current state
     uint32_t primitive_mode;
+    int in_begin;           // Between opengl_begin and opengl_end
     float current_color[4];
     float current_texcoord[2];
+    
+    // Off-screen color buffer primitives are rasterized into
+    uint32_t* color_buffer;
+    int width, height;      // Stride is width
+    uint32_t color_pages;
+    
+    // Depth buffer of 16- or 32-bit values (0 near .. all ones far), allocated
+    // on the first draw with GL_DEPTH_TEST enabled
+    void* depth_buffer;
+    int depth_bits;
+    uint32_t depth_pages;
+    uint32_t depth_func;
+    int depth_write;
+    uint32_t clear_depth;   // In buffer units
+    
+    // Per 8x8 tile: bounds of the depths stored in it, and a clear not yet
+    // written to the buffer (the bounds are then both clear_depth)
+    int depth_tiles_x, depth_tiles_y;
+    uint32_t* tile_min;
+    uint32_t* tile_max;
+    uint8_t* tile_cleared;
+    
+    // Bound vertex buffer object
+    uint32_t current_buffer;
+    
+    // Display list being compiled (0 - none) and GL_COMPILE / GL_COMPILE_AND_EXECUTE
+    uint32_t list_compiling;
+    uint32_t list_mode;
+    float list_saved_color[4];      // Restored after a GL_COMPILE list
+    float list_saved_texcoord[2];
+    
+    // Since the context was created
+    uint32_t triangles;     // Rasterized, after clipping and culling
+    uint32_t pixels;
+    uint32_t tiles_rejected;    // Hidden whole by the tile depth bounds
 } opengl_context_t;
 
 // Context management
+// The color buffer has the GPU mode's size (the framebuffer's without a GPU)
 opengl_context_t* opengl_create_context(gpu_context_t* gpu);
 void opengl_destroy_context(opengl_context_t* ctx);
+void opengl_make_current(opengl_context_t* ctx);
+// Copies the color buffer to the framebuffer at (x, y)
+void opengl_present(opengl_context_t* ctx, int x, int y);
 
 // Basic OpenGL functions
 void opengl_clear(opengl_context_t* ctx, uint32_t mask);
 void opengl_viewport(opengl_context_t* ctx, int x, int y, int width, int height);
 void opengl_clear_color(opengl_context_t* ctx, float r, float g, float b, float a);
+void opengl_enable(opengl_context_t* ctx, uint32_t capability);
+void opengl_disable(opengl_context_t* ctx, uint32_t capability);
+
+// Depth buffer
+void opengl_depth_func(opengl_context_t* ctx, uint32_t func);
+void opengl_depth_mask(opengl_context_t* ctx, int write);
+void opengl_clear_depth(opengl_context_t* ctx, float depth);
+// 16 or 32 bits (the default); the buffer is reallocated and cleared. Returns 1 on success
+int opengl_depth_bits(opengl_context_t* ctx, int bits);
 
-// Primitive drawing
+// Primitive drawing: GL_TRIANGLES, GL_TRIANGLE_STRIP, GL_TRIANGLE_FAN,
+// GL_QUADS, GL_QUAD_STRIP and GL_POLYGON are rasterized; points and lines are not
 void opengl_begin(opengl_context_t* ctx, uint32_t mode);
 void opengl_end(opengl_context_t* ctx);
 void opengl_vertex2f(opengl_context_t* ctx, float x, float y);
 void opengl_vertex3f(opengl_context_t* ctx, float x, float y, float z);
 void opengl_color3f(opengl_context_t* ctx, float r, float g, float b);
 void opengl_color4f(opengl_context_t* ctx, float r, float g, float b, float a);
+void opengl_texcoord2f(opengl_context_t* ctx, float u, float v);
 
 // Matrix operations
 void opengl_matrix_mode(opengl_context_t* ctx, uint32_t mode);
 void opengl_load_identity(opengl_context_t* ctx);
+// Saves / restores the current mode's matrix; 32 levels for each mode
+void opengl_push_matrix(opengl_context_t* ctx);
+void opengl_pop_matrix(opengl_context_t* ctx);
 void opengl_translatef(opengl_context_t* ctx, float x, float y, float z);
 void opengl_scalef(opengl_context_t* ctx, float x, float y, float z);
 void opengl_rotatef(opengl_context_t* ctx, float angle, float x, float y, float z);
+void opengl_ortho(opengl_context_t* ctx, float left, float right, float bottom, float top, float near, float far);
+void opengl_frustum(opengl_context_t* ctx, float left, float right, float bottom, float top, float near, float far);
 
-// Texture management
-uint32_t opengl_gen_texture(opengl_context_t* ctx);
+// Texture management. Texture objects are shared by all contexts. Storage
+// counts against a memory budget: when it is exceeded the least recently
+// used textures are evicted, and draw untextured until uploaded again
+uint32_t opengl_gen_texture(opengl_context_t* ctx);     // 0 if the table is full
+void opengl_delete_texture(opengl_context_t* ctx, uint32_t texture);
 void opengl_bind_texture(opengl_context_t* ctx, uint32_t texture);
+// data: width * height ARGB pixels, the first row at t = 0; sizes are powers of two
+// up to 1024. Mipmaps are built when GL_GENERATE_MIPMAP is set on the texture
 void opengl_tex_image2d(opengl_context_t* ctx, int width, int height, const void* data);
 void opengl_tex_parameteri(opengl_context_t* ctx, uint32_t param, int value);
+int opengl_texture_resident(uint32_t texture);
+void opengl_texture_budget(uint32_t pages);
+// Resident textures, pages they take and evictions so far
+void opengl_texture_stats(uint32_t* resident, uint32_t* pages, uint32_t* evictions);
+
+// Vertex buffer objects: vertices uploaded once and drawn without per-vertex
+// calls. Shared by all contexts, like textures
+uint32_t opengl_gen_buffer(opengl_context_t* ctx);      // 0 if the table is full
+void opengl_delete_buffer(opengl_context_t* ctx, uint32_t buffer);
+void opengl_bind_buffer(opengl_context_t* ctx, uint32_t buffer);
+// Replaces the bound buffer's contents; returns 1 on success
+int opengl_buffer_data(opengl_context_t* ctx, const gl_vertex_t* vertices, uint32_t count);
+// Vertices [first, first + count) of the bound buffer as primitives of mode
+void opengl_draw_arrays(opengl_context_t* ctx, uint32_t mode, uint32_t first, uint32_t count);
+
+// Display lists. Recorded: primitives (their vertices copied into the list),
+// color and texture coordinates, matrix operations and push/pop, enable/disable,
+// viewport, depth function and mask, clear values and clears, texture binding,
+// parameters and images (a copy of the texels), glDrawArrays and calls of other
+// lists. Consecutive matrix operations are folded into one precomputed matrix.
+// As in OpenGL, object management always runs immediately and is not recorded:
+// gen/delete of textures, buffers and lists, glBindBuffer, glBufferData, plus
+// opengl_depth_bits and opengl_texture_budget
+uint32_t opengl_gen_lists(opengl_context_t* ctx, uint32_t range);   // First id, 0 if none free
+void opengl_delete_lists(opengl_context_t* ctx, uint32_t list, uint32_t range);
+void opengl_new_list(opengl_context_t* ctx, uint32_t list, uint32_t mode);
+void opengl_end_list(opengl_context_t* ctx);
+void opengl_call_list(opengl_context_t* ctx, uint32_t list);
 
 // Shader support
 int opengl_supports_shaders(gpu_context_t* gpu);
 uint32_t opengl_create_shader(opengl_context_t* ctx, const char* source, int type);
 uint32_t opengl_create_program(opengl_context_t* ctx, uint32_t vertex_shader, uint32_t fragment_shader);
 
+// Spinning cube in front of a wall of textured cubes, depth tested (shell command "gldemo")
+void opengl_demo(void);
+// Vertices per second through immediate mode, buffer objects and display lists (shell command "glbench")
+void opengl_benchmark(void);
+
 // Helper macros for easier usage
 #define glClear(mask) opengl_clear(gl_state.current_ctx, mask)
 #define glViewport(x, y, w, h) opengl_viewport(gl_state.current_ctx, x, y, w, h)
@@ -121,29 +262,54 @@ uint32_t opengl_create_program(opengl_context_t* ctx, uint32_t vertex_shader, ui
 #define glVertex3f(x, y, z) opengl_vertex3f(gl_state.current_ctx, x, y, z)
 #define glColor3f(r, g, b) opengl_color3f(gl_state.current_ctx, r, g, b)
 #define glColor4f(r, g, b, a) opengl_color4f(gl_state.current_ctx, r, g, b, a)
+#define glTexCoord2f(u, v) opengl_texcoord2f(gl_state.current_ctx, u, v)
+#define glDepthFunc(func) opengl_depth_func(gl_state.current_ctx, func)
+#define glDepthMask(flag) opengl_depth_mask(gl_state.current_ctx, flag)
+#define glClearDepth(depth) opengl_clear_depth(gl_state.current_ctx, depth)
+#define glEnable(cap) opengl_enable(gl_state.current_ctx, cap)
+#define glDisable(cap) opengl_disable(gl_state.current_ctx, cap)
 #define glMatrixMode(mode) opengl_matrix_mode(gl_state.current_ctx, mode)
 #define glLoadIdentity() opengl_load_identity(gl_state.current_ctx)
+#define glPushMatrix() opengl_push_matrix(gl_state.current_ctx)
+#define glPopMatrix() opengl_pop_matrix(gl_state.current_ctx)
 #define glTranslatef(x, y, z) opengl_translatef(gl_state.current_ctx, x, y, z)
 #define glScalef(x, y, z) opengl_scalef(gl_state.current_ctx, x, y, z)
 #define glRotatef(angle, x, y, z) opengl_rotatef(gl_state.current_ctx, angle, x, y, z)
+#define glOrtho(l, r, b, t, n, f) opengl_ortho(gl_state.current_ctx, l, r, b, t, n, f)
+#define glFrustum(l, r, b, t, n, f) opengl_frustum(gl_state.current_ctx, l, r, b, t, n, f)
+#define glGenBuffers(count, buffers) *(buffers) = opengl_gen_buffer(gl_state.current_ctx)
+#define glDeleteBuffers(count, buffers) opengl_delete_buffer(gl_state.current_ctx, *(buffers))
+#define glBindBuffer(target, buffer) opengl_bind_buffer(gl_state.current_ctx, buffer)
+#define glBufferData(target, size, data, usage) \
+    opengl_buffer_data(gl_state.current_ctx, data, (size) / sizeof(gl_vertex_t))
+#define glDrawArrays(mode, first, count) opengl_draw_arrays(gl_state.current_ctx, mode, first, count)
+#define glGenLists(range) opengl_gen_lists(gl_state.current_ctx, range)
+#define glDeleteLists(list, range) opengl_delete_lists(gl_state.current_ctx, list, range)
+#define glNewList(list, mode) opengl_new_list(gl_state.current_ctx, list, mode)
+#define glEndList() opengl_end_list(gl_state.current_ctx)
+#define glCallList(list) opengl_call_list(gl_state.current_ctx, list)
 #define glGenTextures(count, textures) *(textures) = opengl_gen_texture(gl_state.current_ctx)
+#define glDeleteTextures(count, textures) opengl_delete_texture(gl_state.current_ctx, *(textures))
 #define glBindTexture(target, texture) opengl_bind_texture(gl_state.current_ctx, texture)
 #define glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels) \
     opengl_tex_image2d(gl_state.current_ctx, width, height, pixels)
 #define glTexParameteri(target, pname, param) opengl_tex_parameteri(gl_state.current_ctx, pname, param)
 
 // Global OpenGL state for macro access
-extern struct {
+typedef struct {
     opengl_context_t* current_ctx;
     uint32_t matrix_mode;
-    float modelview_matrix[16];
+    float modelview_matrix[16];     // Column-major, as in OpenGL
     float projection_matrix[16];
     float texture_matrix[16];
     float* current_matrix;
     uint32_t active_texture;
     uint32_t blend_enabled;
     uint32_t depth_test_enabled;
-    uint32_t cull_face_enabled;
-} gl_state;
+    uint32_t cull_face_enabled;     // Culls clockwise (back) faces
+    uint32_t texture_2d_enabled;    // Texels modulate the vertex color
+} gl_state_t;
+
+extern gl_state_t gl_state;
 
-#endif // OPENGL_H
\ No newline at end of file
+#endif // OPENGL_H
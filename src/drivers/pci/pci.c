@@ -3,9 +3,22 @@
 #include "../screen.h"
 #include "../text_output.h"
 
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
 static pci_device_t pci_devices[32];
 static int pci_device_count = 0;
 
+static inline void outl(uint16_t port, uint32_t value) {
+    asm volatile ("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    asm volatile ("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
 // Базовая эмуляция PCI
 int pci_scan_bus(void) {
     printf("PCI: Scanning bus...\n");
@@ -39,11 +52,53 @@ pci_device_t* pci_get_device(uint16_t vendor_id, uint16_t device_id) {
     return NULL;
 }
 
-// Заглушки для остальных функций
+// Механизм конфигурации #1
+static uint32_t pci_config_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return 0x80000000 | ((uint32_t)bus << 16) | ((uint32_t)(slot & 0x1F) << 11) |
+           ((uint32_t)(func & 0x07) << 8) | (offset & 0xFC);
+}
+
 uint32_t pci_read_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
-    return 0;
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(bus, slot, func, offset));
+    return inl(PCI_CONFIG_DATA);
 }
 
 void pci_write_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value) {
-    // Заглушка
+    outl(PCI_CONFIG_ADDRESS, pci_config_address(bus, slot, func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+int pci_find_device(uint16_t vendor_id, uint16_t device_id, pci_device_t* out) {
+    for (int bus = 0; bus < 256; bus++) {
+        for (int slot = 0; slot < 32; slot++) {
+            uint32_t id = pci_read_config(bus, slot, 0, 0x00);
+            if ((id & 0xFFFF) == 0xFFFF) continue;
+            
+            // Остальные функции опрашиваем только у многофункциональных устройств
+            int functions = (pci_read_config(bus, slot, 0, 0x0C) & 0x00800000) ? 8 : 1;
+            
+            for (int func = 0; func < functions; func++) {
+                if (func > 0) {
+                    id = pci_read_config(bus, slot, func, 0x00);
+                    if ((id & 0xFFFF) == 0xFFFF) continue;
+                }
+                if ((id & 0xFFFF) != vendor_id || (id >> 16) != device_id) continue;
+                
+                uint32_t class_reg = pci_read_config(bus, slot, func, 0x08);
+                out->vendor_id = vendor_id;
+                out->device_id = device_id;
+                out->class_code = class_reg >> 24;
+                out->subclass = (class_reg >> 16) & 0xFF;
+                out->prog_if = (class_reg >> 8) & 0xFF;
+                for (int i = 0; i < 6; i++) {
+                    out->base_addresses[i] = pci_read_config(bus, slot, func, 0x10 + i * 4);
+                }
+                out->bus = bus;
+                out->slot = slot;
+                out->func = func;
+                return 1;
+            }
+        }
+    }
+    return 0;
 }
\ No newline at end of file
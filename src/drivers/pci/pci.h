@@ -12,6 +12,9 @@ typedef struct {
     uint8_t subclass;
     uint8_t prog_if;
     uint32_t base_addresses[6];
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
 } pci_device_t;
 
 // PCI функции
@@ -20,4 +23,7 @@ pci_device_t* pci_get_device(uint16_t vendor_id, uint16_t device_id);
 uint32_t pci_read_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
 void pci_write_config(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value);
 
+// Поиск реального устройства в конфигурационном пространстве (порты 0xCF8/0xCFC)
+int pci_find_device(uint16_t vendor_id, uint16_t device_id, pci_device_t* out);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,272 @@
+// src/drivers/raster.c - Tiled half-space triangle rasterizer
+#include "raster.h"
+#include "screen.h"
+#include "frame.h"
+#include "text_output.h"
+#include "../lib/cpu.h"
+
+#define RUN_NONE (-0x7FFFFFFF)
+#define COORD_LIMIT (RASTER_MAX_COORD * RASTER_ONE)
+
+// E(x, y) = dx * (y - y0) - dy * (x - x0) for the edge p0 -> p1, sampled at
+// pixel centers. Inside the triangle all three are >= 0
+typedef struct {
+    int64_t value;    // At the top-left pixel of the current tile
+    int32_t a, b;     // Change per pixel to the right / per pixel down
+    int32_t reject;   // value + reject: largest E in the tile
+    int32_t accept;   // value + accept: smallest E in the tile
+} edge_t;
+
+typedef struct {
+    raster_span_fn span;
+    void* context;
+    int x0, x1, y0, y1;   // Emitted area: bounding box and clip
+    uint32_t pixels;
+    int start[RASTER_TILE];   // Open run of each row of the tile row
+} spans_t;
+
+static void edge_setup(edge_t* e, const raster_point_t* p0, const raster_point_t* p1, int x, int y) {
+    int dx = p1->x - p0->x;
+    int dy = p1->y - p0->y;
+    int sx = x * RASTER_ONE + RASTER_ONE / 2 - p0->x;
+    int sy = y * RASTER_ONE + RASTER_ONE / 2 - p0->y;
+
+    e->a = -dy * RASTER_ONE;
+    e->b = dx * RASTER_ONE;
+    e->value = (int64_t)dx * sy - (int64_t)dy * sx;
+    // Top-left rule: centers exactly on other edges belong to the neighbour
+    if (!(dy < 0 || (dy == 0 && dx > 0))) e->value -= 1;
+
+    e->reject = ((e->a > 0) ? e->a : 0) * (RASTER_TILE - 1) + ((e->b > 0) ? e->b : 0) * (RASTER_TILE - 1);
+    e->accept = ((e->a < 0) ? e->a : 0) * (RASTER_TILE - 1) + ((e->b < 0) ? e->b : 0) * (RASTER_TILE - 1);
+}
+
+static void run_close(spans_t* s, int row, int y, int end) {
+    int start = s->start[row];
+    if (start == RUN_NONE) return;
+
+    s->start[row] = RUN_NONE;
+    if (y < s->y0 || y >= s->y1) return;
+    if (start < s->x0) start = s->x0;
+    if (end > s->x1) end = s->x1;
+    if (start < end) {
+        s->span(y, start, end, s->context);
+        s->pixels += end - start;
+    }
+}
+
+// Runs of a tile that the edges in mask cross: per row, the covered columns
+static void tile_partial(spans_t* s, const edge_t* edges, const int64_t* values, int mask, int tx, int ty) {
+    int32_t w[3];
+    for (int i = 0; i < 3; i++) {
+        // An edge crossing the tile is small here, whatever it is elsewhere
+        w[i] = (mask & (1 << i)) ? (int32_t)values[i] : 0;
+    }
+
+    for (int row = 0; row < RASTER_TILE; row++) {
+        int first = RASTER_TILE, last = 0;
+        for (int col = 0; col < RASTER_TILE; col++) {
+            int inside = 1;
+            for (int i = 0; i < 3; i++) {
+                if ((mask & (1 << i)) && w[i] + col * edges[i].a < 0) inside = 0;
+            }
+            if (inside) {
+                if (first == RASTER_TILE) first = col;
+                last = col + 1;
+            }
+        }
+
+        // The triangle is convex: at most one run per row
+        if (first > 0) run_close(s, row, ty + row, tx);
+        if (first < last) {
+            if (s->start[row] == RUN_NONE) s->start[row] = tx + first;
+            if (last < RASTER_TILE) run_close(s, row, ty + row, tx + last);
+        }
+        for (int i = 0; i < 3; i++) w[i] += edges[i].b;
+    }
+}
+
+uint32_t raster_triangle(const raster_point_t* v0, const raster_point_t* v1, const raster_point_t* v2,
+                         const rect_t* clip, raster_span_fn span, void* context) {
+    return raster_triangle_tiles(v0, v1, v2, clip, span, 0, context);
+}
+
+uint32_t raster_triangle_tiles(const raster_point_t* v0, const raster_point_t* v1, const raster_point_t* v2,
+                               const rect_t* clip, raster_span_fn span, raster_tile_fn tile, void* context) {
+    const raster_point_t* p[3] = {v0, v1, v2};
+    for (int i = 0; i < 3; i++) {
+        if (p[i]->x < -COORD_LIMIT || p[i]->x > COORD_LIMIT ||
+            p[i]->y < -COORD_LIMIT || p[i]->y > COORD_LIMIT) return 0;
+    }
+
+    // Positive area makes every edge function positive inside
+    int64_t area = (int64_t)(v1->x - v0->x) * (v2->y - v0->y) - (int64_t)(v1->y - v0->y) * (v2->x - v0->x);
+    if (area == 0) return 0;
+    if (area < 0) {
+        p[1] = v2;
+        p[2] = v1;
+    }
+
+    // Pixels whose centers can be inside, cut to the clip rectangle
+    int min_x = p[0]->x, max_x = p[0]->x, min_y = p[0]->y, max_y = p[0]->y;
+    for (int i = 1; i < 3; i++) {
+        if (p[i]->x < min_x) min_x = p[i]->x;
+        if (p[i]->x > max_x) max_x = p[i]->x;
+        if (p[i]->y < min_y) min_y = p[i]->y;
+        if (p[i]->y > max_y) max_y = p[i]->y;
+    }
+    spans_t s;
+    s.x0 = (min_x - RASTER_ONE / 2 + RASTER_ONE - 1) >> RASTER_SUBPIXEL_BITS;
+    s.y0 = (min_y - RASTER_ONE / 2 + RASTER_ONE - 1) >> RASTER_SUBPIXEL_BITS;
+    s.x1 = ((max_x - RASTER_ONE / 2) >> RASTER_SUBPIXEL_BITS) + 1;
+    s.y1 = ((max_y - RASTER_ONE / 2) >> RASTER_SUBPIXEL_BITS) + 1;
+    if (s.x0 < clip->x) s.x0 = clip->x;
+    if (s.y0 < clip->y) s.y0 = clip->y;
+    if (s.x1 > clip->x + clip->width) s.x1 = clip->x + clip->width;
+    if (s.y1 > clip->y + clip->height) s.y1 = clip->y + clip->height;
+    if (s.x0 >= s.x1 || s.y0 >= s.y1) return 0;
+
+    s.span = span;
+    s.context = context;
+    s.pixels = 0;
+    for (int row = 0; row < RASTER_TILE; row++) s.start[row] = RUN_NONE;
+
+    // Tiles are aligned to the tile grid
+    int tx0 = s.x0 & ~(RASTER_TILE - 1);
+    int ty0 = s.y0 & ~(RASTER_TILE - 1);
+    edge_t edges[3];
+    for (int i = 0; i < 3; i++) edge_setup(&edges[i], p[i], p[(i + 1) % 3], tx0, ty0);
+
+    for (int ty = ty0; ty < s.y1; ty += RASTER_TILE) {
+        int64_t values[3] = {edges[0].value, edges[1].value, edges[2].value};
+
+        for (int tx = tx0; tx < s.x1; tx += RASTER_TILE) {
+            int partial = 0;
+            int reject = 0;
+            for (int i = 0; i < 3; i++) {
+                if (values[i] + edges[i].reject < 0) reject = 1;
+                else if (values[i] + edges[i].accept < 0) partial |= 1 << i;
+            }
+            if (!reject && tile && !tile(tx, ty, !partial, context)) reject = 1;
+
+            if (reject) {
+                for (int row = 0; row < RASTER_TILE; row++) run_close(&s, row, ty + row, tx);
+            } else if (!partial) {
+                // Whole tile inside: the runs simply continue
+                for (int row = 0; row < RASTER_TILE; row++) {
+                    if (s.start[row] == RUN_NONE) s.start[row] = tx;
+                }
+            } else {
+                tile_partial(&s, edges, values, partial, tx, ty);
+            }
+
+            for (int i = 0; i < 3; i++) values[i] += edges[i].a * RASTER_TILE;
+        }
+        for (int row = 0; row < RASTER_TILE; row++) run_close(&s, row, ty + row, s.x1);
+
+        for (int i = 0; i < 3; i++) edges[i].value += (int64_t)edges[i].b * RASTER_TILE;
+    }
+    return s.pixels;
+}
+
+// ==================== BENCHMARK ====================
+
+#define BENCH_TRIANGLES 2000
+
+// The old fill_triangle: edge intersections per scanline, then a pixel at a time
+static void fill_triangle_scanline(int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color) {
+    int min_y = (y1 < y2) ? ((y1 < y3) ? y1 : y3) : ((y2 < y3) ? y2 : y3);
+    int max_y = (y1 > y2) ? ((y1 > y3) ? y1 : y3) : ((y2 > y3) ? y2 : y3);
+
+    for (int y = min_y; y <= max_y; y++) {
+        int x_start = framebuffer_width;
+        int x_end = 0;
+        int xs[3][4] = {{x1, y1, x2, y2}, {x2, y2, x3, y3}, {x3, y3, x1, y1}};
+        for (int e = 0; e < 3; e++) {
+            int ax = xs[e][0], ay = xs[e][1], bx = xs[e][2], by = xs[e][3];
+            if (((y >= ay && y <= by) || (y >= by && y <= ay)) && by != ay) {
+                int x = ax + (bx - ax) * (y - ay) / (by - ay);
+                if (x < x_start) x_start = x;
+                if (x > x_end) x_end = x;
+            }
+        }
+        for (int x = x_start; x <= x_end; x++) framebuffer_put_pixel(x, y, color);
+    }
+}
+
+static void bench_span(int y, int x0, int x1, void* context) {
+    framebuffer_fill_span(x0, y, x1 - x0, *(uint32_t*)context);
+}
+
+static uint32_t bench_seed;
+
+static int bench_random(int range) {
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return (bench_seed >> 16) % range;
+}
+
+// Triangles of about size pixels on a side, all on screen
+static void bench_triangle(int size, int* v) {
+    int x = bench_random(framebuffer_width - size);
+    int y = bench_random(framebuffer_height - size);
+    v[0] = x + bench_random(size);
+    v[1] = y;
+    v[2] = x;
+    v[3] = y + size - 1 - bench_random(size / 2 + 1);
+    v[4] = x + size - 1;
+    v[5] = y + bench_random(size);
+}
+
+void raster_benchmark(void) {
+    static const int sizes[] = {8, 32, 128};
+
+    if (!framebuffer || !cpu_tsc_khz()) {
+        printf("Raster: no framebuffer or TSC rate unknown\n");
+        return;
+    }
+    if (framebuffer_width < 256 || framebuffer_height < 256) {
+        printf("Raster: screen too small\n");
+        return;
+    }
+
+    uint32_t rates[3][2][2];   // [size][scanline, tiled][Ktri/s, Mpix/s]
+    rect_t screen = {0, 0, framebuffer_width, framebuffer_height};
+    framebuffer_reset_clip();
+
+    for (int s = 0; s < 3; s++) {
+        int count = BENCH_TRIANGLES * 8 / sizes[s];
+        uint32_t pixels = 0;
+
+        // Same triangles for both, so the tiled pixel count serves for both rates
+        for (int path = 1; path >= 0; path--) {
+            bench_seed = 12345;
+            uint64_t start = cpu_read_tsc();
+            for (int i = 0; i < count; i++) {
+                int v[6];
+                uint32_t color = 0xFF000000 | (i * 0x10305);
+                bench_triangle(sizes[s], v);
+                if (path) {
+                    raster_point_t a = raster_pixel(v[0], v[1]);
+                    raster_point_t b = raster_pixel(v[2], v[3]);
+                    raster_point_t c = raster_pixel(v[4], v[5]);
+                    pixels += raster_triangle(&a, &b, &c, &screen, bench_span, &color);
+                } else {
+                    fill_triangle_scanline(v[0], v[1], v[2], v[3], v[4], v[5], color);
+                }
+            }
+            uint32_t us = cpu_cycles_to_us(cpu_read_tsc() - start);
+            if (us == 0) us = 1;
+            rates[s][path][0] = (uint32_t)count * 1000 / us;
+            rates[s][path][1] = pixels / us;
+        }
+    }
+
+    // The benchmark drew over the screen
+    desktop_repaint_now();
+
+    printf("Triangle fill (%d triangles of 8 px, fewer of larger sizes):\n", BENCH_TRIANGLES);
+    for (int s = 0; s < 3; s++) {
+        printf("  %3d px: scanline %6u Ktri/s %4u Mpix/s, tiled %6u Ktri/s %4u Mpix/s\n", sizes[s],
+               rates[s][0][0], rates[s][0][1], rates[s][1][0], rates[s][1][1]);
+    }
+}
@@ -0,0 +1,48 @@
+// src/drivers/raster.h - Tiled half-space triangle rasterizer
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>
+#include "region.h"
+
+// Vertex positions are fixed point with this many fractional bits
+#define RASTER_SUBPIXEL_BITS 4
+#define RASTER_ONE (1 << RASTER_SUBPIXEL_BITS)
+#define RASTER_TILE 8
+
+// Coordinates further out than this (in pixels) are not rasterized
+#define RASTER_MAX_COORD 8192
+
+typedef struct {
+    int x, y;   // Fixed point: pixel * RASTER_ONE; pixel centers are at +RASTER_ONE / 2
+} raster_point_t;
+
+// Receives the covered pixels [x0, x1) of row y. Consecutive covered tiles
+// are merged, so one call usually spans the whole row of the triangle
+typedef void (*raster_span_fn)(int y, int x0, int x1, void* context);
+
+// Pixels whose centers are inside the triangle, either winding, with the
+// top-left rule on edges: triangles sharing an edge never overlap or leave gaps.
+// Only pixels inside clip are emitted. Returns the number of pixels covered
+uint32_t raster_triangle(const raster_point_t* v0, const raster_point_t* v1, const raster_point_t* v2,
+                         const rect_t* clip, raster_span_fn span, void* context);
+
+// Asked about every tile (x, y: its top-left pixel) the triangle touches before
+// any of its spans; full = the triangle covers the whole tile. Returning 0 drops
+// the tile (e.g. it is hidden by the depth buffer)
+typedef int (*raster_tile_fn)(int x, int y, int full, void* context);
+
+// raster_triangle with a tile test; tile may be 0
+uint32_t raster_triangle_tiles(const raster_point_t* v0, const raster_point_t* v1, const raster_point_t* v2,
+                               const rect_t* clip, raster_span_fn span, raster_tile_fn tile, void* context);
+
+// Vertex in whole pixels: the pixel's center
+static inline raster_point_t raster_pixel(int x, int y) {
+    raster_point_t p = {x * RASTER_ONE + RASTER_ONE / 2, y * RASTER_ONE + RASTER_ONE / 2};
+    return p;
+}
+
+// Triangles and Mpixels per second against the scanline filler (shell command "rasterbench")
+void raster_benchmark(void);
+
+#endif
@@ -0,0 +1,145 @@
+// src/drivers/region.c - Rectangle list regions (damage, visibility)
+#include "region.h"
+
+static int rect_area(const rect_t* r) {
+    return r->width * r->height;
+}
+
+static void rect_bounds(const rect_t* a, const rect_t* b, rect_t* out) {
+    int x0 = a->x < b->x ? a->x : b->x;
+    int y0 = a->y < b->y ? a->y : b->y;
+    int x1 = (a->x + a->width > b->x + b->width) ? a->x + a->width : b->x + b->width;
+    int y1 = (a->y + a->height > b->y + b->height) ? a->y + a->height : b->y + b->height;
+
+    out->x = x0;
+    out->y = y0;
+    out->width = x1 - x0;
+    out->height = y1 - y0;
+}
+
+int rect_intersect(const rect_t* a, const rect_t* b, rect_t* out) {
+    int x0 = a->x > b->x ? a->x : b->x;
+    int y0 = a->y > b->y ? a->y : b->y;
+    int x1 = (a->x + a->width < b->x + b->width) ? a->x + a->width : b->x + b->width;
+    int y1 = (a->y + a->height < b->y + b->height) ? a->y + a->height : b->y + b->height;
+
+    if (x0 >= x1 || y0 >= y1) return 0;
+
+    out->x = x0;
+    out->y = y0;
+    out->width = x1 - x0;
+    out->height = y1 - y0;
+    return 1;
+}
+
+static int rects_touch(const rect_t* a, const rect_t* b) {
+    return a->x <= b->x + b->width && b->x <= a->x + a->width &&
+           a->y <= b->y + b->height && b->y <= a->y + a->height;
+}
+
+static void region_remove(region_t* region, int index) {
+    region->rects[index] = region->rects[--region->count];
+}
+
+void region_clear(region_t* region) {
+    region->count = 0;
+}
+
+int region_is_empty(const region_t* region) {
+    return region->count == 0;
+}
+
+void region_add(region_t* region, int x, int y, int width, int height) {
+    if (width <= 0 || height <= 0) return;
+
+    rect_t r = {x, y, width, height};
+    rect_t merged;
+
+    // Merge while the bounding box wastes no more than the overlap saves
+    int i = 0;
+    while (i < region->count) {
+        rect_t* e = &region->rects[i];
+        if (rects_touch(&r, e)) {
+            rect_bounds(&r, e, &merged);
+            if (rect_area(&merged) <= rect_area(&r) + rect_area(e)) {
+                r = merged;
+                region_remove(region, i);
+                i = 0;  // The grown rectangle may now absorb earlier ones
+                continue;
+            }
+        }
+        i++;
+    }
+
+    if (region->count < REGION_MAX_RECTS) {
+        region->rects[region->count++] = r;
+        return;
+    }
+
+    // Full: grow the rectangle that gets the least extra area
+    int best = 0;
+    int best_growth = 0x7FFFFFFF;
+    for (i = 0; i < region->count; i++) {
+        rect_bounds(&r, &region->rects[i], &merged);
+        int growth = rect_area(&merged) - rect_area(&region->rects[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    rect_bounds(&r, &region->rects[best], &merged);
+    region_remove(region, best);
+    region_add(region, merged.x, merged.y, merged.width, merged.height);
+}
+
+void region_subtract(region_t* region, const rect_t* hole) {
+    region_t result;
+    rect_t cut;
+
+    result.count = 0;
+    for (int i = 0; i < region->count; i++) {
+        const rect_t* r = &region->rects[i];
+        rect_t pieces[4];
+        int n = 0;
+
+        if (!rect_intersect(r, hole, &cut)) {
+            pieces[n++] = *r;
+        } else {
+            // Full-width bands above and below the hole, then the sides
+            if (cut.y > r->y) {
+                pieces[n++] = (rect_t){r->x, r->y, r->width, cut.y - r->y};
+            }
+            if (cut.y + cut.height < r->y + r->height) {
+                pieces[n++] = (rect_t){r->x, cut.y + cut.height, r->width,
+                                       r->y + r->height - cut.y - cut.height};
+            }
+            if (cut.x > r->x) {
+                pieces[n++] = (rect_t){r->x, cut.y, cut.x - r->x, cut.height};
+            }
+            if (cut.x + cut.width < r->x + r->width) {
+                pieces[n++] = (rect_t){cut.x + cut.width, cut.y,
+                                       r->x + r->width - cut.x - cut.width, cut.height};
+            }
+        }
+
+        if (result.count + n > REGION_MAX_RECTS) {
+            // Out of room: keep the rectangle whole
+            if (result.count >= REGION_MAX_RECTS) return;
+            pieces[0] = *r;
+            n = 1;
+        }
+        for (int p = 0; p < n; p++) {
+            result.rects[result.count++] = pieces[p];
+        }
+    }
+
+    *region = result;
+}
+
+int region_area(const region_t* region) {
+    int area = 0;
+    for (int i = 0; i < region->count; i++) {
+        area += rect_area(&region->rects[i]);
+    }
+    return area;
+}
@@ -0,0 +1,28 @@
+// src/drivers/region.h - Screen regions as short lists of rectangles
+#ifndef REGION_H
+#define REGION_H
+
+// Beyond this many rectangles the closest ones are merged (over-covering is safe)
+#define REGION_MAX_RECTS 32
+
+typedef struct {
+    int x, y;
+    int width, height;
+} rect_t;
+
+typedef struct {
+    int count;
+    rect_t rects[REGION_MAX_RECTS];
+} region_t;
+
+int rect_intersect(const rect_t* a, const rect_t* b, rect_t* out);  // 0 if disjoint
+
+void region_clear(region_t* region);
+int region_is_empty(const region_t* region);
+// Adds a rectangle, merging it with overlapping or adjacent ones
+void region_add(region_t* region, int x, int y, int width, int height);
+// Cuts a rectangle out; if the pieces do not fit, the region is left larger
+void region_subtract(region_t* region, const rect_t* hole);
+int region_area(const region_t* region);
+
+#endif
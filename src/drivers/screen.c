@@ -2,12 +2,39 @@
 #include "screen.h"
 #include "../lib/string.h"
 #include "../lib/memory.h"
+#include "../lib/pages.h"
+#include "../multiboot.h"
+#include "gpu.h"
+#include "blit.h"
+#include "glyph.h"
+#include "frame.h"
+#include "raster.h"
 
-// Global framebuffer
-uint32_t* framebuffer = (uint32_t*)0xFD000000;
-int framebuffer_width = SCREEN_WIDTH;
-int framebuffer_height = SCREEN_HEIGHT;
-int framebuffer_pitch = SCREEN_WIDTH * BYTES_PER_PIXEL;
+// Global framebuffer, set up by init_framebuffer from the bootloader mode
+uint8_t* framebuffer = 0;
+uint8_t* framebuffer_front = 0;
+int framebuffer_width = 0;
+int framebuffer_height = 0;
+int framebuffer_pitch = 0;
+pixel_format_t framebuffer_format;
+
+// Back buffer in cached RAM: blending reads no longer touch video memory
+static uint8_t back_buffer[BACK_BUFFER_SIZE] __attribute__((aligned(16)));
+static int back_buffer_active = 0;
+
+// Damaged span [x0, x1) of every scanline for this and the previous frame
+typedef struct {
+    int16_t x0[SCREEN_MAX_HEIGHT];
+    int16_t x1[SCREEN_MAX_HEIGHT];
+    int y0, y1;
+} damage_rows_t;
+
+static damage_rows_t damage_sets[2];
+static damage_rows_t* damage = &damage_sets[0];
+static damage_rows_t* damage_prev = &damage_sets[1];
+
+// Clip rectangle [x0, x1) x [y0, y1) for all drawing
+static int clip_x0 = 0, clip_y0 = 0, clip_x1 = 0, clip_y1 = 0;
 
 desktop_t* global_desktop = 0;  // Remove static keyword
 static window_t* windows[MAX_WINDOWS];
@@ -81,33 +108,154 @@ unsigned char font_8x8[128][8] = {
     [122] = {0x00, 0x00, 0x7E, 0x0C, 0x18, 0x30, 0x60, 0x7E}, // z
 };
 
-// Mouse cursor data
-static unsigned char mouse_cursor_data[CURSOR_HEIGHT][CURSOR_WIDTH] = {
-    {0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xC0, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xE0, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xF0, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xF8, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFC, 0x3F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFE, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0xC0, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0xE0, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0xF0, 0x0F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0xF8, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0xFC, 0x3F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0xFE, 0x7F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+// Mouse cursor shape: X outline, . fill, space transparent
+static const char* mouse_cursor_shape[CURSOR_HEIGHT] = {
+    "X           ",
+    "XX          ",
+    "X.X         ",
+    "X..X        ",
+    "X...X       ",
+    "X....X      ",
+    "X.....X     ",
+    "X......X    ",
+    "X.......X   ",
+    "X........X  ",
+    "X.....XXXXX ",
+    "X..X..X     ",
+    "X.X X..X    ",
+    "XX  X..X    ",
+    "X    X..X   ",
+    "      XX    "
 };
 
+// The same shape as ARGB, built on first use
+static uint32_t mouse_cursor_image[CURSOR_HEIGHT][CURSOR_WIDTH];
+static int mouse_cursor_ready = 0;
+
+// Cursor plane: with a back buffer the cursor never enters it, so moving it
+// only re-presents the old and new 12x16 areas
+static int cursor_plane_x = 0;
+static int cursor_plane_y = 0;
+static int cursor_plane_visible = 0;
+
+static compose_stats_t compose_stats;
+// Drawn over the windows in every composed frame (frame profiler)
+static void (*desktop_overlay)(void) = 0;
+
 // ==================== FRAMEBUFFER FUNCTIONS ====================
 
+static void pixel_format_detect(pixel_format_t* f) {
+    f->bytes_per_pixel = (f->bpp + 7) / 8;
+    
+    int rgb888 = f->red_pos == 16 && f->red_size == 8 &&
+                 f->green_pos == 8 && f->green_size == 8 &&
+                 f->blue_pos == 0 && f->blue_size == 8;
+    
+    if (f->bpp == 32 && rgb888) {
+        f->kind = PIXEL_FORMAT_XRGB8888;
+    } else if (f->bpp == 24 && rgb888) {
+        f->kind = PIXEL_FORMAT_RGB888;
+    } else if (f->bpp == 16 && f->red_pos == 11 && f->red_size == 5 &&
+               f->green_pos == 5 && f->green_size == 6 &&
+               f->blue_pos == 0 && f->blue_size == 5) {
+        f->kind = PIXEL_FORMAT_RGB565;
+    } else {
+        f->kind = PIXEL_FORMAT_GENERIC;
+    }
+}
+
+static void damage_reset(damage_rows_t* d) {
+    for (int y = d->y0; y < d->y1; y++) {
+        d->x0[y] = INT16_MAX;
+        d->x1[y] = 0;
+    }
+    d->y0 = SCREEN_MAX_HEIGHT;
+    d->y1 = 0;
+}
+
+static void damage_fill(damage_rows_t* d) {
+    for (int y = 0; y < framebuffer_height; y++) {
+        d->x0[y] = 0;
+        d->x1[y] = framebuffer_width;
+    }
+    d->y0 = 0;
+    d->y1 = framebuffer_height;
+}
+
+static inline void mark_dirty_span(int x, int y, int count) {
+    if (!back_buffer_active) return;
+    if (x < damage->x0[y]) damage->x0[y] = x;
+    if (x + count > damage->x1[y]) damage->x1[y] = x + count;
+    if (y < damage->y0) damage->y0 = y;
+    if (y >= damage->y1) damage->y1 = y + 1;
+}
+
+int framebuffer_configure(void* address, int width, int height, int pitch, const pixel_format_t* format) {
+    pixel_format_t f = *format;
+    
+    if (!address || width <= 0 || height <= 0) return 0;
+    if (f.bpp != 16 && f.bpp != 15 && f.bpp != 24 && f.bpp != 32) return 0;
+    if (f.red_size == 0 || f.red_size > 8 || f.green_size == 0 || f.green_size > 8 ||
+        f.blue_size == 0 || f.blue_size > 8) return 0;
+    
+    pixel_format_detect(&f);
+    if (pitch < width * f.bytes_per_pixel) return 0;
+    
+    framebuffer_front = (uint8_t*)address;
+    framebuffer_width = width;
+    framebuffer_height = height;
+    framebuffer_pitch = pitch;
+    framebuffer_format = f;
+    framebuffer_reset_clip();
+    
+    // The back buffer keeps the video memory pitch so rows copy 1:1
+    back_buffer_active = height <= SCREEN_MAX_HEIGHT && (uint32_t)pitch * height <= BACK_BUFFER_SIZE;
+    framebuffer = back_buffer_active ? back_buffer : framebuffer_front;
+    
+    if (back_buffer_active) {
+        damage_sets[0].y0 = damage_sets[1].y0 = 0;
+        damage_sets[0].y1 = damage_sets[1].y1 = SCREEN_MAX_HEIGHT;
+        damage_reset(&damage_sets[0]);
+        damage_reset(&damage_sets[1]);
+        // Neither visible page matches the back buffer yet
+        damage_fill(damage);
+        damage_fill(damage_prev);
+    }
+    return 1;
+}
+
 int init_framebuffer(void) {
-    // Allocate framebuffer memory
-    framebuffer = (uint32_t*)0xFD000000; // Use high memory area
+    const multiboot_framebuffer_t* info = multiboot_get_framebuffer();
+    pixel_format_t format;
+    int ok;
     
-    if (!framebuffer) {
+    if (info) {
+        // Without paging only the low 4 GB are addressable
+        if (info->addr > 0xFFFFFFFFULL) return 0;
+        
+        format.bpp = info->bpp;
+        format.red_pos = info->red_pos;
+        format.red_size = info->red_size;
+        format.green_pos = info->green_pos;
+        format.green_size = info->green_size;
+        format.blue_pos = info->blue_pos;
+        format.blue_size = info->blue_size;
+        ok = framebuffer_configure((void*)(uint32_t)info->addr, info->width, info->height,
+                                   info->pitch, &format);
+    } else {
+        // No mode reported (e.g. QEMU -kernel): assume the Bochs/QEMU std VGA LFB
+        format.bpp = BITS_PER_PIXEL;
+        format.red_pos = 16;
+        format.red_size = 8;
+        format.green_pos = 8;
+        format.green_size = 8;
+        format.blue_pos = 0;
+        format.blue_size = 8;
+        ok = framebuffer_configure((void*)0xFD000000, SCREEN_WIDTH, SCREEN_HEIGHT,
+                                   SCREEN_WIDTH * BYTES_PER_PIXEL, &format);
+    }
+    
+    if (!ok) {
         return 0;
     }
     
@@ -117,40 +265,330 @@ int init_framebuffer(void) {
     return 1;
 }
 
+static uint32_t channel_pack(uint32_t value, int pos, int size) {
+    return (value >> (8 - size)) << pos;
+}
+
+static uint32_t channel_unpack(uint32_t pixel, int pos, int size) {
+    uint32_t value = ((pixel >> pos) & ((1u << size) - 1)) << (8 - size);
+    return value | (value >> size);  // Replicate high bits into the low ones
+}
+
+uint32_t pixel_pack(uint32_t color) {
+    const pixel_format_t* f = &framebuffer_format;
+    
+    switch (f->kind) {
+        case PIXEL_FORMAT_XRGB8888:
+            return color;
+        case PIXEL_FORMAT_RGB888:
+            return color & 0x00FFFFFF;
+        case PIXEL_FORMAT_RGB565:
+            return ((color >> 8) & 0xF800) | ((color >> 5) & 0x07E0) | ((color >> 3) & 0x001F);
+        default:
+            return channel_pack((color >> 16) & 0xFF, f->red_pos, f->red_size) |
+                   channel_pack((color >> 8) & 0xFF, f->green_pos, f->green_size) |
+                   channel_pack(color & 0xFF, f->blue_pos, f->blue_size);
+    }
+}
+
+uint32_t pixel_unpack(uint32_t pixel) {
+    const pixel_format_t* f = &framebuffer_format;
+    
+    switch (f->kind) {
+        case PIXEL_FORMAT_XRGB8888:
+            return pixel;
+        case PIXEL_FORMAT_RGB888:
+            return 0xFF000000 | pixel;
+        default:
+            return 0xFF000000 |
+                   (channel_unpack(pixel, f->red_pos, f->red_size) << 16) |
+                   (channel_unpack(pixel, f->green_pos, f->green_size) << 8) |
+                   channel_unpack(pixel, f->blue_pos, f->blue_size);
+    }
+}
+
+static inline uint8_t* framebuffer_address(int x, int y) {
+    return framebuffer + y * framebuffer_pitch + x * framebuffer_format.bytes_per_pixel;
+}
+
+static inline void store_pixel(uint8_t* p, uint32_t pixel) {
+    switch (framebuffer_format.bytes_per_pixel) {
+        case 4:
+            *(uint32_t*)p = pixel;
+            break;
+        case 3:
+            p[0] = pixel;
+            p[1] = pixel >> 8;
+            p[2] = pixel >> 16;
+            break;
+        default:
+            *(uint16_t*)p = pixel;
+            break;
+    }
+}
+
+static inline uint32_t load_pixel(const uint8_t* p) {
+    switch (framebuffer_format.bytes_per_pixel) {
+        case 4:
+            return *(const uint32_t*)p;
+        case 3:
+            return p[0] | (p[1] << 8) | (p[2] << 16);
+        default:
+            return *(const uint16_t*)p;
+    }
+}
+
 void framebuffer_clear(uint32_t color) {
     if (framebuffer) {
-        for (int i = 0; i < framebuffer_width * framebuffer_height; i++) {
-            framebuffer[i] = color;
+        for (int y = 0; y < framebuffer_height; y++) {
+            framebuffer_fill_span(0, y, framebuffer_width, color);
         }
     }
 }
 
 void framebuffer_put_pixel(int x, int y, uint32_t color) {
-    if (x >= 0 && x < framebuffer_width && y >= 0 && y < framebuffer_height) {
-        framebuffer[y * framebuffer_width + x] = color;
+    if (x >= clip_x0 && x < clip_x1 && y >= clip_y0 && y < clip_y1) {
+        mark_dirty_span(x, y, 1);
+        if (framebuffer_format.kind == PIXEL_FORMAT_XRGB8888) {
+            ((uint32_t*)(framebuffer + y * framebuffer_pitch))[x] = color;
+        } else {
+            store_pixel(framebuffer_address(x, y), pixel_pack(color));
+        }
     }
 }
 
 uint32_t framebuffer_get_pixel(int x, int y) {
     if (x >= 0 && x < framebuffer_width && y >= 0 && y < framebuffer_height) {
-        return framebuffer[y * framebuffer_width + x];
+        if (framebuffer_format.kind == PIXEL_FORMAT_XRGB8888) {
+            return ((uint32_t*)(framebuffer + y * framebuffer_pitch))[x];
+        }
+        return pixel_unpack(load_pixel(framebuffer_address(x, y)));
     }
     return 0;
 }
 
+// Fills count pixels of row y starting at x; the color is converted once
+void framebuffer_fill_span(int x, int y, int count, uint32_t color) {
+    if (y < clip_y0 || y >= clip_y1) return;
+    if (x < clip_x0) {
+        count -= clip_x0 - x;
+        x = clip_x0;
+    }
+    if (x + count > clip_x1) count = clip_x1 - x;
+    if (count <= 0) return;
+    
+    uint32_t pixel = pixel_pack(color);
+    uint8_t* p = framebuffer_address(x, y);
+    mark_dirty_span(x, y, count);
+    
+    switch (framebuffer_format.bytes_per_pixel) {
+        case 4:
+            blit_fill32((uint32_t*)p, pixel, count);
+            break;
+        case 3: {
+            uint8_t b0 = pixel, b1 = pixel >> 8, b2 = pixel >> 16;
+            for (int i = 0; i < count; i++, p += 3) {
+                p[0] = b0;
+                p[1] = b1;
+                p[2] = b2;
+            }
+            break;
+        }
+        default: {
+            uint16_t* dst = (uint16_t*)p;
+            for (int i = 0; i < count; i++) dst[i] = pixel;
+            break;
+        }
+    }
+}
+
+// Clips a copy so that both source and destination stay on screen
+static int clip_copy(int* src, int* dst, int* length, int limit) {
+    if (*src < 0) {
+        *length += *src;
+        *dst -= *src;
+        *src = 0;
+    }
+    if (*dst < 0) {
+        *length += *dst;
+        *src -= *dst;
+        *dst = 0;
+    }
+    if (*src + *length > limit) *length = limit - *src;
+    if (*dst + *length > limit) *length = limit - *dst;
+    return *length > 0;
+}
+
 void framebuffer_copy_rect(int src_x, int src_y, int dst_x, int dst_y, int width, int height) {
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            uint32_t pixel = framebuffer_get_pixel(src_x + x, src_y + y);
-            framebuffer_put_pixel(dst_x + x, dst_y + y, pixel);
+    if (!framebuffer) return;
+    if (!clip_copy(&src_x, &dst_x, &width, framebuffer_width)) return;
+    if (!clip_copy(&src_y, &dst_y, &height, framebuffer_height)) return;
+    
+    unsigned int row_bytes = width * framebuffer_format.bytes_per_pixel;
+    
+    // Overlapping regions: walk in the direction that does not clobber the source
+    int step = (dst_y > src_y) ? -1 : 1;
+    int first = (step < 0) ? height - 1 : 0;
+    
+    for (int i = 0, row = first; i < height; i++, row += step) {
+        uint8_t* src = framebuffer_address(src_x, src_y + row);
+        uint8_t* dst = framebuffer_address(dst_x, dst_y + row);
+        mark_dirty_span(dst_x, dst_y + row, width);
+        
+        blit_copy(dst, src, row_bytes);
+    }
+}
+
+void framebuffer_set_clip(const rect_t* clip) {
+    rect_t screen = {0, 0, framebuffer_width, framebuffer_height};
+    rect_t r;
+    
+    if (!rect_intersect(clip, &screen, &r)) {
+        r.x = r.y = r.width = r.height = 0;
+    }
+    clip_x0 = r.x;
+    clip_y0 = r.y;
+    clip_x1 = r.x + r.width;
+    clip_y1 = r.y + r.height;
+}
+
+void framebuffer_reset_clip(void) {
+    clip_x0 = 0;
+    clip_y0 = 0;
+    clip_x1 = framebuffer_width;
+    clip_y1 = framebuffer_height;
+}
+
+void framebuffer_get_clip(rect_t* clip) {
+    clip->x = clip_x0;
+    clip->y = clip_y0;
+    clip->width = clip_x1 - clip_x0;
+    clip->height = clip_y1 - clip_y0;
+}
+
+int framebuffer_has_back_buffer(void) {
+    return back_buffer_active;
+}
+
+void framebuffer_mark_dirty(int x, int y, int width, int height) {
+    if (x < 0) {
+        width += x;
+        x = 0;
+    }
+    if (y < 0) {
+        height += y;
+        y = 0;
+    }
+    if (x + width > framebuffer_width) width = framebuffer_width - x;
+    if (y + height > framebuffer_height) height = framebuffer_height - y;
+    if (width <= 0 || height <= 0) return;
+    
+    for (int row = y; row < y + height; row++) {
+        mark_dirty_span(x, row, width);
+    }
+}
+
+void framebuffer_mark_all_dirty(void) {
+    if (back_buffer_active) damage_fill(damage);
+}
+
+static void mouse_cursor_build(void) {
+    for (int y = 0; y < CURSOR_HEIGHT; y++) {
+        for (int x = 0; x < CURSOR_WIDTH; x++) {
+            char c = mouse_cursor_shape[y][x];
+            mouse_cursor_image[y][x] = (c == 'X') ? COLOR_BLACK : (c == '.') ? COLOR_WHITE : 0;
         }
     }
+    mouse_cursor_ready = 1;
+}
+
+static void mark_cursor_dirty(int x, int y) {
+    int x0 = (x < 0) ? 0 : x;
+    int x1 = (x + CURSOR_WIDTH > framebuffer_width) ? framebuffer_width : x + CURSOR_WIDTH;
+    if (x0 >= x1) return;
+    
+    for (int row = y; row < y + CURSOR_HEIGHT; row++) {
+        if (row >= 0 && row < framebuffer_height) mark_dirty_span(x0, row, x1 - x0);
+    }
+}
+
+// Blends the cursor onto the presented frame; partly transparent pixels
+// are blended with the back buffer, so video memory is never read
+static void present_cursor(uint8_t* target) {
+    int bpp = framebuffer_format.bytes_per_pixel;
+    
+    for (int dy = 0; dy < CURSOR_HEIGHT; dy++) {
+        int y = cursor_plane_y + dy;
+        if (y < 0 || y >= framebuffer_height) continue;
+        
+        for (int dx = 0; dx < CURSOR_WIDTH; dx++) {
+            int x = cursor_plane_x + dx;
+            uint32_t color = mouse_cursor_image[dy][dx];
+            uint32_t alpha = color >> 24;
+            if (alpha == 0 || x < 0 || x >= framebuffer_width) continue;
+            
+            unsigned int offset = y * framebuffer_pitch + x * bpp;
+            if (alpha != 0xFF) color = blit_blend_argb(color, pixel_unpack(load_pixel(back_buffer + offset)));
+            store_pixel(target + offset, pixel_pack(color));
+        }
+    }
+}
+
+int framebuffer_set_cursor(int x, int y, int visible) {
+    if (!mouse_cursor_ready) mouse_cursor_build();
+    if (!back_buffer_active) return 0;
+    
+    if (x == cursor_plane_x && y == cursor_plane_y && visible == cursor_plane_visible) return 1;
+    
+    // The back buffer holds what was under the old position: presenting the
+    // area again is the restore
+    if (cursor_plane_visible) mark_cursor_dirty(cursor_plane_x, cursor_plane_y);
+    cursor_plane_x = x;
+    cursor_plane_y = y;
+    cursor_plane_visible = visible;
+    return 1;
+}
+
+void framebuffer_present(uint8_t* target, int include_previous) {
+    if (!back_buffer_active || !target) return;
+    
+    // Copy the cursor area too, so the cursor is blended over clean pixels
+    if (cursor_plane_visible) mark_cursor_dirty(cursor_plane_x, cursor_plane_y);
+    
+    int y0 = damage->y0;
+    int y1 = damage->y1;
+    if (include_previous) {
+        if (damage_prev->y0 < y0) y0 = damage_prev->y0;
+        if (damage_prev->y1 > y1) y1 = damage_prev->y1;
+    }
+    
+    int bpp = framebuffer_format.bytes_per_pixel;
+    compose_stats.presented_pixels = 0;
+    for (int y = y0; y < y1; y++) {
+        int x0 = damage->x0[y];
+        int x1 = damage->x1[y];
+        if (include_previous) {
+            if (damage_prev->x0[y] < x0) x0 = damage_prev->x0[y];
+            if (damage_prev->x1[y] > x1) x1 = damage_prev->x1[y];
+        }
+        if (x0 >= x1) continue;
+        
+        compose_stats.presented_pixels += x1 - x0;
+        unsigned int offset = y * framebuffer_pitch + x0 * bpp;
+        // Video memory is uncached: whole dwords with rep movsd
+        blit_copy(target + offset, back_buffer + offset, (x1 - x0) * bpp);
+    }
+    if (cursor_plane_visible) present_cursor(target);
+    
+    // This frame's damage becomes the previous one
+    damage_rows_t* done = damage_prev;
+    damage_prev = damage;
+    damage = done;
+    damage_reset(damage);
 }
 
 void framebuffer_blend_pixel(int x, int y, uint32_t color) {
     if (x >= 0 && x < framebuffer_width && y >= 0 && y < framebuffer_height) {
-        uint32_t dst = framebuffer_get_pixel(x, y);
-        
         // Extract alpha from source
         uint8_t src_alpha = (color >> 24) & 0xFF;
         
@@ -158,23 +596,50 @@ void framebuffer_blend_pixel(int x, int y, uint32_t color) {
             // Opaque - just copy
             framebuffer_put_pixel(x, y, color);
         } else if (src_alpha > 0) {
-            // Alpha blending
-            uint8_t dst_alpha = 0xFF - src_alpha;
-            
-            uint8_t src_r = (color >> 16) & 0xFF;
-            uint8_t src_g = (color >> 8) & 0xFF;
-            uint8_t src_b = color & 0xFF;
-            
-            uint8_t dst_r = (dst >> 16) & 0xFF;
-            uint8_t dst_g = (dst >> 8) & 0xFF;
-            uint8_t dst_b = dst & 0xFF;
-            
-            uint8_t final_r = (src_r * src_alpha + dst_r * dst_alpha) / 255;
-            uint8_t final_g = (src_g * src_alpha + dst_g * dst_alpha) / 255;
-            uint8_t final_b = (src_b * src_alpha + dst_b * dst_alpha) / 255;
-            
-            uint32_t final_color = 0xFF000000 | (final_r << 16) | (final_g << 8) | final_b;
-            framebuffer_put_pixel(x, y, final_color);
+            framebuffer_put_pixel(x, y, blit_blend_argb(color, framebuffer_get_pixel(x, y)));
+        }
+    }
+}
+
+// Copies or blends a row of ARGB pixels; clipping is done once for the whole span
+void framebuffer_draw_span(int x, int y, const uint32_t* pixels, int count, int op) {
+    if (y < clip_y0 || y >= clip_y1) return;
+    if (x < clip_x0) {
+        pixels += clip_x0 - x;
+        count -= clip_x0 - x;
+        x = clip_x0;
+    }
+    if (x + count > clip_x1) count = clip_x1 - x;
+    if (count <= 0) return;
+    
+    mark_dirty_span(x, y, count);
+    
+    if (framebuffer_format.kind == PIXEL_FORMAT_XRGB8888) {
+        uint32_t* dst = (uint32_t*)framebuffer_address(x, y);
+        switch (op) {
+            case SPAN_COPY:
+                blit_copy(dst, pixels, count * 4);
+                break;
+            case SPAN_BLEND:
+                blit_blend32(dst, pixels, count);
+                break;
+            default:
+                blit_blend32_premultiplied(dst, pixels, count);
+                break;
+        }
+        return;
+    }
+    
+    uint8_t* p = framebuffer_address(x, y);
+    for (int i = 0; i < count; i++, p += framebuffer_format.bytes_per_pixel) {
+        uint32_t color = pixels[i];
+        uint32_t alpha = color >> 24;
+        if (op == SPAN_COPY || alpha == 0xFF) {
+            store_pixel(p, pixel_pack(color));
+        } else if (op == SPAN_BLEND && alpha) {
+            store_pixel(p, pixel_pack(blit_blend_argb(color, pixel_unpack(load_pixel(p)))));
+        } else if (op == SPAN_BLEND_PREMULTIPLIED && color) {
+            store_pixel(p, pixel_pack(blit_blend_premultiplied(color, pixel_unpack(load_pixel(p)))));
         }
     }
 }
@@ -210,10 +675,8 @@ void draw_line(int x1, int y1, int x2, int y2, uint32_t color) {
 
 void draw_rect(int x, int y, int width, int height, uint32_t color) {
     // Top and bottom lines
-    for (int i = x; i < x + width; i++) {
-        draw_pixel(i, y, color);
-        draw_pixel(i, y + height - 1, color);
-    }
+    framebuffer_fill_span(x, y, width, color);
+    framebuffer_fill_span(x, y + height - 1, width, color);
     
     // Left and right lines
     for (int i = y; i < y + height; i++) {
@@ -223,10 +686,12 @@ void draw_rect(int x, int y, int width, int height, uint32_t color) {
 }
 
 void fill_rect(int x, int y, int width, int height, uint32_t color) {
-    for (int dy = y; dy < y + height; dy++) {
-        for (int dx = x; dx < x + width; dx++) {
-            draw_pixel(dx, dy, color);
-        }
+    int y_end = y + height;
+    if (y < clip_y0) y = clip_y0;
+    if (y_end > clip_y1) y_end = clip_y1;
+    
+    for (int dy = y; dy < y_end; dy++) {
+        framebuffer_fill_span(x, dy, width, color);
     }
 }
 
@@ -272,57 +737,25 @@ void draw_triangle(int x1, int y1, int x2, int y2, int x3, int y3, uint32_t colo
     draw_line(x3, y3, x1, y1, color);
 }
 
+static void fill_triangle_span(int y, int x0, int x1, void* context) {
+    framebuffer_fill_span(x0, y, x1 - x0, *(const uint32_t*)context);
+}
+
+// Vertices are pixel centers; edges follow the top-left fill rule
 void fill_triangle(int x1, int y1, int x2, int y2, int x3, int y3, uint32_t color) {
-    // Simple scanline fill algorithm
-    int min_y = (y1 < y2) ? ((y1 < y3) ? y1 : y3) : ((y2 < y3) ? y2 : y3);
-    int max_y = (y1 > y2) ? ((y1 > y3) ? y1 : y3) : ((y2 > y3) ? y2 : y3);
+    raster_point_t a = raster_pixel(x1, y1);
+    raster_point_t b = raster_pixel(x2, y2);
+    raster_point_t c = raster_pixel(x3, y3);
+    rect_t clip;
     
-    for (int y = min_y; y <= max_y; y++) {
-        int x_start = framebuffer_width;
-        int x_end = 0;
-        
-        // Find intersections with triangle edges
-        // Edge 1-2
-        if ((y >= y1 && y <= y2) || (y >= y2 && y <= y1)) {
-            if (y2 != y1) {
-                int x = x1 + (x2 - x1) * (y - y1) / (y2 - y1);
-                if (x < x_start) x_start = x;
-                if (x > x_end) x_end = x;
-            }
-        }
-        // Edge 2-3
-        if ((y >= y2 && y <= y3) || (y >= y3 && y <= y2)) {
-            if (y3 != y2) {
-                int x = x2 + (x3 - x2) * (y - y2) / (y3 - y2);
-                if (x < x_start) x_start = x;
-                if (x > x_end) x_end = x;
-            }
-        }
-        // Edge 3-1
-        if ((y >= y3 && y <= y1) || (y >= y1 && y <= y3)) {
-            if (y1 != y3) {
-                int x = x3 + (x1 - x3) * (y - y3) / (y1 - y3);
-                if (x < x_start) x_start = x;
-                if (x > x_end) x_end = x;
-            }
-        }
-        
-        // Draw scanline
-        for (int x = x_start; x <= x_end; x++) {
-            draw_pixel(x, y, color);
-        }
-    }
+    framebuffer_get_clip(&clip);
+    raster_triangle(&a, &b, &c, &clip, fill_triangle_span, &color);
 }
 
 // ==================== TEXT RENDERING ====================
 
 void draw_string(int x, int y, const char *str, uint32_t color) {
-    int pos_x = x;
-    while (*str) {
-        draw_char(pos_x, y, *str, color);
-        pos_x += 8;
-        str++;
-    }
+    glyph_draw_string(x, y, str, color);
 }
 
 int get_text_width(const char *str) {
@@ -339,8 +772,257 @@ int get_char_height(void) {
 
 // ==================== WINDOW MANAGER ====================
 
+// Kept sorted by z-order (bottom first); re-sorted only when z-order changes
 static window_t* window_list[MAX_WINDOWS];
 
+// Screen area damaged since the last compose
+static region_t damage_region;
+
+// Visible regions are stale after any change of geometry, z-order or visibility
+static region_t background_visible;
+static int visibility_dirty = 1;
+
+// Insertion sort: the list is almost always sorted already
+static void window_list_sort(void) {
+    for (int i = 1; i < window_count; i++) {
+        window_t* window = window_list[i];
+        int j = i - 1;
+        while (j >= 0 && window_list[j]->z_order > window->z_order) {
+            window_list[j + 1] = window_list[j];
+            j--;
+        }
+        window_list[j + 1] = window;
+    }
+    visibility_dirty = 1;
+}
+
+// Screen area covered by the window, including the decoration shadow
+static void window_bounds(window_t* window, rect_t* r) {
+    int shadow = (window->flags & WINDOW_FLAG_DECORATED) ? 3 : 0;
+    r->x = window->x;
+    r->y = window->y;
+    r->width = window->width + shadow;
+    r->height = window->height + shadow;
+}
+
+// Decorated and XRGB windows paint their whole rectangle (the shadow is not counted)
+static int window_is_opaque(window_t* window) {
+    return (window->flags & WINDOW_FLAG_VISIBLE) &&
+           ((window->flags & WINDOW_FLAG_DECORATED) ||
+            (window->format == WINDOW_FORMAT_XRGB && window->buffer));
+}
+
+static void window_runs_invalidate(window_t* window, int first_row, int rows) {
+    if (!window->runs) return;
+    for (int y = first_row; y < first_row + rows; y++) {
+        window->runs[y].count = 0;
+    }
+}
+
+static int pixel_run_kind(window_t* window, uint32_t pixel) {
+    switch (window->format) {
+        case WINDOW_FORMAT_COLOR_KEY:
+            return (pixel == window->color_key) ? WINDOW_RUN_SKIP : WINDOW_RUN_COPY;
+        case WINDOW_FORMAT_PREMULTIPLIED:
+            // Premultiplied pixels with zero alpha but some color still add light
+            if (pixel == 0) return WINDOW_RUN_SKIP;
+            break;
+        default:
+            if ((pixel >> 24) == 0) return WINDOW_RUN_SKIP;
+            break;
+    }
+    return ((pixel >> 24) == 0xFF) ? WINDOW_RUN_COPY : WINDOW_RUN_BLEND;
+}
+
+// Splits a buffer row into skip/copy/blend runs; when the runs do not fit,
+// the rest of the row becomes one blend (or per-pixel keyed) run
+static const window_row_runs_t* window_row_runs(window_t* window, int row) {
+    window_row_runs_t* runs = &window->runs[row];
+    if (runs->count) return runs;
+    
+    const uint32_t* pixels = window->buffer + row * window->stride;
+    int n = 0;
+    int x = 0;
+    
+    while (x < window->width) {
+        int kind = pixel_run_kind(window, pixels[x]);
+        int end = x + 1;
+        while (end < window->width && pixel_run_kind(window, pixels[end]) == kind) end++;
+        
+        if (n == WINDOW_ROW_RUNS - 1 && end < window->width) {
+            kind = (window->format == WINDOW_FORMAT_COLOR_KEY) ? WINDOW_RUN_KEYED : WINDOW_RUN_BLEND;
+            end = window->width;
+        }
+        runs->kind[n] = kind;
+        runs->end[n] = end;
+        n++;
+        x = end;
+    }
+    
+    runs->count = n;
+    return runs;
+}
+
+// Draws buffer columns [x0, x1) of one row at screen row y
+static void window_draw_row(window_t* window, int row, int x0, int x1, int y) {
+    const uint32_t* pixels = window->buffer + row * window->stride;
+    int blend_op = (window->format == WINDOW_FORMAT_PREMULTIPLIED) ? SPAN_BLEND_PREMULTIPLIED : SPAN_BLEND;
+    
+    if (window->format == WINDOW_FORMAT_XRGB) {
+        framebuffer_draw_span(window->x + x0, y, pixels + x0, x1 - x0, SPAN_COPY);
+        return;
+    }
+    
+    if (!window->runs) {
+        // No index: blending handles every kind of pixel except color keys
+        if (window->format != WINDOW_FORMAT_COLOR_KEY) {
+            framebuffer_draw_span(window->x + x0, y, pixels + x0, x1 - x0, blend_op);
+            return;
+        }
+        for (int x = x0; x < x1; x++) {
+            if (pixels[x] != window->color_key) framebuffer_put_pixel(window->x + x, y, pixels[x]);
+        }
+        return;
+    }
+    
+    const window_row_runs_t* runs = window_row_runs(window, row);
+    int start = 0;
+    for (int i = 0; i < runs->count && start < x1; start = runs->end[i], i++) {
+        int a = (start > x0) ? start : x0;
+        int b = (runs->end[i] < x1) ? runs->end[i] : x1;
+        if (a >= b) continue;
+        
+        switch (runs->kind[i]) {
+            case WINDOW_RUN_COPY:
+                framebuffer_draw_span(window->x + a, y, pixels + a, b - a, SPAN_COPY);
+                break;
+            case WINDOW_RUN_BLEND:
+                framebuffer_draw_span(window->x + a, y, pixels + a, b - a, blend_op);
+                break;
+            case WINDOW_RUN_KEYED:
+                for (int x = a; x < b; x++) {
+                    if (pixels[x] != window->color_key) framebuffer_put_pixel(window->x + x, y, pixels[x]);
+                }
+                break;
+        }
+    }
+}
+
+// Clips every window against the opaque windows above it, top to bottom
+static void update_visibility(void) {
+    if (!visibility_dirty) return;
+    
+    // Occluders are kept as exact rectangles: merging them could hide too much
+    rect_t screen = {0, 0, framebuffer_width, framebuffer_height};
+    rect_t covered[MAX_WINDOWS];
+    int covered_count = 0;
+    
+    for (int i = window_count - 1; i >= 0; i--) {
+        window_t* window = window_list[i];
+        rect_t r;
+        
+        region_clear(&window->visible);
+        if (!(window->flags & WINDOW_FLAG_VISIBLE)) continue;
+        
+        window_bounds(window, &r);
+        if (!rect_intersect(&r, &screen, &r)) continue;
+        region_add(&window->visible, r.x, r.y, r.width, r.height);
+        for (int c = 0; c < covered_count && !region_is_empty(&window->visible); c++) {
+            region_subtract(&window->visible, &covered[c]);
+        }
+        
+        if (window_is_opaque(window)) {
+            covered[covered_count++] = (rect_t){window->x, window->y, window->width, window->height};
+        }
+    }
+    
+    region_clear(&background_visible);
+    region_add(&background_visible, screen.x, screen.y, screen.width, screen.height);
+    for (int c = 0; c < covered_count; c++) {
+        region_subtract(&background_visible, &covered[c]);
+    }
+    
+    visibility_dirty = 0;
+}
+
+// ==================== WINDOW SURFACES ====================
+
+// Rows are padded to 16 bytes so row kernels see aligned starts
+static inline int surface_stride(int width) {
+    return (width + 3) & ~3;
+}
+
+// Pixels followed by the row-run index
+static uint32_t surface_bytes(int width, int height) {
+    return surface_stride(width) * height * 4 + height * sizeof(window_row_runs_t);
+}
+
+uint32_t* window_get_buffer(window_t* window) {
+    if (!window) return 0;
+    if (window->buffer) return window->buffer;
+    
+    uint32_t pages = pages_for_bytes(surface_bytes(window->width, window->height));
+    uint32_t* pixels = (uint32_t*)page_alloc(pages);
+    if (!pixels) return 0;
+    
+    window->buffer = pixels;
+    window->surface_pages = pages;
+    window->stride = surface_stride(window->width);
+    window->runs = (window_row_runs_t*)(pixels + window->stride * window->height);
+    blit_fill32(pixels, COLOR_TRANSPARENT, window->stride * window->height);
+    window_runs_invalidate(window, 0, window->height);
+    
+    // An XRGB window starts occluding once it has pixels
+    visibility_dirty = 1;
+    return pixels;
+}
+
+// Reflows the pixels for a new size. The surface is reused in place when its
+// pages are big enough (always when shrinking); new areas are transparent
+static int surface_resize(window_t* window, int width, int height) {
+    int stride = surface_stride(width);
+    uint32_t pages = pages_for_bytes(surface_bytes(width, height));
+    int copy_width = (width < window->width) ? width : window->width;
+    int copy_height = (height < window->height) ? height : window->height;
+    uint32_t* old = window->buffer;
+    uint32_t* pixels = old;
+    
+    if (pages > window->surface_pages) {
+        pixels = (uint32_t*)page_alloc(pages);
+        if (!pixels) return 0;
+    }
+    
+    // In place, a narrower stride moves rows down in memory: walk forward.
+    // A wider one moves them up: walk backward
+    if (pixels != old || stride <= window->stride) {
+        for (int y = 0; y < copy_height; y++) {
+            blit_copy(pixels + y * stride, old + y * window->stride, copy_width * 4);
+        }
+    } else {
+        for (int y = copy_height - 1; y >= 0; y--) {
+            blit_copy(pixels + y * stride, old + y * window->stride, copy_width * 4);
+        }
+    }
+    
+    if (width > copy_width) {
+        for (int y = 0; y < copy_height; y++) {
+            blit_fill32(pixels + y * stride + copy_width, COLOR_TRANSPARENT, width - copy_width);
+        }
+    }
+    if (height > copy_height) {
+        blit_fill32(pixels + copy_height * stride, COLOR_TRANSPARENT, (height - copy_height) * stride);
+    }
+    
+    if (pixels != old) {
+        page_free(old, window->surface_pages);
+        window->surface_pages = pages;
+    }
+    window->buffer = pixels;
+    window->stride = stride;
+    window->runs = (window_row_runs_t*)(pixels + stride * height);
+    return 1;
+}
+
 window_t* create_window(int x, int y, int width, int height, const char* title, uint32_t flags) {
     if (window_count >= MAX_WINDOWS) return 0;
     
@@ -359,31 +1041,32 @@ window_t* create_window(int x, int y, int width, int height, const char* title,
     }
     window->title[i] = '\0';
     
-    // Allocate window buffer
-    window->buffer = (uint32_t*)malloc(width * height * sizeof(uint32_t));
-    if (!window->buffer) {
-        free(window);
-        return 0;
-    }
-    
-    // Clear window buffer
-    for (int i = 0; i < width * height; i++) {
-        window->buffer[i] = COLOR_TRANSPARENT;
-    }
+    // The surface is allocated on first draw (window_get_buffer)
+    window->buffer = 0;
+    window->stride = surface_stride(width);
+    window->surface_pages = 0;
+    window->runs = 0;
     
     window->z_order = window_count;
     window->parent = 0;
     window->on_paint = 0;
     window->on_click = 0;
     window->on_key = 0;
+    window->format = WINDOW_FORMAT_ARGB;
+    window->color_key = 0;
+    region_clear(&window->visible);
     
     window_list[window_count++] = window;
+    window_list_sort();
+    window_invalidate(window);
     return window;
 }
 
 void destroy_window(window_t* window) {
     if (!window) return;
     
+    window_invalidate(window);
+    
     // Remove from window list
     for (int i = 0; i < window_count; i++) {
         if (window_list[i] == window) {
@@ -395,9 +1078,14 @@ void destroy_window(window_t* window) {
             break;
         }
     }
+    visibility_dirty = 1;
+    
+    if (global_desktop && global_desktop->active_window == window) {
+        global_desktop->active_window = 0;
+    }
     
     if (window->buffer) {
-        free(window->buffer);
+        page_free(window->buffer, window->surface_pages);
     }
     free(window);
 }
@@ -405,74 +1093,52 @@ void destroy_window(window_t* window) {
 void show_window(window_t* window) {
     if (window) {
         window->flags |= WINDOW_FLAG_VISIBLE;
+        visibility_dirty = 1;
         window_paint(window);
     }
 }
 
 void hide_window(window_t* window) {
     if (window) {
+        // Invalidate while still visible, then uncover what was below
+        window_invalidate(window);
         window->flags &= ~WINDOW_FLAG_VISIBLE;
-        // Redraw desktop to remove window
-        if (global_desktop) {
-            desktop_paint(global_desktop);
-        }
+        visibility_dirty = 1;
+        frame_request();
     }
 }
 
 void move_window(window_t* window, int x, int y) {
-    if (!window) return;
-    
-    // Save old position
-    int old_x = window->x;
-    int old_y = window->y;
+    if (!window || (window->x == x && window->y == y)) return;
     
-    // Update position
+    // Damage both the uncovered and the newly covered area
+    window_invalidate(window);
     window->x = x;
     window->y = y;
-    
-    // Redraw affected area
-    if (global_desktop) {
-        desktop_paint(global_desktop);
-    }
+    visibility_dirty = 1;
+    window_invalidate(window);
 }
 
 void resize_window(window_t* window, int width, int height) {
     if (!window || width <= 0 || height <= 0) return;
+    if (window->buffer && !surface_resize(window, width, height)) return;
     
-    // Allocate new buffer
-    uint32_t* new_buffer = (uint32_t*)malloc(width * height * sizeof(uint32_t));
-    if (!new_buffer) return;
-    
-    // Clear new buffer
-    for (int i = 0; i < width * height; i++) {
-        new_buffer[i] = COLOR_TRANSPARENT;
-    }
-    
-    // Copy old content (clipped)
-    int copy_width = (width < window->width) ? width : window->width;
-    int copy_height = (height < window->height) ? height : window->height;
-    
-    for (int y = 0; y < copy_height; y++) {
-        for (int x = 0; x < copy_width; x++) {
-            new_buffer[y * width + x] = window->buffer[y * window->width + x];
-        }
-    }
-    
-    // Free old buffer and update
-    free(window->buffer);
-    window->buffer = new_buffer;
+    window_invalidate(window);
     window->width = width;
     window->height = height;
+    if (!window->buffer) window->stride = surface_stride(width);
+    window_runs_invalidate(window, 0, height);
+    visibility_dirty = 1;
     
-    // Redraw
-    if (global_desktop) {
-        desktop_paint(global_desktop);
-    }
+    window_invalidate(window);
 }
 
 void raise_window(window_t* window) {
     if (!window) return;
     
+    // Already on top: nothing changes on screen
+    if (window_count > 0 && window_list[window_count - 1] == window) return;
+    
     // Find highest z-order
     int max_z = 0;
     for (int i = 0; i < window_count; i++) {
@@ -482,45 +1148,36 @@ void raise_window(window_t* window) {
     }
     
     window->z_order = max_z + 1;
-    
-    // Redraw to reflect new order
-    if (global_desktop) {
-        desktop_paint(global_desktop);
-    }
+    window_list_sort();
+    window_invalidate(window);
 }
 
 void lower_window(window_t* window) {
     if (!window) return;
     
     window->z_order = 0;
+    window_list_sort();
     
-    // Redraw to reflect new order
-    if (global_desktop) {
-        desktop_paint(global_desktop);
-    }
+    // Windows that were below it show through now
+    window_invalidate(window);
 }
 
 window_t* get_window_at_point(int x, int y) {
-    window_t* found = 0;
-    int highest_z = -1;
-    
-    for (int i = 0; i < window_count; i++) {
+    // Topmost first; the desktop window (negative z-order) is not hit
+    for (int i = window_count - 1; i >= 0; i--) {
         window_t* win = window_list[i];
-        if ((win->flags & WINDOW_FLAG_VISIBLE) && 
+        if ((win->flags & WINDOW_FLAG_VISIBLE) && win->z_order >= 0 &&
             x >= win->x && x < win->x + win->width &&
-            y >= win->y && y < win->y + win->height &&
-            win->z_order > highest_z) {
-            found = win;
-            highest_z = win->z_order;
+            y >= win->y && y < win->y + win->height) {
+            return win;
         }
     }
     
-    return found;
+    return 0;
 }
 
-void window_paint(window_t* window) {
-    if (!window || !(window->flags & WINDOW_FLAG_VISIBLE)) return;
-    
+// Draws the part of the window inside the current clip rectangle
+static void window_draw(window_t* window, const rect_t* clip) {
     // Draw window decorations if decorated
     if (window->flags & WINDOW_FLAG_DECORATED) {
         // Draw shadow
@@ -541,13 +1198,12 @@ void window_paint(window_t* window) {
         draw_rect(window->x, window->y, window->width, window->height, COLOR_BLACK);
     }
     
-    // Copy window buffer to screen
-    for (int y = 0; y < window->height; y++) {
-        for (int x = 0; x < window->width; x++) {
-            uint32_t pixel = window->buffer[y * window->width + x];
-            if (pixel != COLOR_TRANSPARENT) {
-                framebuffer_blend_pixel(window->x + x, window->y + y, pixel);
-            }
+    // Copy or blend the clipped part of the window buffer row by row
+    rect_t area = {window->x, window->y, window->width, window->height};
+    rect_t r;
+    if (window->buffer && rect_intersect(&area, clip, &r)) {
+        for (int y = r.y; y < r.y + r.height; y++) {
+            window_draw_row(window, y - window->y, r.x - window->x, r.x + r.width - window->x, y);
         }
     }
     
@@ -557,6 +1213,59 @@ void window_paint(window_t* window) {
     }
 }
 
+void window_invalidate(window_t* window) {
+    if (!window || !(window->flags & WINDOW_FLAG_VISIBLE)) return;
+    
+    rect_t r;
+    window_bounds(window, &r);
+    desktop_invalidate(r.x, r.y, r.width, r.height);
+}
+
+void window_damage(window_t* window, int x, int y, int width, int height) {
+    if (!window) return;
+    
+    rect_t area = {0, 0, window->width, window->height};
+    rect_t changed = {x, y, width, height};
+    rect_t r;
+    if (!rect_intersect(&changed, &area, &r)) return;
+    
+    window_runs_invalidate(window, r.y, r.height);
+    if (!(window->flags & WINDOW_FLAG_VISIBLE)) return;
+    
+    desktop_invalidate(window->x + r.x, window->y + r.y, r.width, r.height);
+}
+
+void window_update(window_t* window, int x, int y, int width, int height) {
+    if (!window) return;
+    
+    window_damage(window, x, y, width, height);
+    frame_request();
+}
+
+void window_set_format(window_t* window, int format, uint32_t color_key) {
+    if (!window) return;
+    
+    window->format = format;
+    window->color_key = color_key;
+    window_runs_invalidate(window, 0, window->height);
+    visibility_dirty = 1;  // Opacity may have changed
+    window_invalidate(window);
+}
+
+void window_paint(window_t* window) {
+    if (!window || !(window->flags & WINDOW_FLAG_VISIBLE)) return;
+    
+    // The caller may have changed any part of the buffer
+    window_runs_invalidate(window, 0, window->height);
+    window_invalidate(window);
+    if (global_desktop) {
+        frame_request();
+    } else {
+        rect_t screen = {0, 0, framebuffer_width, framebuffer_height};
+        window_draw(window, &screen);
+    }
+}
+
 // ==================== DESKTOP MANAGER ====================
 
 desktop_t* create_desktop(void) {
@@ -565,46 +1274,103 @@ desktop_t* create_desktop(void) {
     
     desktop->window_count = 0;
     desktop->active_window = 0;
-    desktop->mouse_x = SCREEN_WIDTH / 2;
-    desktop->mouse_y = SCREEN_HEIGHT / 2;
+    desktop->mouse_x = framebuffer_width / 2;
+    desktop->mouse_y = framebuffer_height / 2;
     desktop->mouse_buttons = 0;
     desktop->desktop_color = 0xFF008080; // Teal background
     
     // Create desktop window
-    desktop->desktop_window = create_window(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, "Desktop", 0);
+    desktop->desktop_window = create_window(0, 0, framebuffer_width, framebuffer_height, "Desktop", 0);
     if (desktop->desktop_window) {
         desktop->desktop_window->z_order = -1; // Always at bottom
-        fill_rect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, desktop->desktop_color);
+        window_list_sort();
     }
     
     global_desktop = desktop;
+    desktop_invalidate(0, 0, framebuffer_width, framebuffer_height);
     return desktop;
 }
 
-void desktop_paint(desktop_t* desktop) {
-    if (!desktop) return;
+void desktop_invalidate(int x, int y, int width, int height) {
+    rect_t screen = {0, 0, framebuffer_width, framebuffer_height};
+    rect_t area = {x, y, width, height};
+    rect_t r;
     
-    // Clear desktop
-    fill_rect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, desktop->desktop_color);
+    if (rect_intersect(&area, &screen, &r)) {
+        region_add(&damage_region, r.x, r.y, r.width, r.height);
+    }
+}
+
+// Repaints only the damaged rectangles, then presents them. Each window
+// is painted only where it is both damaged and not covered by opaque
+// windows above, so hidden windows cost nothing
+void desktop_compose(desktop_t* desktop) {
+    if (!desktop || region_is_empty(&damage_region)) return;
+    
+    compose_stats.damage_rects = damage_region.count;
+    compose_stats.damage_pixels = region_area(&damage_region);
+    update_visibility();
+    rect_t cursor = {desktop->mouse_x, desktop->mouse_y, CURSOR_WIDTH, CURSOR_HEIGHT};
+    // Only without a cursor plane does the cursor go into the frame
+    int cursor_in_frame = !framebuffer_set_cursor(desktop->mouse_x, desktop->mouse_y, 1);
     
-    // Sort windows by z-order
-    for (int i = 0; i < window_count - 1; i++) {
-        for (int j = i + 1; j < window_count; j++) {
-            if (window_list[i]->z_order > window_list[j]->z_order) {
-                window_t* temp = window_list[i];
-                window_list[i] = window_list[j];
-                window_list[j] = temp;
+    for (int i = 0; i < damage_region.count; i++) {
+        const rect_t* damaged = &damage_region.rects[i];
+        rect_t r;
+        
+        for (int v = 0; v < background_visible.count; v++) {
+            if (rect_intersect(&background_visible.rects[v], damaged, &r)) {
+                framebuffer_set_clip(&r);
+                fill_rect(r.x, r.y, r.width, r.height, desktop->desktop_color);
             }
         }
+        
+        // Bottom to top
+        for (int w = 0; w < window_count; w++) {
+            window_t* window = window_list[w];
+            for (int v = 0; v < window->visible.count; v++) {
+                if (rect_intersect(&window->visible.rects[v], damaged, &r)) {
+                    framebuffer_set_clip(&r);
+                    window_draw(window, &r);
+                }
+            }
+        }
+        
+        if (desktop_overlay) {
+            framebuffer_set_clip(damaged);
+            desktop_overlay();
+        }
+        
+        if (cursor_in_frame && rect_intersect(&cursor, damaged, &r)) {
+            framebuffer_set_clip(&r);
+            draw_mouse_cursor(desktop->mouse_x, desktop->mouse_y);
+        }
     }
     
-    // Paint all visible windows in z-order
-    for (int i = 0; i < window_count; i++) {
-        window_paint(window_list[i]);
-    }
+    framebuffer_reset_clip();
+    region_clear(&damage_region);
+    gpu_swap_buffers();
+}
+
+int desktop_has_damage(void) {
+    return !region_is_empty(&damage_region);
+}
+
+const compose_stats_t* desktop_compose_stats(void) {
+    return &compose_stats;
+}
+
+void desktop_set_overlay(void (*draw)(void)) {
+    desktop_overlay = draw;
+}
+
+void desktop_paint(desktop_t* desktop) {
+    if (!desktop) return;
     
-    // Draw mouse cursor
-    draw_mouse_cursor(desktop->mouse_x, desktop->mouse_y);
+    // Also picks up a new screen size after a mode change
+    visibility_dirty = 1;
+    desktop_invalidate(0, 0, framebuffer_width, framebuffer_height);
+    frame_request();
 }
 
 void desktop_handle_mouse(desktop_t* desktop, int x, int y, int buttons) {
@@ -617,6 +1383,9 @@ void desktop_handle_mouse(desktop_t* desktop, int x, int y, int buttons) {
     desktop->mouse_x = x;
     desktop->mouse_y = y;
     desktop->mouse_buttons = buttons;
+    if (!framebuffer_set_cursor(x, y, 1)) {
+        desktop_invalidate(x, y, CURSOR_WIDTH, CURSOR_HEIGHT);
+    }
     
     // Find window under mouse
     window_t* win = get_window_at_point(x, y);
@@ -632,8 +1401,9 @@ void desktop_handle_mouse(desktop_t* desktop, int x, int y, int buttons) {
         }
     }
     
-    // Redraw desktop
-    desktop_paint(desktop);
+    // Repaint what the cursor and window changes damaged in the next frame.
+    // A bare cursor move damages nothing: presenting is enough
+    frame_request();
 }
 
 void desktop_handle_key(desktop_t* desktop, char key) {
@@ -652,27 +1422,16 @@ window_t* desktop_get_active_window(desktop_t* desktop) {
 // ==================== MOUSE CURSOR ====================
 
 void draw_mouse_cursor(int x, int y) {
+    if (!mouse_cursor_ready) mouse_cursor_build();
     for (int dy = 0; dy < CURSOR_HEIGHT; dy++) {
-        for (int dx = 0; dx < CURSOR_WIDTH; dx++) {
-            if (mouse_cursor_data[dy][dx] & (1 << (7 - dx % 8))) {
-                draw_pixel(x + dx, y + dy, COLOR_WHITE);
-            }
-        }
+        framebuffer_draw_span(x, y + dy, mouse_cursor_image[dy], CURSOR_WIDTH, SPAN_BLEND);
     }
 }
 
 void hide_mouse_cursor(int x, int y) {
-    // Redraw the area where cursor was
-    // This is a simplified version - in real implementation we'd save background
-    for (int dy = 0; dy < CURSOR_HEIGHT; dy++) {
-        for (int dx = 0; dx < CURSOR_WIDTH; dx++) {
-            if (mouse_cursor_data[dy][dx] & (1 << (7 - dx % 8))) {
-                // In real implementation, we'd restore from saved background
-                // For now, just redraw the desktop area
-                if (global_desktop) {
-                    draw_pixel(x + dx, y + dy, global_desktop->desktop_color);
-                }
-            }
-        }
-    }
-}
\ No newline at end of file
+    // A cursor plane never touched the back buffer
+    if (framebuffer_set_cursor(x, y, 0)) return;
+    
+    // The next compose restores whatever is under the cursor
+    desktop_invalidate(x, y, CURSOR_WIDTH, CURSOR_HEIGHT);
+}
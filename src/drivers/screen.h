@@ -3,13 +3,33 @@
 #define SCREEN_H
 
 #include <stdint.h>
+#include "region.h"
 
-// Framebuffer configuration
+// Default framebuffer configuration (used when the bootloader reports no mode)
 #define SCREEN_WIDTH 1024
 #define SCREEN_HEIGHT 768
 #define BITS_PER_PIXEL 32
 #define BYTES_PER_PIXEL 4
 
+// Back buffer in system RAM (larger modes draw straight to the framebuffer)
+#define SCREEN_MAX_HEIGHT 2048
+#define BACK_BUFFER_SIZE (1920 * 1080 * 4)
+
+// Pixel formats of the linear framebuffer
+#define PIXEL_FORMAT_XRGB8888 0  // 32 bpp, stored as-is (fast path)
+#define PIXEL_FORMAT_RGB888   1  // 24 bpp packed
+#define PIXEL_FORMAT_RGB565   2  // 16 bpp
+#define PIXEL_FORMAT_GENERIC  3  // Any other channel layout (BGR, 555, ...)
+
+typedef struct {
+    int kind;                // PIXEL_FORMAT_*
+    int bpp;
+    int bytes_per_pixel;
+    uint8_t red_pos, red_size;
+    uint8_t green_pos, green_size;
+    uint8_t blue_pos, blue_size;
+} pixel_format_t;
+
 // Colors (ARGB format)
 #define COLOR_TRANSPARENT 0x00000000
 #define COLOR_BLACK       0xFF000000
@@ -37,6 +57,30 @@
 #define WINDOW_FLAG_MINIMIZED   0x08
 #define WINDOW_FLAG_MAXIMIZED   0x10
 
+// Window buffer formats
+#define WINDOW_FORMAT_ARGB          0  // Straight alpha; 0x00000000 is transparent (default)
+#define WINDOW_FORMAT_XRGB          1  // Opaque: rows are copied, never blended
+#define WINDOW_FORMAT_PREMULTIPLIED 2  // Premultiplied alpha
+#define WINDOW_FORMAT_COLOR_KEY     3  // Pixels equal to color_key are skipped, others copied
+
+// Per-row run index: which parts of a buffer row to skip, copy or blend
+#define WINDOW_ROW_RUNS 8
+#define WINDOW_RUN_SKIP  0
+#define WINDOW_RUN_COPY  1
+#define WINDOW_RUN_BLEND 2
+#define WINDOW_RUN_KEYED 3  // Color key row with too many runs: test each pixel
+
+typedef struct {
+    uint8_t count;                    // 0 = stale, rebuilt before the next compose
+    uint8_t kind[WINDOW_ROW_RUNS];
+    uint16_t end[WINDOW_ROW_RUNS];    // Run i covers [end[i-1], end[i])
+} window_row_runs_t;
+
+// Span operations for framebuffer_draw_span
+#define SPAN_COPY                  0
+#define SPAN_BLEND                 1
+#define SPAN_BLEND_PREMULTIPLIED   2
+
 // Mouse cursor
 #define CURSOR_WIDTH 12
 #define CURSOR_HEIGHT 16
@@ -47,12 +91,18 @@ typedef struct {
     int width, height;  // Size
     uint32_t flags;     // Window flags
     char title[64];     // Window title
-    uint32_t* buffer;   // Window buffer
+    uint32_t* buffer;   // Window surface, 0 until window_get_buffer
+    int stride;         // Pixels per buffer row (multiple of 4: 16-byte rows)
+    uint32_t surface_pages;
     int z_order;        // Z-order (higher = on top)
     struct window* parent; // Parent window
     void (*on_paint)(struct window* win);
     void (*on_click)(struct window* win, int x, int y);
     void (*on_key)(struct window* win, char key);
+    region_t visible;   // On-screen part not hidden by opaque windows above
+    int format;         // WINDOW_FORMAT_*
+    uint32_t color_key;
+    window_row_runs_t* runs;  // One entry per buffer row, stored after the pixels
 } window_t;
 
 // Структура desktop
@@ -68,11 +118,33 @@ typedef struct {
 
 // Framebuffer functions
 int init_framebuffer(void);
+int framebuffer_configure(void* address, int width, int height, int pitch, const pixel_format_t* format);
+uint32_t pixel_pack(uint32_t color);    // ARGB -> framebuffer format
+uint32_t pixel_unpack(uint32_t pixel);  // framebuffer format -> ARGB
+void framebuffer_fill_span(int x, int y, int count, uint32_t color);
+
+// Double buffering: drawing goes to the back buffer, damaged spans are
+// copied to the visible memory by framebuffer_present (see gpu_swap_buffers)
+int framebuffer_has_back_buffer(void);
+void framebuffer_mark_dirty(int x, int y, int width, int height);
+void framebuffer_mark_all_dirty(void);
+// include_previous: also copy the previous frame's damage (page flipping)
+void framebuffer_present(uint8_t* target, int include_previous);
+// Cursor plane: the cursor stays out of the back buffer and is blended over
+// each presented frame. Neither BGA nor the loader's framebuffer has a hardware
+// cursor. Returns 0 without a back buffer: the caller must draw the cursor
+// into the frame itself
+int framebuffer_set_cursor(int x, int y, int visible);
+// Drawing is clipped to this rectangle (the whole screen by default)
+void framebuffer_set_clip(const rect_t* clip);
+void framebuffer_reset_clip(void);
+void framebuffer_get_clip(rect_t* clip);
 void framebuffer_clear(uint32_t color);
 void framebuffer_put_pixel(int x, int y, uint32_t color);
 uint32_t framebuffer_get_pixel(int x, int y);
 void framebuffer_copy_rect(int src_x, int src_y, int dst_x, int dst_y, int width, int height);
 void framebuffer_blend_pixel(int x, int y, uint32_t color);
+void framebuffer_draw_span(int x, int y, const uint32_t* pixels, int count, int op);  // SPAN_*
 
 // Basic drawing functions
 void draw_pixel(int x, int y, uint32_t color);
@@ -101,11 +173,36 @@ void resize_window(window_t* window, int width, int height);
 void raise_window(window_t* window);
 void lower_window(window_t* window);
 window_t* get_window_at_point(int x, int y);
-void window_paint(window_t* window);
-
-// Desktop manager
+void window_paint(window_t* window);       // Repaints the window's screen area in the next frame
+void window_invalidate(window_t* window);  // Schedules that area for the next compose
+// The buffer changed inside this rectangle (window coordinates): repaint just
+// it in the next frame
+void window_update(window_t* window, int x, int y, int width, int height);
+// Same, but only adds damage: no frame is requested
+void window_damage(window_t* window, int x, int y, int width, int height);
+void window_set_format(window_t* window, int format, uint32_t color_key);
+// Pixels of the window, window->stride per row. The surface comes from page
+// frames on first use, starts transparent, and is 0 when memory runs out
+uint32_t* window_get_buffer(window_t* window);
+
+// Desktop manager: changes only add damage, desktop_compose repaints it
+// (called by the frame scheduler, see frame.h)
 desktop_t* create_desktop(void);
-void desktop_paint(desktop_t* desktop);
+void desktop_invalidate(int x, int y, int width, int height);
+void desktop_compose(desktop_t* desktop);
+void desktop_paint(desktop_t* desktop);    // Full repaint
+int desktop_has_damage(void);
+// Called with the clip set to each damaged rectangle, above the windows
+void desktop_set_overlay(void (*draw)(void));
+
+// What the last desktop_compose did
+typedef struct {
+    int damage_rects;
+    int damage_pixels;
+    int presented_pixels;   // Copied to video memory (0 without a back buffer)
+} compose_stats_t;
+
+const compose_stats_t* desktop_compose_stats(void);
 void desktop_handle_mouse(desktop_t* desktop, int x, int y, int buttons);
 void desktop_handle_key(desktop_t* desktop, char key);
 window_t* desktop_get_active_window(desktop_t* desktop);
@@ -115,10 +212,12 @@ void draw_mouse_cursor(int x, int y);
 void hide_mouse_cursor(int x, int y);
 
 // Global framebuffer pointer
-extern uint32_t* framebuffer;
+extern uint8_t* framebuffer;        // Drawing target (back buffer when available)
+extern uint8_t* framebuffer_front;  // Visible video memory
 extern int framebuffer_width;
 extern int framebuffer_height;
-extern int framebuffer_pitch;
+extern int framebuffer_pitch;   // Bytes per scanline
+extern pixel_format_t framebuffer_format;
 
 // Font data
 extern unsigned char font_8x8[128][8];
@@ -0,0 +1,505 @@
+// src/drivers/widget.c - Retained widgets drawn into window surfaces
+#include "widget.h"
+#include "glyph.h"
+#include "frame.h"
+#include "../lib/string.h"
+#include "../lib/pages.h"
+
+#define LIST_ITEM_HEIGHT (GLYPH_HEIGHT + 4)
+#define GRID_LINE_COLOR  COLOR_GRAY
+
+static widget_t widgets[MAX_WIDGETS];
+static uint8_t widget_used[MAX_WIDGETS];
+
+// ==================== SURFACE DRAWING ====================
+
+// Fills the part of a rectangle inside clip (window coordinates)
+static void surface_fill(uint32_t* buffer, int stride, const rect_t* clip,
+                         int x, int y, int width, int height, uint32_t color) {
+    rect_t area = {x, y, width, height};
+    rect_t r;
+    if (!rect_intersect(&area, clip, &r)) return;
+
+    for (int row = r.y; row < r.y + r.height; row++) {
+        uint32_t* p = &buffer[row * stride + r.x];
+        for (int i = 0; i < r.width; i++) p[i] = color;
+    }
+}
+
+// Text clipped to clip and, horizontally, to at most max_chars characters
+static void surface_text(uint32_t* buffer, int stride, const rect_t* clip, int x, int y,
+                         const char* text, int length, int max_chars,
+                         uint32_t color, uint32_t background) {
+    if (length > max_chars) length = max_chars;
+    if (length > 0) {
+        glyph_render_string(buffer, stride, clip, x, y, text, length, color, background);
+    }
+}
+
+static int text_length(const char* text, int max) {
+    int n = 0;
+    while (n < max && text[n]) n++;
+    return n;
+}
+
+// ==================== WIDGET TYPES ====================
+
+static void label_draw(widget_t* w, uint32_t* buffer, int stride, const rect_t* clip) {
+    int length = text_length(w->text, WIDGET_TEXT_MAX);
+    int text_y = w->y + (w->height - GLYPH_HEIGHT) / 2;
+
+    surface_fill(buffer, stride, clip, w->x, w->y, w->width, w->height, w->background);
+    surface_text(buffer, stride, clip, w->x, text_y, w->text, length,
+                 w->width / GLYPH_WIDTH, w->color, w->background);
+}
+
+static int button_text_x(widget_t* w, int length) {
+    int x = (w->width - length * GLYPH_WIDTH) / 2;
+    return w->x + (x > 2 ? x : 2);
+}
+
+static void button_draw(widget_t* w, uint32_t* buffer, int stride, const rect_t* clip) {
+    int length = text_length(w->text, WIDGET_TEXT_MAX);
+    int text_y = w->y + (w->height - GLYPH_HEIGHT) / 2;
+
+    surface_fill(buffer, stride, clip, w->x, w->y, w->width, w->height, w->background);
+    // Raised frame: light top/left, dark bottom/right
+    surface_fill(buffer, stride, clip, w->x, w->y, w->width, 1, COLOR_WHITE);
+    surface_fill(buffer, stride, clip, w->x, w->y, 1, w->height, COLOR_WHITE);
+    surface_fill(buffer, stride, clip, w->x, w->y + w->height - 1, w->width, 1, COLOR_DARK_GRAY);
+    surface_fill(buffer, stride, clip, w->x + w->width - 1, w->y, 1, w->height, COLOR_DARK_GRAY);
+    surface_text(buffer, stride, clip, button_text_x(w, length), text_y, w->text, length,
+                 (w->width - 4) / GLYPH_WIDTH, w->color, w->background);
+}
+
+static void text_view_draw(widget_t* w, uint32_t* buffer, int stride, const rect_t* clip) {
+    int grid_width = w->columns * GLYPH_WIDTH;
+    int grid_height = w->rows * GLYPH_HEIGHT;
+
+    // Strips the character grid does not cover
+    surface_fill(buffer, stride, clip, w->x + grid_width, w->y,
+                 w->width - grid_width, w->height, w->background);
+    surface_fill(buffer, stride, clip, w->x, w->y + grid_height,
+                 grid_width, w->height - grid_height, w->background);
+
+    int first = (clip->y - w->y) / GLYPH_HEIGHT;
+    int last = (clip->y + clip->height - w->y + GLYPH_HEIGHT - 1) / GLYPH_HEIGHT;
+    if (first < 0) first = 0;
+    if (last > w->rows) last = w->rows;
+    for (int row = first; row < last; row++) {
+        glyph_render_string(buffer, stride, clip, w->x, w->y + row * GLYPH_HEIGHT,
+                            &w->cells[row * w->columns], w->columns, w->color, w->background);
+    }
+}
+
+static int list_visible_items(widget_t* w) {
+    int n = w->height / LIST_ITEM_HEIGHT;
+    return n > 0 ? n : 1;
+}
+
+static void list_draw(widget_t* w, uint32_t* buffer, int stride, const rect_t* clip) {
+    int visible = list_visible_items(w);
+    int max_chars = (w->width - 4) / GLYPH_WIDTH;
+
+    for (int i = 0; i < visible; i++) {
+        int index = w->top + i;
+        int item_y = w->y + i * LIST_ITEM_HEIGHT;
+        int selected = (index == w->selected);
+        uint32_t background = selected ? COLOR_BLUE : w->background;
+
+        surface_fill(buffer, stride, clip, w->x, item_y, w->width, LIST_ITEM_HEIGHT, background);
+        if (index < w->item_count && w->items[index]) {
+            const char* item = w->items[index];
+            surface_text(buffer, stride, clip, w->x + 2, item_y + 2, item, strlen(item), max_chars,
+                         selected ? COLOR_WHITE : w->color, background);
+        }
+    }
+    int used = visible * LIST_ITEM_HEIGHT;
+    surface_fill(buffer, stride, clip, w->x, w->y + used, w->width, w->height - used, w->background);
+}
+
+static void grid_draw(widget_t* w, uint32_t* buffer, int stride, const rect_t* clip) {
+    surface_fill(buffer, stride, clip, w->x, w->y, w->width, w->height, w->background);
+
+    for (int c = 0; c <= w->columns; c++) {
+        surface_fill(buffer, stride, clip, w->x + c * w->cell_width, w->y, 1, w->height, GRID_LINE_COLOR);
+    }
+    for (int r = 0; r <= w->rows; r++) {
+        surface_fill(buffer, stride, clip, w->x, w->y + r * w->cell_height, w->width, 1, GRID_LINE_COLOR);
+    }
+
+    int text_y = (w->cell_height - GLYPH_HEIGHT) / 2;
+    for (int r = 0; r < w->rows; r++) {
+        int cell_y = w->y + r * w->cell_height;
+        if (cell_y >= clip->y + clip->height || cell_y + w->cell_height <= clip->y) continue;
+        for (int c = 0; c < w->columns; c++) {
+            const char* text = &w->cells[(r * w->columns + c) * w->cell_chars];
+            surface_text(buffer, stride, clip, w->x + c * w->cell_width + 2, cell_y + text_y,
+                         text, text_length(text, w->cell_chars), w->cell_chars,
+                         w->color, w->background);
+        }
+    }
+}
+
+// ==================== CORE ====================
+
+static void widget_render(widget_t* w) {
+    window_t* window = w->window;
+    uint32_t* buffer = window_get_buffer(window);
+    rect_t dirty = {w->x + w->dirty.x, w->y + w->dirty.y, w->dirty.width, w->dirty.height};
+    rect_t area = {0, 0, window->width, window->height};
+    rect_t clip;
+
+    w->dirty.width = 0;
+    if (!buffer || !rect_intersect(&dirty, &area, &clip)) return;
+
+    switch (w->type) {
+        case WIDGET_LABEL:     label_draw(w, buffer, window->stride, &clip); break;
+        case WIDGET_BUTTON:    button_draw(w, buffer, window->stride, &clip); break;
+        case WIDGET_TEXT_VIEW: text_view_draw(w, buffer, window->stride, &clip); break;
+        case WIDGET_LIST:      list_draw(w, buffer, window->stride, &clip); break;
+        case WIDGET_GRID:      grid_draw(w, buffer, window->stride, &clip); break;
+    }
+    window_damage(window, clip.x, clip.y, clip.width, clip.height);
+}
+
+void widget_invalidate(widget_t* widget, int x, int y, int width, int height) {
+    if (!widget) return;
+
+    rect_t bounds = {0, 0, widget->width, widget->height};
+    rect_t changed = {x, y, width, height};
+    rect_t r;
+    if (!rect_intersect(&changed, &bounds, &r)) return;
+
+    // Grow the dirty rectangle to cover both
+    rect_t* d = &widget->dirty;
+    if (d->width > 0) {
+        int x1 = (d->x + d->width > r.x + r.width) ? d->x + d->width : r.x + r.width;
+        int y1 = (d->y + d->height > r.y + r.height) ? d->y + d->height : r.y + r.height;
+        if (r.x > d->x) r.x = d->x;
+        if (r.y > d->y) r.y = d->y;
+        r.width = x1 - r.x;
+        r.height = y1 - r.y;
+    }
+    *d = r;
+}
+
+static void widget_invalidate_all(widget_t* widget) {
+    widget_invalidate(widget, 0, 0, widget->width, widget->height);
+}
+
+void widget_flush(void) {
+    int damaged = 0;
+
+    for (int i = 0; i < MAX_WIDGETS; i++) {
+        if (widget_used[i] && widgets[i].dirty.width > 0) {
+            widget_render(&widgets[i]);
+            damaged = 1;
+        }
+    }
+    if (damaged) frame_request();
+}
+
+widget_t* widget_at(window_t* window, int x, int y) {
+    // Last created wins where widgets overlap
+    for (int i = MAX_WIDGETS - 1; i >= 0; i--) {
+        widget_t* w = &widgets[i];
+        if (widget_used[i] && w->window == window &&
+            x >= w->x && x < w->x + w->width && y >= w->y && y < w->y + w->height) {
+            return w;
+        }
+    }
+    return 0;
+}
+
+static void widget_window_click(struct window* win, int x, int y) {
+    widget_t* w = widget_at((window_t*)win, x, y);
+    if (!w) return;
+
+    if (w->type == WIDGET_BUTTON) {
+        if (w->on_click) w->on_click(w, 0);
+    } else if (w->type == WIDGET_LIST) {
+        int index = w->top + (y - w->y) / LIST_ITEM_HEIGHT;
+        if (index < w->item_count) {
+            widget_list_select(w, index);
+            if (w->on_click) w->on_click(w, index);
+        }
+    }
+    widget_flush();
+}
+
+static widget_t* widget_alloc(window_t* window, int type, int x, int y, int width, int height) {
+    if (!window || width <= 0 || height <= 0) return 0;
+
+    for (int i = 0; i < MAX_WIDGETS; i++) {
+        if (widget_used[i]) continue;
+
+        widget_t* w = &widgets[i];
+        memset(w, 0, sizeof(widget_t));
+        widget_used[i] = 1;
+        w->type = type;
+        w->window = window;
+        w->x = x;
+        w->y = y;
+        w->width = width;
+        w->height = height;
+        w->selected = -1;
+        widget_invalidate_all(w);
+        return w;
+    }
+    return 0;
+}
+
+// Character cells for text views and grids, blank to start with
+static int widget_alloc_cells(widget_t* w, int columns, int rows, int cell_chars) {
+    uint32_t bytes = columns * rows * cell_chars;
+    if (bytes == 0) return 0;
+
+    w->cell_pages = pages_for_bytes(bytes);
+    w->cells = (char*)page_alloc(w->cell_pages);
+    if (!w->cells) return 0;
+
+    w->columns = columns;
+    w->rows = rows;
+    w->cell_chars = cell_chars;
+    memset(w->cells, (cell_chars == 1) ? ' ' : 0, bytes);
+    return 1;
+}
+
+static void widget_set_caption(widget_t* w, const char* text) {
+    int length = text ? text_length(text, WIDGET_TEXT_MAX - 1) : 0;
+    memcpy(w->text, text, length);
+    w->text[length] = '\0';
+}
+
+widget_t* widget_create_label(window_t* window, int x, int y, int width, int height,
+                              const char* text, uint32_t color, uint32_t background) {
+    widget_t* w = widget_alloc(window, WIDGET_LABEL, x, y, width, height);
+    if (!w) return 0;
+
+    widget_set_caption(w, text);
+    w->color = color;
+    w->background = background;
+    return w;
+}
+
+widget_t* widget_create_button(window_t* window, int x, int y, int width, int height,
+                               const char* caption, void (*on_click)(widget_t* widget, int index)) {
+    widget_t* w = widget_alloc(window, WIDGET_BUTTON, x, y, width, height);
+    if (!w) return 0;
+
+    widget_set_caption(w, caption);
+    w->color = COLOR_BLACK;
+    w->background = COLOR_LIGHT_GRAY;
+    w->on_click = on_click;
+    if (!window->on_click) window->on_click = widget_window_click;
+    return w;
+}
+
+widget_t* widget_create_text_view(window_t* window, int x, int y, int width, int height,
+                                  uint32_t color, uint32_t background) {
+    widget_t* w = widget_alloc(window, WIDGET_TEXT_VIEW, x, y, width, height);
+    if (!w) return 0;
+
+    if (!widget_alloc_cells(w, width / GLYPH_WIDTH, height / GLYPH_HEIGHT, 1)) {
+        widget_destroy(w);
+        return 0;
+    }
+    w->cell_width = GLYPH_WIDTH;
+    w->cell_height = GLYPH_HEIGHT;
+    w->color = color;
+    w->background = background;
+    return w;
+}
+
+widget_t* widget_create_list(window_t* window, int x, int y, int width, int height,
+                             const char** items, int count, void (*on_click)(widget_t* widget, int index)) {
+    widget_t* w = widget_alloc(window, WIDGET_LIST, x, y, width, height);
+    if (!w) return 0;
+
+    w->items = items;
+    w->item_count = items ? count : 0;
+    w->color = COLOR_BLACK;
+    w->background = COLOR_WHITE;
+    w->on_click = on_click;
+    if (!window->on_click) window->on_click = widget_window_click;
+    return w;
+}
+
+widget_t* widget_create_grid(window_t* window, int x, int y, int columns, int rows,
+                             int cell_width, int cell_height) {
+    // One pixel of grid line on every side of each cell
+    widget_t* w = widget_alloc(window, WIDGET_GRID, x, y,
+                               columns * cell_width + 1, rows * cell_height + 1);
+    if (!w) return 0;
+
+    int cell_chars = (cell_width - 3) / GLYPH_WIDTH;
+    if (cell_chars < 1 || cell_height < GLYPH_HEIGHT + 2 ||
+        !widget_alloc_cells(w, columns, rows, cell_chars)) {
+        widget_destroy(w);
+        return 0;
+    }
+    w->cell_width = cell_width;
+    w->cell_height = cell_height;
+    w->color = COLOR_BLACK;
+    w->background = COLOR_WHITE;
+    return w;
+}
+
+void widget_destroy(widget_t* widget) {
+    if (!widget) return;
+
+    if (widget->cells) page_free(widget->cells, widget->cell_pages);
+    widget->cells = 0;
+    widget_used[widget - widgets] = 0;
+}
+
+void widget_destroy_all(window_t* window) {
+    for (int i = 0; i < MAX_WIDGETS; i++) {
+        if (widget_used[i] && widgets[i].window == window) widget_destroy(&widgets[i]);
+    }
+}
+
+// ==================== CONTENT ====================
+
+void widget_set_text(widget_t* widget, const char* text) {
+    if (!widget || (widget->type != WIDGET_LABEL && widget->type != WIDGET_BUTTON)) return;
+
+    char old[WIDGET_TEXT_MAX];
+    memcpy(old, widget->text, WIDGET_TEXT_MAX);
+    widget_set_caption(widget, text);
+
+    int old_length = text_length(old, WIDGET_TEXT_MAX);
+    int new_length = text_length(widget->text, WIDGET_TEXT_MAX);
+    int length = (old_length > new_length) ? old_length : new_length;
+
+    // Differing characters [first, last)
+    int first = 0;
+    while (first < length && old[first] == widget->text[first]) first++;
+    if (first == length) return;
+    int last = length;
+    while (last > first && old[last - 1] == widget->text[last - 1]) last--;
+
+    // A centered caption moves when its length changes
+    if (widget->type == WIDGET_BUTTON && old_length != new_length) {
+        widget_invalidate_all(widget);
+        return;
+    }
+    int origin = (widget->type == WIDGET_BUTTON) ? button_text_x(widget, new_length) - widget->x : 0;
+    widget_invalidate(widget, origin + first * GLYPH_WIDTH, 0,
+                      (last - first) * GLYPH_WIDTH, widget->height);
+}
+
+static void text_view_set_cell(widget_t* w, int column, int row, char c) {
+    char* cell = &w->cells[row * w->columns + column];
+    if (*cell == c) return;
+
+    *cell = c;
+    widget_invalidate(w, column * GLYPH_WIDTH, row * GLYPH_HEIGHT, GLYPH_WIDTH, GLYPH_HEIGHT);
+}
+
+static void text_view_newline(widget_t* w) {
+    w->cursor_x = 0;
+    if (++w->cursor_y < w->rows) return;
+
+    // Scroll the cells; the whole view changes
+    for (int row = 1; row < w->rows; row++) {
+        memcpy(&w->cells[(row - 1) * w->columns], &w->cells[row * w->columns], w->columns);
+    }
+    memset(&w->cells[(w->rows - 1) * w->columns], ' ', w->columns);
+    w->cursor_y = w->rows - 1;
+    widget_invalidate_all(w);
+}
+
+void widget_text_write(widget_t* widget, const char* text, int length) {
+    if (!widget || widget->type != WIDGET_TEXT_VIEW || widget->rows == 0) return;
+
+    for (int i = 0; i < length; i++) {
+        char c = text[i];
+        if (c == '\n') {
+            text_view_newline(widget);
+        } else if (c == '\r') {
+            widget->cursor_x = 0;
+        } else if (c == '\b') {
+            if (widget->cursor_x > 0) {
+                widget->cursor_x--;
+            } else if (widget->cursor_y > 0) {
+                widget->cursor_y--;
+                widget->cursor_x = widget->columns - 1;
+            }
+            text_view_set_cell(widget, widget->cursor_x, widget->cursor_y, ' ');
+        } else {
+            // Wrap only when another character follows a full line
+            if (widget->cursor_x >= widget->columns) text_view_newline(widget);
+            text_view_set_cell(widget, widget->cursor_x, widget->cursor_y, c);
+            widget->cursor_x++;
+        }
+    }
+}
+
+void widget_text_print(widget_t* widget, const char* text) {
+    widget_text_write(widget, text, strlen(text));
+    widget_text_write(widget, "\n", 1);
+}
+
+void widget_text_clear(widget_t* widget) {
+    if (!widget || widget->type != WIDGET_TEXT_VIEW) return;
+
+    memset(widget->cells, ' ', widget->columns * widget->rows);
+    widget->cursor_x = 0;
+    widget->cursor_y = 0;
+    widget_invalidate_all(widget);
+}
+
+static void list_invalidate_item(widget_t* w, int index) {
+    int i = index - w->top;
+    if (index >= 0 && i >= 0 && i < list_visible_items(w)) {
+        widget_invalidate(w, 0, i * LIST_ITEM_HEIGHT, w->width, LIST_ITEM_HEIGHT);
+    }
+}
+
+void widget_list_select(widget_t* widget, int index) {
+    if (!widget || widget->type != WIDGET_LIST || index == widget->selected) return;
+    if (index >= widget->item_count) index = -1;
+
+    list_invalidate_item(widget, widget->selected);
+    widget->selected = index;
+    if (index < 0) return;
+
+    // Scrolling to the selection redraws every item
+    int visible = list_visible_items(widget);
+    if (index < widget->top) {
+        widget->top = index;
+        widget_invalidate_all(widget);
+    } else if (index >= widget->top + visible) {
+        widget->top = index - visible + 1;
+        widget_invalidate_all(widget);
+    } else {
+        list_invalidate_item(widget, index);
+    }
+}
+
+void widget_list_set_items(widget_t* widget, const char** items, int count) {
+    if (!widget || widget->type != WIDGET_LIST) return;
+
+    widget->items = items;
+    widget->item_count = items ? count : 0;
+    widget->selected = -1;
+    widget->top = 0;
+    widget_invalidate_all(widget);
+}
+
+void widget_grid_set(widget_t* widget, int column, int row, const char* text) {
+    if (!widget || widget->type != WIDGET_GRID) return;
+    if (column < 0 || column >= widget->columns || row < 0 || row >= widget->rows) return;
+
+    char* cell = &widget->cells[(row * widget->columns + column) * widget->cell_chars];
+    int length = text_length(text, widget->cell_chars);
+    if (length == text_length(cell, widget->cell_chars) && memcmp(cell, text, length) == 0) return;
+
+    memset(cell, 0, widget->cell_chars);
+    memcpy(cell, text, length);
+    // Inside the grid lines
+    widget_invalidate(widget, column * widget->cell_width + 1, row * widget->cell_height + 1,
+                      widget->cell_width - 1, widget->cell_height - 1);
+}
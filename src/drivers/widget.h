@@ -0,0 +1,80 @@
+// src/drivers/widget.h - Retained widgets drawn into window surfaces
+#ifndef WIDGET_H
+#define WIDGET_H
+
+#include <stdint.h>
+#include "screen.h"
+
+#define MAX_WIDGETS 64
+#define WIDGET_TEXT_MAX 64
+
+// Widget types
+#define WIDGET_LABEL     0  // One line of text
+#define WIDGET_BUTTON    1  // Framed, centered caption; on_click(widget, 0)
+#define WIDGET_TEXT_VIEW 2  // Character grid with a cursor, scrolls at the bottom
+#define WIDGET_LIST      3  // Caller-owned strings, one selected; on_click(widget, index)
+#define WIDGET_GRID      4  // Table of fixed-size cells holding short strings
+
+typedef struct widget {
+    int type;
+    window_t* window;
+    int x, y, width, height;  // Bounds in window coordinates
+    uint32_t color;           // Text
+    uint32_t background;
+    rect_t dirty;             // Widget coordinates; width 0 = nothing to redraw
+    char text[WIDGET_TEXT_MAX];
+
+    // Text view and grid: columns x rows cells of cell_chars characters
+    char* cells;
+    uint32_t cell_pages;
+    int columns, rows;
+    int cell_chars;
+    int cell_width, cell_height;
+    int cursor_x, cursor_y;
+
+    // List
+    const char** items;
+    int item_count;
+    int selected;             // -1 = none
+    int top;                  // First item shown
+
+    void (*on_click)(struct widget* widget, int index);
+} widget_t;
+
+// Widgets start dirty; nothing reaches the screen before widget_flush
+widget_t* widget_create_label(window_t* window, int x, int y, int width, int height,
+                              const char* text, uint32_t color, uint32_t background);
+widget_t* widget_create_button(window_t* window, int x, int y, int width, int height,
+                               const char* caption, void (*on_click)(widget_t* widget, int index));
+widget_t* widget_create_text_view(window_t* window, int x, int y, int width, int height,
+                                  uint32_t color, uint32_t background);
+widget_t* widget_create_list(window_t* window, int x, int y, int width, int height,
+                             const char** items, int count, void (*on_click)(widget_t* widget, int index));
+widget_t* widget_create_grid(window_t* window, int x, int y, int columns, int rows,
+                             int cell_width, int cell_height);
+void widget_destroy(widget_t* widget);
+// Every widget of the window (before the window itself is destroyed)
+void widget_destroy_all(window_t* window);
+
+// Marks part of the widget (widget coordinates) for redrawing
+void widget_invalidate(widget_t* widget, int x, int y, int width, int height);
+// Redraws dirty widgets into their surfaces; the damage is shown in the next frame
+void widget_flush(void);
+
+// Label and button: only the characters that differ are redrawn
+void widget_set_text(widget_t* widget, const char* text);
+
+// Text view: '\n', '\r' and '\b' (erases) are handled, long lines wrap
+void widget_text_write(widget_t* widget, const char* text, int length);
+void widget_text_print(widget_t* widget, const char* text);
+void widget_text_clear(widget_t* widget);
+
+void widget_list_select(widget_t* widget, int index);
+void widget_list_set_items(widget_t* widget, const char** items, int count);
+
+void widget_grid_set(widget_t* widget, int column, int row, const char* text);
+
+// Widget under a point of the window, or 0
+widget_t* widget_at(window_t* window, int x, int y);
+
+#endif
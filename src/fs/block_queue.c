@@ -0,0 +1,274 @@
+// fs/block_queue.c - Очередь блочных запросов с планировщиком C-LOOK
+#include "block_queue.h"
+#include "disk.h"
+#include "../lib/string.h"
+#include "../lib/cpu.h"
+#include "../drivers/text_output.h"
+
+// Максимальный размер одной передачи после объединения
+#define BLK_MAX_TRANSFER_SECTORS 2048
+
+typedef struct blk_request {
+    unsigned int lba;
+    unsigned int count;
+    int dir;
+    unsigned char *buffer;
+    blk_callback_t done;
+    void *arg;
+    unsigned long long submit_time;
+    struct blk_request *seg_next;   // Следующий сегмент той же передачи
+    // Только для первого сегмента передачи:
+    struct blk_request *seg_tail;
+    struct blk_request *next;       // Следующая передача (очередь отсортирована по LBA)
+    unsigned int end_lba;
+    unsigned int sectors;
+} blk_request_t;
+
+static blk_request_t request_pool[BLK_MAX_REQUESTS];
+static blk_request_t *free_list = 0;
+static int pool_ready = 0;
+
+static blk_request_t *queue_head = 0;   // Передачи, отсортированные по LBA
+static unsigned int head_position = 0;  // Где "головка" остановилась после последней передачи
+static int plug_depth = 0;
+static int dispatching = 0;
+
+static blk_stats_t stats;
+
+// Без TSC задержки не измеряются (остаются нулевыми)
+static unsigned long long blk_clock(void) {
+    return cpu_has(CPU_FEATURE_TSC) ? cpu_read_tsc() : 0;
+}
+
+static void pool_init() {
+    free_list = 0;
+    for (int i = BLK_MAX_REQUESTS - 1; i >= 0; i--) {
+        request_pool[i].seg_next = free_list;
+        free_list = &request_pool[i];
+    }
+    pool_ready = 1;
+}
+
+static blk_request_t *request_alloc() {
+    if (!pool_ready) pool_init();
+    if (!free_list) {
+        // Пул исчерпан: освобождаем его, выполнив накопленные запросы
+        blk_run_queue();
+        if (!free_list) return 0;
+    }
+
+    blk_request_t *req = free_list;
+    free_list = req->seg_next;
+    return req;
+}
+
+static void request_free(blk_request_t *req) {
+    req->seg_next = free_list;
+    free_list = req;
+}
+
+static int ranges_overlap(unsigned int a, unsigned int a_end, unsigned int b, unsigned int b_end) {
+    return a < b_end && b < a_end;
+}
+
+// Чтение не должно обгонять запись тех же секторов (и наоборот)
+static int conflicts_with_queue(int dir, unsigned int lba, unsigned int end) {
+    for (blk_request_t *t = queue_head; t; t = t->next) {
+        if ((dir == BLK_WRITE || t->dir == BLK_WRITE) &&
+            ranges_overlap(lba, end, t->lba, t->end_lba)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int can_merge(blk_request_t *first, blk_request_t *second) {
+    return first->dir == second->dir &&
+           first->end_lba == second->lba &&
+           first->sectors + second->sectors <= BLK_MAX_TRANSFER_SECTORS;
+}
+
+// Присоединяет передачу second к концу first
+static void merge_transfers(blk_request_t *first, blk_request_t *second) {
+    first->seg_tail->seg_next = second;
+    first->seg_tail = second->seg_tail;
+    first->end_lba = second->end_lba;
+    first->sectors += second->sectors;
+    first->next = second->next;
+    stats.merged++;
+}
+
+static void queue_insert(blk_request_t *req) {
+    blk_request_t *prev = 0;
+    blk_request_t *next = queue_head;
+
+    while (next && next->lba <= req->lba) {
+        prev = next;
+        next = next->next;
+    }
+
+    req->next = next;
+    if (prev) {
+        prev->next = req;
+    } else {
+        queue_head = req;
+    }
+
+    // Объединяем с соседями: сначала с последующей передачей, затем с предыдущей
+    if (next && can_merge(req, next)) {
+        merge_transfers(req, next);
+    }
+    if (prev && can_merge(prev, req)) {
+        merge_transfers(prev, req);
+    }
+}
+
+static void dispatch(blk_request_t *transfer) {
+    for (blk_request_t *seg = transfer; seg; seg = seg->seg_next) {
+        if (seg->dir == BLK_WRITE) {
+            disk_write_sectors(seg->lba, seg->count, seg->buffer);
+        } else {
+            disk_read_sectors(seg->lba, seg->count, seg->buffer);
+        }
+    }
+
+    stats.dispatched++;
+    stats.sectors += transfer->sectors;
+    head_position = transfer->end_lba;
+
+    // Завершаем сегменты; callback может отправить новые запросы
+    blk_request_t *seg = transfer;
+    while (seg) {
+        blk_request_t *next = seg->seg_next;
+        unsigned long long latency = blk_clock() - seg->submit_time;
+
+        stats.latency_total += latency;
+        if (latency > stats.latency_max) stats.latency_max = latency;
+        stats.depth--;
+
+        blk_callback_t done = seg->done;
+        unsigned int lba = seg->lba;
+        unsigned int count = seg->count;
+        void *arg = seg->arg;
+        request_free(seg);
+
+        if (done) done(lba, count, 0, arg);
+        seg = next;
+    }
+}
+
+void blk_run_queue() {
+    if (dispatching) return;
+    dispatching = 1;
+
+    while (queue_head) {
+        // C-LOOK: продолжаем вверх от текущей позиции, затем возвращаемся к началу
+        blk_request_t *prev = 0;
+        blk_request_t *transfer = queue_head;
+        while (transfer && transfer->lba < head_position) {
+            prev = transfer;
+            transfer = transfer->next;
+        }
+        if (!transfer) {
+            prev = 0;
+            transfer = queue_head;
+        }
+
+        if (prev) {
+            prev->next = transfer->next;
+        } else {
+            queue_head = transfer->next;
+        }
+        dispatch(transfer);
+    }
+
+    dispatching = 0;
+}
+
+int blk_submit(int dir, unsigned int lba, unsigned int count, unsigned char *buffer,
+               blk_callback_t done, void *arg) {
+    if (count == 0 || lba + count > disk_get_sector_count()) {
+        printf("Block: Invalid request LBA %d, %d sectors\n", lba, count);
+        if (done) done(lba, count, -1, arg);
+        return -1;
+    }
+
+    if (conflicts_with_queue(dir, lba, lba + count)) {
+        blk_run_queue();
+    }
+
+    blk_request_t *req = request_alloc();
+    if (!req) {
+        printf("Block: Request pool exhausted\n");
+        if (done) done(lba, count, -1, arg);
+        return -1;
+    }
+
+    req->lba = lba;
+    req->count = count;
+    req->dir = dir;
+    req->buffer = buffer;
+    req->done = done;
+    req->arg = arg;
+    req->submit_time = blk_clock();
+    req->seg_next = 0;
+    req->seg_tail = req;
+    req->end_lba = lba + count;
+    req->sectors = count;
+
+    stats.submitted++;
+    stats.depth++;
+    if (stats.depth > stats.max_depth) stats.max_depth = stats.depth;
+
+    queue_insert(req);
+
+    if (plug_depth == 0) {
+        blk_run_queue();
+    }
+    return 0;
+}
+
+void blk_plug() {
+    plug_depth++;
+}
+
+void blk_unplug() {
+    if (plug_depth > 0) plug_depth--;
+    if (plug_depth == 0) {
+        blk_run_queue();
+    }
+}
+
+const blk_stats_t *blk_get_stats() {
+    return &stats;
+}
+
+void blk_reset_stats() {
+    unsigned int depth = stats.depth;
+    memset(&stats, 0, sizeof(stats));
+    stats.depth = depth;
+    stats.max_depth = depth;
+}
+
+// Ядро собирается без libgcc, поэтому 64-битное деление недоступно:
+// сдвигаем сумму и делитель, пока сумма не поместится в 32 бита
+static unsigned int average_latency(unsigned long long total, unsigned int count) {
+    while (total > 0xFFFFFFFFULL && count > 1) {
+        total >>= 1;
+        count >>= 1;
+    }
+    if (total > 0xFFFFFFFFULL) return 0xFFFFFFFF;
+    return count ? (unsigned int)total / count : 0;
+}
+
+void blk_print_stats() {
+    unsigned int completed = stats.submitted - stats.depth;
+    unsigned int merge_pct = stats.submitted ? stats.merged * 100 / stats.submitted : 0;
+    unsigned int avg_latency = average_latency(stats.latency_total, completed);
+
+    printf("Block queue statistics:\n");
+    printf("  Requests:   %d submitted, %d merged (%d%%)\n", stats.submitted, stats.merged, merge_pct);
+    printf("  Transfers:  %d dispatched, %d sectors\n", stats.dispatched, stats.sectors);
+    printf("  Depth:      %d now, %d max\n", stats.depth, stats.max_depth);
+    printf("  Latency:    %d cycles avg, %d cycles max\n", avg_latency, (unsigned int)stats.latency_max);
+}
@@ -0,0 +1,37 @@
+// fs/block_queue.h - Asynchronous block request queue
+#ifndef BLOCK_QUEUE_H
+#define BLOCK_QUEUE_H
+
+#define BLK_READ  0
+#define BLK_WRITE 1
+
+#define BLK_MAX_REQUESTS 512
+
+// Вызывается по завершении запроса (status 0 = успех)
+typedef void (*blk_callback_t)(unsigned int lba, unsigned int count, int status, void *arg);
+
+typedef struct {
+    unsigned int submitted;       // Запросов принято
+    unsigned int merged;          // Из них присоединено к соседним
+    unsigned int dispatched;      // Передач, отправленных на диск
+    unsigned int sectors;         // Секторов передано
+    unsigned int depth;           // Текущая глубина очереди
+    unsigned int max_depth;
+    unsigned long long latency_total;  // Такты TSC от submit до completion
+    unsigned long long latency_max;
+} blk_stats_t;
+
+// Буфер должен оставаться действительным до вызова callback
+int blk_submit(int dir, unsigned int lba, unsigned int count, unsigned char *buffer,
+               blk_callback_t done, void *arg);
+
+// Пока очередь "заткнута", запросы копятся, сортируются и объединяются
+void blk_plug();
+void blk_unplug();
+void blk_run_queue();
+
+const blk_stats_t *blk_get_stats();
+void blk_reset_stats();
+void blk_print_stats();
+
+#endif
@@ -1,60 +1,397 @@
-// fs/disk.c - РЕАЛЬНОЕ СОХРАНЕНИЕ ДАННЫХ
+// fs/disk.c - RAM-диск поверх образа из Multiboot модуля
 #include "disk.h"
+#include "../multiboot.h"
+#include "../lib/string.h"
 #include "../drivers/screen.h"
 #include "../drivers/text_output.h"
 
 // Увеличим размер диска до 500MB
 #define DISK_SIZE_BYTES (500 * 1024 * 1024)
+#define DISK_CHUNK_COUNT (DISK_SIZE_BYTES / DISK_CHUNK_SIZE)
+
+// Оверлей: сюда попадают только измененные 4KB блоки.
+// Исходный образ (модуль) никогда не модифицируется без явного disk_save_to_file().
 static unsigned char disk_image[DISK_SIZE_BYTES];
+static unsigned char overlay_map[DISK_CHUNK_COUNT / 8];
+
+// Образ, переданный загрузчиком (отображается на месте, без копирования)
+static const unsigned char *backing_image = 0;
+static unsigned int backing_size = 0;
+
+static int disk_ready = 0;
+static unsigned int overlay_chunks = 0;
+
+// ==================== SNAPSHOTS ====================
+// Снимок хранит старое содержимое 4KB блоков, измененных после его создания.
+// Карта блок -> сохраненная копия: radix-дерево из 3 уровней по 64 элемента
+// (18 бит индекса покрывают все 128000 блоков диска). Пустой снимок — один
+// корневой узел, поэтому создание снимка O(1) и стоит 128 байт.
+#define SNAP_RADIX_BITS 6
+#define SNAP_RADIX_FANOUT (1 << SNAP_RADIX_BITS)
+#define SNAP_RADIX_MASK (SNAP_RADIX_FANOUT - 1)
+#define SNAP_RADIX_LEVELS 3
+#define SNAP_MAX_NODES 2048       // Достаточно даже для изменения всех блоков
+#define SNAP_POOL_CHUNKS 4096     // 16MB сохраненных данных
+
+typedef struct {
+    unsigned short slot[SNAP_RADIX_FANOUT];  // 0 = пусто, иначе индекс + 1
+} snap_node_t;
+
+static snap_node_t snap_nodes[SNAP_MAX_NODES];
+static unsigned char snap_pool[SNAP_POOL_CHUNKS][DISK_CHUNK_SIZE];
+static unsigned int snap_node_count = 0;
+static unsigned int snap_pool_used = 0;
+static int snap_active = 0;
+
+static int chunk_in_overlay(unsigned int chunk) {
+    return overlay_map[chunk >> 3] & (1 << (chunk & 7));
+}
+
+// Содержимое блока в исходном образе (за пределами образа — нули)
+static void chunk_read_backing(unsigned int chunk, unsigned char *dst) {
+    unsigned int offset = chunk * DISK_CHUNK_SIZE;
+
+    if (offset + DISK_CHUNK_SIZE <= backing_size) {
+        memcpy(dst, backing_image + offset, DISK_CHUNK_SIZE);
+    } else if (offset < backing_size) {
+        unsigned int part = backing_size - offset;
+        memcpy(dst, backing_image + offset, part);
+        memset(dst + part, 0, DISK_CHUNK_SIZE - part);
+    } else {
+        memset(dst, 0, DISK_CHUNK_SIZE);
+    }
+}
+
+// Копирует содержимое блока из образа (или нули) в оверлей при первой записи
+static void chunk_copy_up(unsigned int chunk) {
+    chunk_read_backing(chunk, &disk_image[chunk * DISK_CHUNK_SIZE]);
+    overlay_map[chunk >> 3] |= (1 << (chunk & 7));
+    overlay_chunks++;
+}
+
+// Источник данных сектора без оверлея: образ или нули (0 = нули)
+static const unsigned char *backing_sector(unsigned int byte_offset) {
+    if (byte_offset + SECTOR_SIZE <= backing_size) {
+        return backing_image + byte_offset;
+    }
+    return 0;
+}
+
+// Текущее содержимое блока (оверлей, образ или нули)
+static void chunk_read_current(unsigned int chunk, unsigned char *dst) {
+    if (chunk_in_overlay(chunk)) {
+        memcpy(dst, &disk_image[chunk * DISK_CHUNK_SIZE], DISK_CHUNK_SIZE);
+    } else {
+        chunk_read_backing(chunk, dst);
+    }
+}
+
+static snap_node_t *snap_alloc_node(unsigned short *index) {
+    if (snap_node_count >= SNAP_MAX_NODES) return 0;
+
+    snap_node_t *node = &snap_nodes[snap_node_count];
+    memset(node, 0, sizeof(snap_node_t));
+    *index = ++snap_node_count;
+    return node;
+}
+
+// Сохраняет текущее содержимое блока перед первой записью после снимка
+static void snap_preserve(unsigned int chunk) {
+    snap_node_t *node = &snap_nodes[0];
+
+    for (int level = SNAP_RADIX_LEVELS - 1; level > 0; level--) {
+        unsigned short *link = &node->slot[(chunk >> (level * SNAP_RADIX_BITS)) & SNAP_RADIX_MASK];
+        if (*link) {
+            node = &snap_nodes[*link - 1];
+            continue;
+        }
+
+        unsigned short index;
+        snap_node_t *child = snap_alloc_node(&index);
+        if (!child) {
+            printf("Disk: Snapshot metadata full, snapshot dropped\n");
+            snap_active = 0;
+            return;
+        }
+        *link = index;
+        node = child;
+    }
+
+    // Блок уже сохранен после создания снимка
+    unsigned short *leaf = &node->slot[chunk & SNAP_RADIX_MASK];
+    if (*leaf) return;
+
+    if (snap_pool_used >= SNAP_POOL_CHUNKS) {
+        printf("Disk: Snapshot space full (%dMB), snapshot dropped\n",
+               SNAP_POOL_CHUNKS * DISK_CHUNK_SIZE / (1024*1024));
+        snap_active = 0;
+        return;
+    }
+
+    chunk_read_current(chunk, snap_pool[snap_pool_used]);
+    *leaf = ++snap_pool_used;
+}
+
+void disk_attach_image(const void *image, unsigned int size) {
+    if (size > DISK_SIZE_BYTES) {
+        printf("Disk: Image is %dMB, only first %dMB used\n",
+               size / (1024*1024), DISK_SIZE_BYTES / (1024*1024));
+        size = DISK_SIZE_BYTES;
+    }
+
+    backing_image = (const unsigned char*)image;
+    backing_size = image ? (size / SECTOR_SIZE) * SECTOR_SIZE : 0;
+    disk_overlay_discard();
+}
 
 int disk_init() {
+    if (disk_ready) return 1;
+
     printf("Disk: Initializing %dMB disk\n", DISK_SIZE_BYTES / (1024*1024));
-    
-    // Инициализируем диск нулями
-    for (unsigned int i = 0; i < DISK_SIZE_BYTES; i++) {
-        disk_image[i] = 0;
-    }
-    
+
+    // Диск больше не заполняется нулями: пустые блоки читаются как нули,
+    // поэтому инициализация не зависит от размера диска
+    disk_attach_image(0, 0);
+    disk_load_from_file();
+
+    disk_ready = 1;
     printf("Disk: Ready! %dMB available\n", DISK_SIZE_BYTES / (1024*1024));
     return 1;
 }
 
 void disk_read_sector(unsigned int lba, unsigned char *buffer) {
     unsigned int byte_offset = lba * SECTOR_SIZE;
-    
-    if (byte_offset >= DISK_SIZE_BYTES) {
+
+    if (lba >= DISK_SIZE_BYTES / SECTOR_SIZE) {
         printf("Disk: Read beyond disk! LBA: %d\n", lba);
         return;
     }
-    
-    // Копируем данные из диска в буфер
-    for (int i = 0; i < SECTOR_SIZE; i++) {
-        buffer[i] = disk_image[byte_offset + i];
+
+    if (chunk_in_overlay(byte_offset / DISK_CHUNK_SIZE)) {
+        memcpy(buffer, &disk_image[byte_offset], SECTOR_SIZE);
+        return;
+    }
+
+    const unsigned char *src = backing_sector(byte_offset);
+    if (src) {
+        memcpy(buffer, src, SECTOR_SIZE);
+    } else {
+        memset(buffer, 0, SECTOR_SIZE);
     }
 }
 
 void disk_write_sector(unsigned int lba, unsigned char *buffer) {
     unsigned int byte_offset = lba * SECTOR_SIZE;
-    
-    if (byte_offset >= DISK_SIZE_BYTES) {
+
+    if (lba >= DISK_SIZE_BYTES / SECTOR_SIZE) {
         printf("Disk: Write beyond disk! LBA: %d\n", lba);
         return;
     }
-    
-    // Копируем данные из буфера на диск
-    for (int i = 0; i < SECTOR_SIZE; i++) {
-        disk_image[byte_offset + i] = buffer[i];
+
+    unsigned int chunk = byte_offset / DISK_CHUNK_SIZE;
+    if (snap_active) {
+        snap_preserve(chunk);
+    }
+    if (!chunk_in_overlay(chunk)) {
+        chunk_copy_up(chunk);
+    }
+
+    memcpy(&disk_image[byte_offset], buffer, SECTOR_SIZE);
+}
+
+void disk_read_sectors(unsigned int lba, unsigned int count, unsigned char *buffer) {
+    for (unsigned int i = 0; i < count; i++) {
+        disk_read_sector(lba + i, buffer + i * SECTOR_SIZE);
     }
 }
 
-// НОВАЯ ФУНКЦИЯ: Сохранение диска в файл (для эмуляции)
+void disk_write_sectors(unsigned int lba, unsigned int count, unsigned char *buffer) {
+    for (unsigned int i = 0; i < count; i++) {
+        disk_write_sector(lba + i, buffer + i * SECTOR_SIZE);
+    }
+}
+
+unsigned int disk_get_sector_count() {
+    return DISK_SIZE_BYTES / SECTOR_SIZE;
+}
+
+int disk_has_image() {
+    return backing_image != 0;
+}
+
+unsigned int disk_overlay_size() {
+    return overlay_chunks * DISK_CHUNK_SIZE;
+}
+
+static void overlay_reset() {
+    memset(overlay_map, 0, sizeof(overlay_map));
+    overlay_chunks = 0;
+}
+
+// Отбросить все изменения и вернуться к исходному образу
+void disk_overlay_discard() {
+    overlay_reset();
+    disk_snapshot_drop();
+}
+
+// Сохранение: переносим оверлей в образ модуля. Хост может забрать образ
+// командой монитора QEMU pmemsave по напечатанному адресу.
 void disk_save_to_file() {
-    // В реальной системе здесь будет запись на физический диск
-    printf("Disk: Data synchronized to storage\n");
+    if (!backing_image) {
+        printf("Disk: No image attached, changes stay in RAM\n");
+        return;
+    }
+
+    unsigned char *image = (unsigned char*)backing_image;
+    unsigned int image_chunks = (backing_size + DISK_CHUNK_SIZE - 1) / DISK_CHUNK_SIZE;
+    unsigned int committed = 0;
+
+    for (unsigned int chunk = 0; chunk < image_chunks; chunk++) {
+        if (!chunk_in_overlay(chunk)) continue;
+
+        unsigned int offset = chunk * DISK_CHUNK_SIZE;
+        unsigned int len = DISK_CHUNK_SIZE;
+        if (offset + len > backing_size) len = backing_size - offset;
+
+        memcpy(image + offset, &disk_image[offset], len);
+        committed++;
+
+        // Блок, выходящий за конец образа, остается в оверлее: его хвост
+        // хранится только там
+        if (len == DISK_CHUNK_SIZE) {
+            overlay_map[chunk >> 3] &= ~(1 << (chunk & 7));
+            overlay_chunks--;
+        }
+    }
+
+    // Блоки за концом образа тоже остаются в оверлее. Содержимое диска не
+    // изменилось, поэтому снимок остается действительным
+    printf("Disk: %d blocks synchronized to image\n", committed);
+    printf("Disk: Host copy: pmemsave 0x%x %d disk.img\n", (unsigned int)backing_image, backing_size);
 }
 
-// НОВАЯ ФУНКЦИЯ: Загрузка диска из файла
+// Загрузка: подключаем первый Multiboot модуль как исходный образ
 void disk_load_from_file() {
-    // В реальной системе здесь будет чтение с физического диска
-    printf("Disk: Data loaded from storage\n");
-}
\ No newline at end of file
+    const multiboot_module_t *mod = multiboot_get_module(0);
+    if (!mod) {
+        printf("Disk: No boot image, using empty RAM disk\n");
+        return;
+    }
+
+    disk_attach_image((const void*)mod->start, mod->end - mod->start);
+    printf("Disk: Mapped boot image at 0x%x (%d KB)\n", mod->start, backing_size / 1024);
+}
+
+// ==================== SNAPSHOT API ====================
+
+// O(1): сбрасываем пулы и начинаем новое пустое дерево
+void disk_snapshot_create() {
+    unsigned short root;
+    snap_node_count = 0;
+    snap_pool_used = 0;
+    snap_alloc_node(&root);
+    snap_active = 1;
+}
+
+void disk_snapshot_drop() {
+    snap_active = 0;
+    snap_node_count = 0;
+    snap_pool_used = 0;
+}
+
+int disk_snapshot_active() {
+    return snap_active;
+}
+
+unsigned int disk_snapshot_changed_chunks() {
+    return snap_active ? snap_pool_used : 0;
+}
+
+unsigned int disk_snapshot_metadata_size() {
+    return snap_active ? snap_node_count * sizeof(snap_node_t) : 0;
+}
+
+// Обходит листья дерева; callback получает номер блока и сохраненную копию
+static void snap_walk(snap_node_t *node, int level, unsigned int prefix,
+                      void (*visit)(unsigned int chunk, unsigned char *saved, void *arg), void *arg) {
+    for (unsigned int i = 0; i < SNAP_RADIX_FANOUT; i++) {
+        unsigned short link = node->slot[i];
+        if (!link) continue;
+
+        unsigned int index = (prefix << SNAP_RADIX_BITS) | i;
+        if (level == 0) {
+            visit(index, snap_pool[link - 1], arg);
+        } else {
+            snap_walk(&snap_nodes[link - 1], level - 1, index, visit, arg);
+        }
+    }
+}
+
+static void snap_restore_chunk(unsigned int chunk, unsigned char *saved, void *arg) {
+    if (!chunk_in_overlay(chunk)) {
+        chunk_copy_up(chunk);
+    }
+    memcpy(&disk_image[chunk * DISK_CHUNK_SIZE], saved, DISK_CHUNK_SIZE);
+    (*(unsigned int*)arg)++;
+}
+
+// Возвращает диск в состояние на момент снимка; снимок остается активным
+int disk_snapshot_rollback() {
+    if (!snap_active) return -1;
+
+    unsigned int restored = 0;
+    snap_walk(&snap_nodes[0], SNAP_RADIX_LEVELS - 1, 0, snap_restore_chunk, &restored);
+    disk_snapshot_create();
+    return restored;
+}
+
+typedef struct {
+    unsigned int range_start;
+    unsigned int range_end;    // Следующий за последним сектор, 0 = нет диапазона
+    unsigned int sectors;
+    unsigned char current[DISK_CHUNK_SIZE];
+} snap_diff_state_t;
+
+static snap_diff_state_t diff_state;
+
+static void snap_diff_flush(snap_diff_state_t *state) {
+    if (state->range_end == 0) return;
+
+    if (state->range_end - state->range_start == 1) {
+        printf("  LBA %d\n", state->range_start);
+    } else {
+        printf("  LBA %d-%d\n", state->range_start, state->range_end - 1);
+    }
+    state->range_end = 0;
+}
+
+static void snap_diff_chunk(unsigned int chunk, unsigned char *saved, void *arg) {
+    snap_diff_state_t *state = (snap_diff_state_t*)arg;
+    chunk_read_current(chunk, state->current);
+
+    for (unsigned int s = 0; s < DISK_CHUNK_SECTORS; s++) {
+        if (memcmp(saved + s * SECTOR_SIZE, state->current + s * SECTOR_SIZE, SECTOR_SIZE) == 0) {
+            continue;
+        }
+
+        unsigned int lba = chunk * DISK_CHUNK_SECTORS + s;
+        if (state->range_end != lba) {
+            snap_diff_flush(state);
+            state->range_start = lba;
+        }
+        state->range_end = lba + 1;
+        state->sectors++;
+    }
+}
+
+// Печатает секторы, отличающиеся от снимка (соседние объединяются в диапазоны)
+int disk_snapshot_diff() {
+    if (!snap_active) return -1;
+
+    diff_state.range_start = 0;
+    diff_state.range_end = 0;
+    diff_state.sectors = 0;
+    snap_walk(&snap_nodes[0], SNAP_RADIX_LEVELS - 1, 0, snap_diff_chunk, &diff_state);
+    snap_diff_flush(&diff_state);
+    return diff_state.sectors;
+}
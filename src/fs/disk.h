@@ -3,10 +3,32 @@
 #define DISK_H
 
 #define SECTOR_SIZE 512
+#define DISK_CHUNK_SIZE 4096  // Copy-on-write granularity
+#define DISK_CHUNK_SECTORS (DISK_CHUNK_SIZE / SECTOR_SIZE)
 
 // Disk functions
 void disk_read_sector(unsigned int lba, unsigned char *buffer);
 void disk_write_sector(unsigned int lba, unsigned char *buffer);
+void disk_read_sectors(unsigned int lba, unsigned int count, unsigned char *buffer);
+void disk_write_sectors(unsigned int lba, unsigned int count, unsigned char *buffer);
 int disk_init();
+unsigned int disk_get_sector_count();
 
-#endif
\ No newline at end of file
+// Boot image (Multiboot module) backing store
+void disk_attach_image(const void *image, unsigned int size);
+int disk_has_image();
+unsigned int disk_overlay_size();
+void disk_overlay_discard();
+void disk_save_to_file();
+void disk_load_from_file();
+
+// Block-level copy-on-write snapshots
+void disk_snapshot_create();
+void disk_snapshot_drop();
+int disk_snapshot_active();
+int disk_snapshot_rollback();
+int disk_snapshot_diff();
+unsigned int disk_snapshot_changed_chunks();
+unsigned int disk_snapshot_metadata_size();
+
+#endif
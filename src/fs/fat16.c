@@ -1,11 +1,13 @@
 // fs/fat16.c - ПОЛНАЯ ВЕРСИЯ С СИНХРОНИЗАЦИЕЙ
 #include "fat16.h"
+#include "block_queue.h"
 #include "../drivers/screen.h"
 #include "../lib/string.h"
 #include "../drivers/text_output.h"
 
 static fat16_boot_sector_t boot_sector;
 static unsigned char fat_table[800 * 512];
+static unsigned char fat_dirty[800 / 8];  // Измененные секторы FAT
 static unsigned char root_dir[512 * 32];
 static unsigned char file_buffer[512];
 
@@ -71,32 +73,50 @@ void name83_to_filename(const char *name83, char *filename) {
     filename[pos] = '\0';
 }
 
+static void page_cache_writeback(unsigned short file_cluster);
+static void page_cache_refresh(unsigned short file_cluster);
+static void name_index_rebuild();
+
+static void fat16_mark_fat_dirty(unsigned int sector) {
+    fat_dirty[sector / 8] |= 1 << (sector % 8);
+}
+
+static void fat16_mark_fat_dirty_all() {
+    memset(fat_dirty, 0xFF, sizeof(fat_dirty));
+}
+
 // ФУНКЦИИ СИНХРОНИЗАЦИИ
+// Записи идут через очередь блочных запросов: отдельные секторы
+// объединяются в крупные последовательные передачи
 void fat16_sync_fat() {
-    for (int i = 0; i < boot_sector.sectors_per_fat; i++) {
-        unsigned char *sector_data = &fat_table[i * 512];
-        disk_write_sector(fat_start + i, sector_data);
+    for (int copy = 0; copy < boot_sector.fat_copies; copy++) {
+        unsigned int copy_start = fat_start + copy * boot_sector.sectors_per_fat;
+        
+        for (int i = 0; i < boot_sector.sectors_per_fat; i++) {
+            if (fat_dirty[i / 8] & (1 << (i % 8))) {
+                blk_submit(BLK_WRITE, copy_start + i, 1, &fat_table[i * 512], 0, 0);
+            }
+        }
     }
     
-    for (int i = 0; i < boot_sector.sectors_per_fat; i++) {
-        unsigned char *sector_data = &fat_table[i * 512];
-        disk_write_sector(fat_start + boot_sector.sectors_per_fat + i, sector_data);
-    }
+    memset(fat_dirty, 0, sizeof(fat_dirty));
 }
 
 void fat16_sync_root() {
     int root_sectors = (boot_sector.root_entries * 32) / 512;
-    for (int i = 0; i < root_sectors; i++) {
-        unsigned char *sector_data = &root_dir[i * 512];
-        disk_write_sector(root_start + i, sector_data);
-    }
+    blk_submit(BLK_WRITE, root_start, root_sectors, root_dir, 0, 0);
 }
 
 void fat16_sync() {
+    // Страницы, измененные через fat16_map, здесь не пишутся: это
+    // несохраненные правки, их записывает только fat16_msync
+    
     if (needs_sync) {
         printf("FAT16: Syncing to disk...\n");
+        blk_plug();
         fat16_sync_fat();
         fat16_sync_root();
+        blk_unplug();
         needs_sync = 0;
         printf("FAT16: Sync complete\n");
     }
@@ -105,30 +125,47 @@ void fat16_sync() {
 int fat16_load_from_disk() {
     printf("FAT16: Loading from disk...\n");
     
-    // Читаем загрузочный сектор
-    disk_read_sector(0, (unsigned char*)&boot_sector);
+    // Читаем загрузочный сектор во временный буфер: структура короче сектора,
+    // а при ошибке текущая геометрия должна остаться нетронутой
+    disk_read_sector(0, file_buffer);
+    fat16_boot_sector_t *disk_boot = (fat16_boot_sector_t*)file_buffer;
     
     // Проверяем сигнатуру
-    if (boot_sector.bytes_per_sector != 512) {
+    if (disk_boot->bytes_per_sector != 512) {
         printf("FAT16: Invalid boot sector\n");
         return 0;
     }
     
+    // Образ с хоста должен помещаться в наши таблицы
+    if (disk_boot->sectors_per_fat * 512 > sizeof(fat_table) ||
+        disk_boot->root_entries * 32 > sizeof(root_dir) ||
+        disk_boot->sectors_per_cluster == 0) {
+        printf("FAT16: Unsupported volume geometry\n");
+        return 0;
+    }
+    
+    memcpy(&boot_sector, disk_boot, sizeof(boot_sector));
+    
+    if (boot_sector.total_sectors_large == 0) {
+        boot_sector.total_sectors_large = boot_sector.total_sectors_small;
+    }
+    
     // Пересчитываем позиции
     fat_start = boot_sector.reserved_sectors;
     root_start = fat_start + (boot_sector.fat_copies * boot_sector.sectors_per_fat);
     data_start = root_start + ((boot_sector.root_entries * 32) / boot_sector.bytes_per_sector);
     
-    // Загружаем FAT таблицу
-    for (int i = 0; i < boot_sector.sectors_per_fat; i++) {
-        disk_read_sector(fat_start + i, &fat_table[i * 512]);
-    }
-    
-    // Загружаем корневой каталог
+    // Загружаем FAT таблицу и корневой каталог
     int root_sectors = (boot_sector.root_entries * 32) / 512;
-    for (int i = 0; i < root_sectors; i++) {
-        disk_read_sector(root_start + i, &root_dir[i * 512]);
-    }
+    blk_plug();
+    blk_submit(BLK_READ, fat_start, boot_sector.sectors_per_fat, fat_table, 0, 0);
+    blk_submit(BLK_READ, root_start, root_sectors, root_dir, 0, 0);
+    blk_unplug();
+    memset(fat_dirty, 0, sizeof(fat_dirty));
+    name_index_rebuild();
+    
+    // Данные могли измениться в обход кэша (например, откат снимка)
+    page_cache_refresh(0);
     
     // Рассчитываем общее количество кластеров
     unsigned int data_sectors = boot_sector.total_sectors_large - data_start;
@@ -148,6 +185,7 @@ static void fat16_write_fat_entry(unsigned short cluster, unsigned short value)
     if (cluster < total_clusters) {
         unsigned int fat_offset = cluster * 2;
         *(unsigned short*)&fat_table[fat_offset] = value;
+        fat16_mark_fat_dirty(fat_offset / 512);
         needs_sync = 1;
         // Автоматическое сохранение при изменении FAT
         fat16_sync();
@@ -164,17 +202,28 @@ static unsigned short fat16_find_free_cluster() {
 }
 
 static int fat16_allocate_cluster_chain(unsigned short start_cluster, unsigned int clusters_needed) {
+    // Доходим до конца уже существующей цепочки
     unsigned short current = start_cluster;
+    unsigned int clusters = 1;
     
-    for (unsigned int i = 1; i < clusters_needed; i++) {
+    while (clusters < clusters_needed) {
+        unsigned short next = fat16_read_fat_entry(current);
+        if (next < 2 || next >= 0xFFF8) break;
+        current = next;
+        clusters++;
+    }
+    
+    // Новый кластер помечаем занятым до поиска следующего,
+    // иначе fat16_find_free_cluster вернет его повторно
+    for (; clusters < clusters_needed; clusters++) {
         unsigned short next = fat16_find_free_cluster();
         if (!next) return 0;
         
+        fat16_write_fat_entry(next, 0xFFFF);
         fat16_write_fat_entry(current, next);
         current = next;
     }
     
-    fat16_write_fat_entry(current, 0xFFFF);
     return 1;
 }
 
@@ -189,40 +238,656 @@ static void fat16_free_cluster_chain(unsigned short start_cluster) {
     }
 }
 
-static fat16_dir_entry_t* fat16_find_file_entry(const char *filename) {
-    char name83[11];
-    filename_to_83(filename, name83);
-    
+// ==================== PAGE CACHE ====================
+// Страницы файлов по 4KB (ровно один кластер), ключ — (первый кластер файла,
+// номер страницы). fat16_map() возвращает указатели прямо в эти страницы.
+#define PAGE_CACHE_PAGES 256
+#define PAGE_HASH_SIZE 64
+
+typedef struct {
+    unsigned short file_cluster;   // Первый кластер файла (0 = слот свободен)
+    unsigned short cluster;        // Кластер на диске с данными страницы
+    unsigned int index;            // Номер страницы в файле
+    unsigned int last_used;
+    unsigned short map_count;
+    unsigned char dirty;
+    short hash_next;
+} cache_page_t;
+
+static unsigned char page_data[PAGE_CACHE_PAGES][FAT16_PAGE_SIZE];
+static cache_page_t pages[PAGE_CACHE_PAGES];
+static short page_hash[PAGE_HASH_SIZE];
+static int page_cache_ready = 0;
+static unsigned int page_clock = 0;
+
+static unsigned int page_hash_key(unsigned short file_cluster, unsigned int index) {
+    return (file_cluster * 31 + index) % PAGE_HASH_SIZE;
+}
+
+static void page_cache_init() {
+    for (int i = 0; i < PAGE_HASH_SIZE; i++) page_hash[i] = -1;
+    memset(pages, 0, sizeof(pages));
+    page_cache_ready = 1;
+}
+
+static unsigned int page_sector(cache_page_t *page) {
+    return data_start + (page->cluster - 2) * boot_sector.sectors_per_cluster;
+}
+
+static void page_unhash(int slot) {
+    cache_page_t *page = &pages[slot];
+    short *link = &page_hash[page_hash_key(page->file_cluster, page->index)];
+
+    while (*link != -1) {
+        if (*link == slot) {
+            *link = page->hash_next;
+            break;
+        }
+        link = &pages[*link].hash_next;
+    }
+    page->file_cluster = 0;
+}
+
+static void page_writeback(int slot) {
+    cache_page_t *page = &pages[slot];
+    if (page->file_cluster && page->dirty) {
+        blk_submit(BLK_WRITE, page_sector(page), boot_sector.sectors_per_cluster, page_data[slot], 0, 0);
+        page->dirty = 0;
+    }
+}
+
+static int page_lookup(unsigned short file_cluster, unsigned int index) {
+    short slot = page_hash[page_hash_key(file_cluster, index)];
+    while (slot != -1) {
+        if (pages[slot].file_cluster == file_cluster && pages[slot].index == index) return slot;
+        slot = pages[slot].hash_next;
+    }
+    return -1;
+}
+
+// Свободный слот или наименее используемая неотображенная чистая страница.
+// Измененные страницы остаются в кэше до fat16_msync или отмены правок
+static int page_evict() {
+    int victim = -1;
+    for (int i = 0; i < PAGE_CACHE_PAGES; i++) {
+        if (!pages[i].file_cluster) return i;
+        if (pages[i].map_count || pages[i].dirty) continue;
+        if (victim == -1 || pages[i].last_used < pages[victim].last_used) victim = i;
+    }
+
+    if (victim != -1) page_unhash(victim);
+    return victim;
+}
+
+static int page_get(unsigned short file_cluster, unsigned int index) {
+    if (!page_cache_ready) page_cache_init();
+
+    int slot = page_lookup(file_cluster, index);
+    if (slot != -1) return slot;
+
+    // Находим кластер страницы по цепочке FAT
+    unsigned short cluster = file_cluster;
+    for (unsigned int i = 0; i < index && cluster < 0xFFF8; i++) {
+        cluster = fat16_read_fat_entry(cluster);
+    }
+    if (cluster < 2 || cluster >= 0xFFF8) return -1;
+
+    slot = page_evict();
+    if (slot == -1) {
+        printf("FAT16: Page cache full, all pages mapped or modified\n");
+        return -1;
+    }
+
+    cache_page_t *page = &pages[slot];
+    page->file_cluster = file_cluster;
+    page->index = index;
+    page->cluster = cluster;
+    page->map_count = 0;
+    page->dirty = 0;
+
+    unsigned int key = page_hash_key(file_cluster, index);
+    page->hash_next = page_hash[key];
+    page_hash[key] = slot;
+
+    blk_submit(BLK_READ, page_sector(page), boot_sector.sectors_per_cluster, page_data[slot], 0, 0);
+    return slot;
+}
+
+// Записывает измененные страницы файла
+static void page_cache_writeback(unsigned short file_cluster) {
+    if (!page_cache_ready) return;
+
+    blk_plug();
+    for (int i = 0; i < PAGE_CACHE_PAGES; i++) {
+        if (pages[i].file_cluster == file_cluster) page_writeback(i);
+    }
+    blk_unplug();
+}
+
+// После изменения данных в обход кэша (0 = все файлы):
+// перечитываем отображенные страницы, остальные выбрасываем
+static void page_cache_refresh(unsigned short file_cluster) {
+    if (!page_cache_ready) return;
+
+    for (int i = 0; i < PAGE_CACHE_PAGES; i++) {
+        if (!pages[i].file_cluster) continue;
+        if (file_cluster && pages[i].file_cluster != file_cluster) continue;
+
+        if (pages[i].map_count) {
+            blk_submit(BLK_READ, page_sector(&pages[i]), boot_sector.sectors_per_cluster, page_data[i], 0, 0);
+        } else {
+            page_unhash(i);
+        }
+    }
+}
+
+// Выбрасывает страницы файла без записи (удаление файла, отмена правок)
+static void page_cache_drop(unsigned short file_cluster) {
+    if (!page_cache_ready) return;
+
+    for (int i = 0; i < PAGE_CACHE_PAGES; i++) {
+        if (pages[i].file_cluster == file_cluster) {
+            pages[i].dirty = 0;
+            if (!pages[i].map_count) page_unhash(i);
+        }
+    }
+}
+
+unsigned char *fat16_map(file_t *file, unsigned int offset, unsigned int length) {
+    if (!file->is_open || length == 0) return 0;
+    if (offset + length > file->size) return 0;
+
+    unsigned int index = offset / FAT16_PAGE_SIZE;
+    unsigned int page_offset = offset % FAT16_PAGE_SIZE;
+    if (page_offset + length > FAT16_PAGE_SIZE) return 0;  // Диапазон пересекает границу страницы
+    if (boot_sector.sectors_per_cluster * 512 != FAT16_PAGE_SIZE) return 0;
+
+    int slot = page_get(file->first_cluster, index);
+    if (slot == -1) return 0;
+
+    pages[slot].map_count++;
+    pages[slot].last_used = ++page_clock;
+    return page_data[slot] + page_offset;
+}
+
+void fat16_unmap(file_t *file, unsigned char *addr, int dirty) {
+    if (!page_cache_ready || addr < page_data[0] || addr >= page_data[PAGE_CACHE_PAGES]) return;
+
+    int slot = (addr - page_data[0]) / FAT16_PAGE_SIZE;
+    cache_page_t *page = &pages[slot];
+    if (page->file_cluster != file->first_cluster || page->map_count == 0) return;
+
+    if (dirty) page->dirty = 1;
+    page->map_count--;
+}
+
+int fat16_msync(file_t *file) {
+    page_cache_writeback(file->first_cluster);
+    return 1;
+}
+
+void fat16_discard_pages(file_t *file) {
+    page_cache_drop(file->first_cluster);
+}
+
+// ============ ДЛИННЫЕ ИМЕНА (VFAT LFN) И ИНДЕКС ИМЕН ============
+// Узел индекса соответствует слоту короткой записи в root_dir,
+// поэтому поиск по длинному имени не собирает LFN-цепочки заново
+#define NAME_HASH_BUCKETS 128
+
+typedef struct {
+    short lfn_slot;          // Первая LFN-запись или -1
+    unsigned char lfn_count;
+    short long_next;         // Цепочки хэш-таблиц
+    short short_next;
+    char long_name[FAT16_MAX_NAME + 1];  // Пусто, если LFN нет
+} name_node_t;
+
+static name_node_t name_nodes[FAT16_ROOT_ENTRIES];
+static short long_hash[NAME_HASH_BUCKETS];
+static short short_hash[NAME_HASH_BUCKETS];
+
+static fat16_dir_entry_t *dir_slot(int slot) {
+    return (fat16_dir_entry_t*)&root_dir[slot * 32];
+}
+
+static int tolower(int c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A' + 'a';
+    return c;
+}
+
+// Имена в FAT сравниваются без учета регистра
+static unsigned int long_name_hash(const char *name) {
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (unsigned char)tolower(*name++)) * 16777619u;
+    }
+    return hash % NAME_HASH_BUCKETS;
+}
+
+static unsigned int short_name_hash(const char *name83) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < 11; i++) {
+        hash = (hash ^ (unsigned char)name83[i]) * 16777619u;
+    }
+    return hash % NAME_HASH_BUCKETS;
+}
+
+static int names_equal_nocase(const char *a, const char *b) {
+    while (*a && tolower(*a) == tolower(*b)) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+static unsigned char lfn_checksum(const char *name83) {
+    unsigned char sum = 0;
+    for (int i = 0; i < 11; i++) {
+        sum = ((sum & 1) << 7) + (sum >> 1) + (unsigned char)name83[i];
+    }
+    return sum;
+}
+
+static int is_83_char(char c) {
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) return 1;
+    return strchr("!#$%&'()-@^_`{}~", c) != 0 && c != '\0';
+}
+
+// Имя представимо в 8.3 без потерь (регистр не учитывается, как и раньше)
+static int name_fits_83(const char *name) {
+    int len = 0, ext_len = 0, dot = 0;
+
+    for (const char *p = name; *p; p++) {
+        if (*p == '.') {
+            if (dot || len == 0) return 0;
+            dot = 1;
+        } else if (!is_83_char(*p)) {
+            return 0;
+        } else if (dot) {
+            if (++ext_len > 3) return 0;
+        } else {
+            if (++len > 8) return 0;
+        }
+    }
+    return len > 0 && (!dot || ext_len > 0);
+}
+
+// UTF-8 -> UTF-16, возвращает число единиц или -1
+static int utf8_to_utf16(const char *src, unsigned short *dst, int max_units) {
+    const unsigned char *s = (const unsigned char*)src;
+    int units = 0;
+
+    while (*s) {
+        unsigned int cp;
+        int extra;
+
+        if (*s < 0x80)      { cp = *s; extra = 0; }
+        else if (*s < 0xC0) return -1;
+        else if (*s < 0xE0) { cp = *s & 0x1F; extra = 1; }
+        else if (*s < 0xF0) { cp = *s & 0x0F; extra = 2; }
+        else if (*s < 0xF8) { cp = *s & 0x07; extra = 3; }
+        else return -1;
+        s++;
+
+        for (int i = 0; i < extra; i++, s++) {
+            if ((*s & 0xC0) != 0x80) return -1;
+            cp = (cp << 6) | (*s & 0x3F);
+        }
+
+        if (cp >= 0x10000) {
+            if (cp > 0x10FFFF || units + 2 > max_units) return -1;
+            cp -= 0x10000;
+            dst[units++] = 0xD800 | (cp >> 10);
+            dst[units++] = 0xDC00 | (cp & 0x3FF);
+        } else {
+            if (units + 1 > max_units) return -1;
+            dst[units++] = cp;
+        }
+    }
+    return units;
+}
+
+// UTF-16 -> UTF-8, возвращает длину или -1, если имя не помещается
+static int utf16_to_utf8(const unsigned short *src, int units, char *dst, int size) {
+    int len = 0;
+
+    for (int i = 0; i < units; i++) {
+        unsigned int cp = src[i];
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 1 < units &&
+            src[i + 1] >= 0xDC00 && src[i + 1] < 0xE000) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (src[++i] - 0xDC00);
+        }
+
+        if (cp < 0x80) {
+            if (len + 1 >= size) return -1;
+            dst[len++] = cp;
+        } else if (cp < 0x800) {
+            if (len + 2 >= size) return -1;
+            dst[len++] = 0xC0 | (cp >> 6);
+            dst[len++] = 0x80 | (cp & 0x3F);
+        } else if (cp < 0x10000) {
+            if (len + 3 >= size) return -1;
+            dst[len++] = 0xE0 | (cp >> 12);
+            dst[len++] = 0x80 | ((cp >> 6) & 0x3F);
+            dst[len++] = 0x80 | (cp & 0x3F);
+        } else {
+            if (len + 4 >= size) return -1;
+            dst[len++] = 0xF0 | (cp >> 18);
+            dst[len++] = 0x80 | ((cp >> 12) & 0x3F);
+            dst[len++] = 0x80 | ((cp >> 6) & 0x3F);
+            dst[len++] = 0x80 | (cp & 0x3F);
+        }
+    }
+    dst[len] = '\0';
+    return len;
+}
+
+// Символ i имени внутри LFN-записи. Поля упакованной записи не выровнены,
+// поэтому доступ идет через memcpy, а не через указатель на поле
+static unsigned char *lfn_char_bytes(fat16_lfn_entry_t *lfn, int i) {
+    unsigned char *entry = (unsigned char*)lfn;
+    if (i < 5) return entry + __builtin_offsetof(fat16_lfn_entry_t, name1) + i * 2;
+    if (i < 11) return entry + __builtin_offsetof(fat16_lfn_entry_t, name2) + (i - 5) * 2;
+    return entry + __builtin_offsetof(fat16_lfn_entry_t, name3) + (i - 11) * 2;
+}
+
+static unsigned short lfn_get_char(fat16_lfn_entry_t *lfn, int i) {
+    unsigned short ch;
+    memcpy(&ch, lfn_char_bytes(lfn, i), 2);
+    return ch;
+}
+
+static void lfn_set_char(fat16_lfn_entry_t *lfn, int i, unsigned short ch) {
+    memcpy(lfn_char_bytes(lfn, i), &ch, 2);
+}
+
+static int short_name_taken(const char *name83) {
+    for (short s = short_hash[short_name_hash(name83)]; s >= 0; s = name_nodes[s].short_next) {
+        if (memcmp(dir_slot(s)->filename, name83, 11) == 0) return 1;
+    }
+    return 0;
+}
+
+static void short_name_part(const char *src, int src_len, char *dst, int max) {
+    int n = 0;
+    for (int i = 0; i < src_len && n < max; i++) {
+        unsigned char c = src[i];
+        if (c == ' ' || c == '.') continue;
+        if (c >= 0x80) {
+            if (c >= 0xC0) dst[n++] = '_';  // Один '_' на символ UTF-8
+            continue;
+        }
+        dst[n++] = is_83_char(c) ? toupper(c) : '_';
+    }
+}
+
+// Короткий псевдоним вида NAME~N.EXT, уникальный в каталоге
+static int make_short_name(const char *long_name, char *name83) {
+    while (*long_name == '.' || *long_name == ' ') long_name++;
+
+    int len = strlen(long_name);
+    int dot = -1;
+    for (int i = len - 1; i > 0; i--) {
+        if (long_name[i] == '.') {
+            dot = i;
+            break;
+        }
+    }
+
+    char base[8];
+    memset(base, ' ', 8);
+    short_name_part(long_name, dot < 0 ? len : dot, base, 8);
+    if (base[0] == ' ') base[0] = '_';
+
+    memset(name83, ' ', 11);
+    if (dot >= 0) {
+        short_name_part(long_name + dot + 1, len - dot - 1, name83 + 8, 3);
+    }
+
+    int base_len = 8;
+    while (base_len > 0 && base[base_len - 1] == ' ') base_len--;
+
+    for (unsigned int n = 1; n < 1000000; n++) {
+        char tail[8];
+        int tail_len = 0;
+        for (unsigned int v = n; v; v /= 10) tail[tail_len++] = '0' + v % 10;
+        tail[tail_len++] = '~';
+
+        int keep = base_len;
+        if (keep > 8 - tail_len) keep = 8 - tail_len;
+
+        memset(name83, ' ', 8);
+        memcpy(name83, base, keep);
+        for (int i = 0; i < tail_len; i++) {
+            name83[keep + i] = tail[tail_len - 1 - i];
+        }
+
+        if (!short_name_taken(name83)) return 1;
+    }
+    return 0;
+}
+
+static void name_index_add(int slot, int lfn_slot, int lfn_count, const char *long_name) {
+    name_node_t *node = &name_nodes[slot];
+    unsigned int bucket = short_name_hash(dir_slot(slot)->filename);
+
+    node->lfn_slot = lfn_slot;
+    node->lfn_count = lfn_count;
+    node->short_next = short_hash[bucket];
+    short_hash[bucket] = slot;
+
+    node->long_name[0] = '\0';
+    node->long_next = -1;
+    if (long_name && long_name[0]) {
+        strcpy(node->long_name, long_name);
+        bucket = long_name_hash(long_name);
+        node->long_next = long_hash[bucket];
+        long_hash[bucket] = slot;
+    }
+}
+
+static void name_chain_unlink(short *head, int slot, int use_long) {
+    while (*head >= 0) {
+        short *next = use_long ? &name_nodes[*head].long_next : &name_nodes[*head].short_next;
+        if (*head == slot) {
+            *head = *next;
+            return;
+        }
+        head = next;
+    }
+}
+
+static void name_index_remove(int slot) {
+    name_node_t *node = &name_nodes[slot];
+    name_chain_unlink(&short_hash[short_name_hash(dir_slot(slot)->filename)], slot, 0);
+    if (node->long_name[0]) {
+        name_chain_unlink(&long_hash[long_name_hash(node->long_name)], slot, 1);
+    }
+}
+
+// Полная перестройка индекса: после загрузки или форматирования
+static void name_index_rebuild() {
+    unsigned short units[FAT16_MAX_NAME];
+    char long_name[FAT16_MAX_NAME + 1];
+    int lfn_slot = -1, lfn_count = 0, lfn_expect = 0;
+    unsigned char lfn_sum = 0;
+
+    for (int i = 0; i < NAME_HASH_BUCKETS; i++) {
+        long_hash[i] = -1;
+        short_hash[i] = -1;
+    }
+
     for (int i = 0; i < boot_sector.root_entries; i++) {
-        fat16_dir_entry_t *entry = (fat16_dir_entry_t*)&root_dir[i * 32];
-        
+        fat16_dir_entry_t *entry = dir_slot(i);
+
         if (entry->filename[0] == 0x00) break;
-        if (entry->filename[0] == 0xE5) continue;
-        if (entry->attributes & 0x08 || entry->attributes & 0x10) continue;
-        
-        int match = 1;
-        for (int j = 0; j < 11; j++) {
-            if (entry->filename[j] != name83[j]) {
-                match = 0;
-                break;
+        if ((unsigned char)entry->filename[0] == 0xE5) {
+            lfn_slot = -1;
+            continue;
+        }
+
+        if (entry->attributes == FAT16_ATTR_LFN) {
+            fat16_lfn_entry_t *lfn = (fat16_lfn_entry_t*)entry;
+            int order = lfn->order & 0x3F;
+
+            if (lfn->order & FAT16_LFN_LAST) {
+                lfn_slot = i;
+                lfn_count = order;
+                lfn_expect = order;
+                lfn_sum = lfn->checksum;
+                if (order == 0 || order * FAT16_LFN_CHARS > FAT16_MAX_NAME + FAT16_LFN_CHARS) {
+                    lfn_slot = -1;
+                }
+            } else if (lfn_slot < 0 || order != lfn_expect || lfn->checksum != lfn_sum) {
+                lfn_slot = -1;
+            }
+            if (lfn_slot < 0) continue;
+
+            for (int c = 0; c < FAT16_LFN_CHARS; c++) {
+                int pos = (order - 1) * FAT16_LFN_CHARS + c;
+                if (pos < FAT16_MAX_NAME) units[pos] = lfn_get_char(lfn, c);
             }
+            lfn_expect--;
+            continue;
         }
-        
-        if (match) return entry;
+
+        if (entry->attributes & 0x08 || entry->attributes & 0x10) {
+            lfn_slot = -1;
+            continue;
+        }
+
+        const char *name = 0;
+        if (lfn_slot >= 0 && lfn_expect == 0 && lfn_checksum(entry->filename) == lfn_sum) {
+            int unit_count = 0;
+            int max_units = lfn_count * FAT16_LFN_CHARS;
+            if (max_units > FAT16_MAX_NAME) max_units = FAT16_MAX_NAME;
+            while (unit_count < max_units && units[unit_count] != 0x0000) unit_count++;
+
+            if (utf16_to_utf8(units, unit_count, long_name, sizeof(long_name)) > 0) {
+                name = long_name;
+            }
+        }
+
+        if (name) {
+            name_index_add(i, lfn_slot, lfn_count, name);
+        } else {
+            name_index_add(i, -1, 0, 0);
+        }
+        lfn_slot = -1;
     }
-    
-    return 0;
 }
 
-static fat16_dir_entry_t* fat16_find_free_entry() {
+static int fat16_lookup_slot(const char *filename) {
+    if (name_fits_83(filename)) {
+        char name83[11];
+        filename_to_83(filename, name83);
+        for (short s = short_hash[short_name_hash(name83)]; s >= 0; s = name_nodes[s].short_next) {
+            if (memcmp(dir_slot(s)->filename, name83, 11) == 0) return s;
+        }
+    }
+
+    for (short s = long_hash[long_name_hash(filename)]; s >= 0; s = name_nodes[s].long_next) {
+        if (names_equal_nocase(name_nodes[s].long_name, filename)) return s;
+    }
+    return -1;
+}
+
+static fat16_dir_entry_t* fat16_find_file_entry(const char *filename) {
+    int slot = fat16_lookup_slot(filename);
+    return slot >= 0 ? dir_slot(slot) : 0;
+}
+
+// Ищет count подряд идущих свободных записей
+static int fat16_find_free_run(int count) {
+    int run = 0;
     for (int i = 0; i < boot_sector.root_entries; i++) {
-        fat16_dir_entry_t *entry = (fat16_dir_entry_t*)&root_dir[i * 32];
-        
-        if (entry->filename[0] == 0x00 || entry->filename[0] == 0xE5) {
-            return entry;
+        fat16_dir_entry_t *entry = dir_slot(i);
+
+        if (entry->filename[0] == 0x00 || (unsigned char)entry->filename[0] == 0xE5) {
+            if (++run == count) return i - count + 1;
+        } else {
+            run = 0;
         }
     }
-    return 0;
+    return -1;
+}
+
+// Записывает LFN-цепочку и короткую запись по образцу proto,
+// возвращает слот короткой записи или -1
+static int fat16_place_name(const char *filename, const fat16_dir_entry_t *proto) {
+    unsigned short units[FAT16_MAX_NAME];
+    char name83[11];
+    int unit_count = 0;
+    int lfn_count = 0;
+
+    if (name_fits_83(filename)) {
+        filename_to_83(filename, name83);
+    } else {
+        if (strlen(filename) > FAT16_MAX_NAME) {
+            printf("FAT16: Name too long: %s\n", filename);
+            return -1;
+        }
+        unit_count = utf8_to_utf16(filename, units, FAT16_MAX_NAME);
+        if (unit_count <= 0 || !make_short_name(filename, name83)) {
+            printf("FAT16: Invalid file name: %s\n", filename);
+            return -1;
+        }
+        lfn_count = (unit_count + FAT16_LFN_CHARS - 1) / FAT16_LFN_CHARS;
+    }
+
+    int first = fat16_find_free_run(lfn_count + 1);
+    if (first < 0) {
+        printf("FAT16: Directory full\n");
+        return -1;
+    }
+
+    // Части имени идут на диске в обратном порядке
+    unsigned char sum = lfn_checksum(name83);
+    for (int k = 0; k < lfn_count; k++) {
+        fat16_lfn_entry_t *lfn = (fat16_lfn_entry_t*)dir_slot(first + k);
+        int order = lfn_count - k;
+
+        memset(lfn, 0, sizeof(fat16_lfn_entry_t));
+        lfn->order = order | (k == 0 ? FAT16_LFN_LAST : 0);
+        lfn->attributes = FAT16_ATTR_LFN;
+        lfn->checksum = sum;
+
+        for (int c = 0; c < FAT16_LFN_CHARS; c++) {
+            int pos = (order - 1) * FAT16_LFN_CHARS + c;
+            unsigned short ch = 0xFFFF;
+            if (pos < unit_count) ch = units[pos];
+            else if (pos == unit_count) ch = 0x0000;
+            lfn_set_char(lfn, c, ch);
+        }
+    }
+
+    int slot = first + lfn_count;
+    fat16_dir_entry_t *entry = dir_slot(slot);
+    memcpy(entry, proto, sizeof(fat16_dir_entry_t));
+    memcpy(entry->filename, name83, 11);
+
+    name_index_add(slot, lfn_count ? first : -1, lfn_count, lfn_count ? filename : 0);
+    needs_sync = 1;
+    return slot;
+}
+
+// Помечает удаленными короткую запись и ее LFN-цепочку
+static void fat16_remove_name(int slot) {
+    name_node_t *node = &name_nodes[slot];
+
+    name_index_remove(slot);
+    for (int k = 0; k < node->lfn_count; k++) {
+        dir_slot(node->lfn_slot + k)->filename[0] = 0xE5;
+    }
+    dir_slot(slot)->filename[0] = 0xE5;
+    needs_sync = 1;
+}
+
+static const char *fat16_display_name(int slot, char *buffer) {
+    if (name_nodes[slot].long_name[0]) return name_nodes[slot].long_name;
+    name83_to_filename(dir_slot(slot)->filename, buffer);
+    return buffer;
 }
 
 // Основные функции FAT16
@@ -275,7 +940,15 @@ int fat16_init() {
     printf("FAT16: FAT at sector %d, Root at %d, Data at %d\n", fat_start, root_start, data_start);
     printf("FAT16: Total clusters: %d\n", total_clusters);
     
+    // Записываем загрузочный сектор, чтобы fat16_load_from_disk нашел ФС
+    memset(file_buffer, 0, sizeof(file_buffer));
+    memcpy(file_buffer, &boot_sector, sizeof(boot_sector));
+    file_buffer[510] = 0x55;
+    file_buffer[511] = 0xAA;
+    disk_write_sector(0, file_buffer);
+    
     memset(fat_table, 0, sizeof(fat_table));
+    fat16_mark_fat_dirty_all();
     fat16_write_fat_entry(0, 0xFFF8);
     fat16_write_fat_entry(1, 0xFFFF);
     
@@ -318,6 +991,7 @@ int fat16_init() {
     memcpy(file_buffer, test_data, strlen(test_data));
     disk_write_sector(cluster3_sector, file_buffer);
     fat16_write_fat_entry(3, 0xFFFF);
+    name_index_rebuild();
     
     // Синхронизируем начальное состояние на диск
     fat16_sync();
@@ -329,13 +1003,18 @@ int fat16_init() {
 int fat16_format() {
     printf("FAT16: Formatting disk...\n");
     
+    // Кэшированные страницы старых файлов больше недействительны
+    if (page_cache_ready) page_cache_init();
+    
     // Очищаем FAT таблицу
     memset(fat_table, 0, sizeof(fat_table));
+    fat16_mark_fat_dirty_all();
     fat16_write_fat_entry(0, 0xFFF8);
     fat16_write_fat_entry(1, 0xFFFF);
     
     // Очищаем корневой каталог
     memset(root_dir, 0, sizeof(root_dir));
+    name_index_rebuild();
     
     // Очищаем данные
     memset(file_buffer, 0, sizeof(file_buffer));
@@ -362,11 +1041,11 @@ int fat16_list_files() {
         fat16_dir_entry_t *entry = (fat16_dir_entry_t*)&root_dir[i * 32];
         
         if (entry->filename[0] == 0x00) break;
-        if (entry->filename[0] == 0xE5) continue;
+        if ((unsigned char)entry->filename[0] == 0xE5) continue;
         if (entry->attributes & 0x08 || entry->attributes & 0x10) continue;
         
-        char filename[13];
-        name83_to_filename(entry->filename, filename);
+        char short_name[13];
+        const char *filename = fat16_display_name(i, short_name);
         
         int day = entry->date & 0x1F;
         int month = (entry->date >> 5) & 0x0F;
@@ -428,6 +1107,9 @@ int fat16_read(file_t *file, char *buffer, unsigned int size) {
     if (!file->is_open || file->mode != 0) return 0;
     if (file->current_position >= file->size) return 0;
     
+    // Измененные через fat16_map страницы должны попасть на диск до чтения
+    page_cache_writeback(file->first_cluster);
+    
     unsigned int bytes_read = 0;
     unsigned int sectors_per_cluster = boot_sector.sectors_per_cluster;
     
@@ -466,6 +1148,8 @@ int fat16_read(file_t *file, char *buffer, unsigned int size) {
 int fat16_write(file_t *file, const char *buffer, unsigned int size) {
     if (!file->is_open || file->mode == 0) return 0;
     
+    page_cache_writeback(file->first_cluster);
+    
     unsigned int bytes_written = 0;
     unsigned int sectors_per_cluster = boot_sector.sectors_per_cluster;
     
@@ -527,6 +1211,7 @@ int fat16_write(file_t *file, const char *buffer, unsigned int size) {
         }
     }
     
+    page_cache_refresh(file->first_cluster);
     return bytes_written;
 }
 
@@ -536,28 +1221,23 @@ int fat16_create(const char *filename) {
         return 0;
     }
     
-    fat16_dir_entry_t *entry = fat16_find_free_entry();
-    if (!entry) {
-        printf("FAT16: Directory full\n");
-        return 0;
-    }
-    
     unsigned short cluster = fat16_find_free_cluster();
     if (!cluster) {
         printf("FAT16: No free clusters\n");
         return 0;
     }
     
-    char name83[11];
-    filename_to_83(filename, name83);
+    fat16_dir_entry_t entry;
+    memset(&entry, 0, sizeof(fat16_dir_entry_t));
+    entry.attributes = 0x20;
+    entry.starting_cluster = cluster;
+    entry.file_size = 0;
+    entry.time = 0x8000;
+    entry.date = 0x4A97;
     
-    memset(entry, 0, sizeof(fat16_dir_entry_t));
-    memcpy(entry->filename, name83, 11);
-    entry->attributes = 0x20;
-    entry->starting_cluster = cluster;
-    entry->file_size = 0;
-    entry->time = 0x8000;
-    entry->date = 0x4A97;
+    if (fat16_place_name(filename, &entry) < 0) {
+        return 0;
+    }
     
     fat16_write_fat_entry(cluster, 0xFFFF);
     needs_sync = 1;
@@ -567,15 +1247,16 @@ int fat16_create(const char *filename) {
 }
 
 int fat16_delete(const char *filename) {
-    fat16_dir_entry_t *entry = fat16_find_file_entry(filename);
-    if (!entry) {
+    int slot = fat16_lookup_slot(filename);
+    if (slot < 0) {
         printf("FAT16: File not found: %s\n", filename);
         return 0;
     }
     
+    fat16_dir_entry_t *entry = dir_slot(slot);
+    page_cache_drop(entry->starting_cluster);
     fat16_free_cluster_chain(entry->starting_cluster);
-    entry->filename[0] = 0xE5;
-    needs_sync = 1;
+    fat16_remove_name(slot);
     
     printf("FAT16: Deleted '%s'\n", filename);
     return 1;
@@ -605,8 +1286,8 @@ unsigned int fat16_get_total_space() {
 }
 
 int fat16_rename(const char *oldname, const char *newname) {
-    fat16_dir_entry_t *entry = fat16_find_file_entry(oldname);
-    if (!entry) {
+    int slot = fat16_lookup_slot(oldname);
+    if (slot < 0) {
         printf("FAT16: File not found: %s\n", oldname);
         return 0;
     }
@@ -616,10 +1297,13 @@ int fat16_rename(const char *oldname, const char *newname) {
         return 0;
     }
     
-    char name83[11];
-    filename_to_83(newname, name83);
-    memcpy(entry->filename, name83, 11);
-    needs_sync = 1;
+    // Новое имя может занять другое число записей, поэтому запись переносится
+    fat16_dir_entry_t entry;
+    memcpy(&entry, dir_slot(slot), sizeof(fat16_dir_entry_t));
+    if (fat16_place_name(newname, &entry) < 0) {
+        return 0;
+    }
+    fat16_remove_name(slot);
     
     printf("FAT16: Renamed '%s' to '%s'\n", oldname, newname);
     return 1;
@@ -631,4 +1315,10 @@ int fat16_get_file_info(const char *filename, fat16_dir_entry_t *info) {
     
     memcpy(info, entry, sizeof(fat16_dir_entry_t));
     return 1;
-}
\ No newline at end of file
+}
+
+const char *fat16_get_long_name(const char *filename) {
+    int slot = fat16_lookup_slot(filename);
+    if (slot < 0 || !name_nodes[slot].long_name[0]) return 0;
+    return name_nodes[slot].long_name;
+}
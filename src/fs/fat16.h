@@ -9,6 +9,11 @@
 #define FAT16_SECTOR_SIZE 512
 #define FAT16_ROOT_ENTRIES 512
 #define FAT16_CLUSTER_SIZE 4096  // 8 sectors * 512 bytes
+#define FAT16_PAGE_SIZE FAT16_CLUSTER_SIZE  // Page cache granularity
+#define FAT16_MAX_NAME 255      // Длинное имя (VFAT LFN) в байтах UTF-8
+#define FAT16_LFN_CHARS 13      // Символов UTF-16 в одной LFN-записи
+#define FAT16_ATTR_LFN 0x0F
+#define FAT16_LFN_LAST 0x40     // Флаг последней (первой на диске) LFN-записи
 
 // FAT16 Boot Sector
 typedef struct {
@@ -47,9 +52,21 @@ typedef struct {
     unsigned int file_size;
 } __attribute__((packed)) fat16_dir_entry_t;
 
+// VFAT Long File Name Entry (предшествует короткой записи, в обратном порядке)
+typedef struct {
+    unsigned char order;        // Номер части, FAT16_LFN_LAST у последней
+    unsigned short name1[5];
+    unsigned char attributes;   // Всегда FAT16_ATTR_LFN
+    unsigned char type;
+    unsigned char checksum;     // Контрольная сумма короткого имени
+    unsigned short name2[6];
+    unsigned short starting_cluster;  // Всегда 0
+    unsigned short name3[2];
+} __attribute__((packed)) fat16_lfn_entry_t;
+
 // File handle
 typedef struct {
-    char filename[13];
+    char filename[FAT16_MAX_NAME + 1];
     unsigned int size;
     unsigned short first_cluster;
     unsigned int current_position;
@@ -73,6 +90,7 @@ unsigned int fat16_get_free_space();
 unsigned int fat16_get_total_space();
 int fat16_rename(const char *oldname, const char *newname);
 int fat16_get_file_info(const char *filename, fat16_dir_entry_t *info);
+const char *fat16_get_long_name(const char *filename);  // 0, если у файла нет LFN
 
 // НОВЫЕ ФУНКЦИИ СИНХРОНИЗАЦИИ
 void fat16_sync();  // Синхронизировать все изменения на диск
@@ -80,4 +98,14 @@ void fat16_sync_fat();  // Синхронизировать FAT таблицу
 void fat16_sync_root(); // Синхронизировать корневой каталог
 int fat16_load_from_disk();  // Загрузить файловую систему с диска
 
+// PAGE CACHE / ОТОБРАЖЕНИЕ ФАЙЛОВ
+// Диапазон не должен пересекать границу страницы FAT16_PAGE_SIZE. Работает,
+// только если кластер тома равен FAT16_PAGE_SIZE, иначе возвращает 0.
+// Правки попадают на диск при fat16_msync (или чтении/записи того же файла),
+// но не при fat16_sync
+unsigned char *fat16_map(file_t *file, unsigned int offset, unsigned int length);
+void fat16_unmap(file_t *file, unsigned char *addr, int dirty);
+int fat16_msync(file_t *file);          // Записать измененные страницы файла
+void fat16_discard_pages(file_t *file); // Отбросить несохраненные изменения
+
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 // src/game/snake.c
 #include "snake.h"
 #include "../../drivers/text_output.h"
+#include "../../drivers/gpu.h"
 
 // Function declarations
 void set_cursor(int x, int y);
@@ -263,6 +264,7 @@ void snake_game_loop(void) {
             snake_draw_board();
             snake_draw_snake();
             snake_draw_food();
+            gpu_swap_buffers();
         }
         
         // Небольшая задержка для стабильности
@@ -1,6 +1,7 @@
 #include "tetris.h"
 #include "../../lib/string.h"
 #include "../../drivers/text_output.h"
+#include "../../drivers/gpu.h"
 
 static tetris_game game;
 static unsigned long game_timer = 0;
@@ -496,6 +497,9 @@ void tetris_game_loop(void) {
             }
         }
         
+        // Показываем кадр после ввода и падения фигуры
+        gpu_swap_buffers();
+        
         // Небольшая задержка для стабильности
         for (volatile int i = 0; i < 1000; i++);
     }
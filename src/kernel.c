@@ -1,22 +1,53 @@
 // kernel.c - ОБНОВЛЕННЫЙ
 #include "drivers/screen.h"
+#include "drivers/gpu.h"
 #include "drivers/text_output.h"
+#include "drivers/widget.h"
+#include "drivers/frame.h"
 #include "shell/shell.h"
 #include "fs/fat16.h"
 #include "fs/disk.h"
 #include "drivers/usb/usb_driver.h"
 #include "drivers/wifi/wifi.h"
 #include "lib/error_handler.h"
+#include "lib/cpu.h"
+#include "lib/pages.h"
+#include "lib/matrix.h"
+#include "drivers/blit.h"
+#include "multiboot.h"
 
-void kernel_main() {
+// safe_execute expects 0 on success, the disk/FAT16 layer returns 1
+static int kernel_disk_init(void) {
+    return disk_init() ? 0 : 1;
+}
+
+static int kernel_fat16_init(void) {
+    return fat16_init() ? 0 : 1;
+}
+
+void kernel_main(uint32_t magic, uint32_t multiboot_info) {
     // Initialize error handling
     reset_error_count();
     
+    // Boot information (modules, framebuffer) from GRUB/QEMU
+    multiboot_init(magic, multiboot_info);
+    
+    // Page frames for window surfaces and other large buffers
+    pages_init();
+    
+    // SSE must be enabled before the blitter and the matrix library select
+    // their kernels
+    cpu_init();
+    blit_init();
+    matrix_init();
+    
     // First try basic text output
     clear_screen();
     printf("MyOS Kernel Starting...\n");
     printf("Built-in error handling enabled\n");
     printf("Error counter initialized\n");
+    cpu_print_features();
+    printf("Memory: %u KB in page frames\n", pages_free_count() * (PAGE_SIZE / 1024));
     
     // Initialize framebuffer graphics with error handling
     printf("Initializing framebuffer...\n");
@@ -26,8 +57,18 @@ void kernel_main() {
         // Continue with text mode if framebuffer fails - don't crash
     } else {
         printf("SUCCESS: Framebuffer initialized successfully\n");
+        printf("Framebuffer: %dx%d, %d bpp, pitch %d\n", framebuffer_width, framebuffer_height,
+               framebuffer_format.bpp, framebuffer_pitch);
+    }
+    
+    // Display adapter: Bochs/QEMU BGA allows mode changes and page flipping
+    if (!gpu_init()) {
+        handle_error("No display adapter, graphics output disabled", ERROR_WARNING);
     }
     
+    // Desktop repaints are batched into at most FRAME_RATE composites per second
+    frame_init();
+    
     // Create desktop with error handling
     printf("Creating desktop environment...\n");
     desktop_t* desktop = create_desktop();
@@ -43,10 +84,10 @@ void kernel_main() {
     
     // Initialize disk and filesystem with error handling
     printf("Initializing disk subsystem...\n");
-    if (safe_execute(disk_init, "Disk initialization") != 0) {
+    if (safe_execute(kernel_disk_init, "Disk initialization") != 0) {
         handle_error("Disk operations will be unavailable", ERROR_INFO);
     } else {
-        if (safe_execute(fat16_init, "FAT16 filesystem initialization") != 0) {
+        if (safe_execute(kernel_fat16_init, "FAT16 filesystem initialization") != 0) {
             handle_error("Filesystem operations will be limited", ERROR_INFO);
         }
     }
@@ -67,10 +108,9 @@ void kernel_main() {
     window_t* welcome_window = create_window(100, 100, 400, 300, "Welcome to MyOS", WINDOW_FLAG_DECORATED);
     if (welcome_window) {
         // Add some content to the window
-        draw_string(20, 50, "Welcome to MyOS!", COLOR_WHITE);
-        draw_string(20, 70, "This is a framebuffer-based GUI.", COLOR_WHITE);
-        draw_string(20, 90, "Click windows to interact.", COLOR_WHITE);
-        window_paint(welcome_window);
+        widget_create_label(welcome_window, 20, 50, 360, 8, "Welcome to MyOS!", COLOR_BLACK, COLOR_LIGHT_GRAY);
+        widget_create_label(welcome_window, 20, 70, 360, 8, "This is a framebuffer-based GUI.", COLOR_BLACK, COLOR_LIGHT_GRAY);
+        widget_create_label(welcome_window, 20, 90, 360, 8, "Click windows to interact.", COLOR_BLACK, COLOR_LIGHT_GRAY);
         printf("Welcome window created successfully\n");
     } else {
         handle_error("Could not create welcome window", ERROR_WARNING);
@@ -78,9 +118,8 @@ void kernel_main() {
     
     window_t* terminal_window = create_window(150, 150, 350, 250, "Terminal", WINDOW_FLAG_DECORATED);
     if (terminal_window) {
-        draw_string(20, 50, "Terminal Window", COLOR_WHITE);
-        draw_string(20, 70, "Ready for input...", COLOR_WHITE);
-        window_paint(terminal_window);
+        widget_create_label(terminal_window, 20, 50, 310, 8, "Terminal Window", COLOR_BLACK, COLOR_LIGHT_GRAY);
+        widget_create_label(terminal_window, 20, 70, 310, 8, "Ready for input...", COLOR_BLACK, COLOR_LIGHT_GRAY);
         printf("Terminal window created successfully\n");
     } else {
         handle_error("Could not create terminal window", ERROR_WARNING);
@@ -88,7 +127,9 @@ void kernel_main() {
     
     // Draw initial desktop
     printf("Rendering desktop...\n");
+    widget_flush();
     desktop_paint(desktop);
+    frame_flush();
     printf("Desktop rendered successfully\n");
     
     // Show final status
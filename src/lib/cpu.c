@@ -0,0 +1,199 @@
+// src/lib/cpu.c - CPU feature detection, FPU/SSE state and TSC timing
+#include "cpu.h"
+#include "string.h"
+#include "../drivers/text_output.h"
+
+#define PIT_FREQUENCY 1193182
+#define CALIBRATE_MS 10
+
+#define CR0_MP (1 << 1)     // WAIT honors TS
+#define CR0_EM (1 << 2)     // x87 emulation
+#define CR0_TS (1 << 3)     // Task switched: next FPU use faults
+#define CR0_NE (1 << 5)     // Native x87 error reporting (no IRQ 13)
+#define CR4_OSFXSR (1 << 9)
+#define CR4_OSXMMEXCPT (1 << 10)
+
+// Defaults (all exceptions masked, round to nearest) plus flush-to-zero and
+// denormals-are-zero: denormal operands take a microcode assist per operation
+#define MXCSR_DEFAULT 0x1F80
+#define MXCSR_FTZ 0x8000
+#define MXCSR_DAZ 0x0040
+#define FXSAVE_MXCSR_MASK 28
+
+static uint32_t features = 0;
+static uint32_t tsc_khz = 0;
+static int tsc_calibrated = 0;
+static cpu_fpu_state_t initial_fpu_state;
+
+static inline void outb(uint16_t port, uint8_t value) {
+    asm volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    asm volatile ("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static inline void cpuid(uint32_t leaf, uint32_t* a, uint32_t* b, uint32_t* c, uint32_t* d) {
+    asm volatile ("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+// CPUID exists if the ID flag (bit 21) in EFLAGS can be toggled
+static int cpuid_supported(void) {
+    uint32_t before, after;
+    asm volatile (
+        "pushfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl $0x200000, %0\n\t"
+        "pushl %0\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "popfl"
+        : "=&r"(after), "=&r"(before));
+    return ((before ^ after) & 0x200000) != 0;
+}
+
+static void init_fpu(void) {
+    uint32_t cr0;
+
+    asm volatile ("movl %%cr0, %0" : "=r"(cr0));
+    cr0 = (cr0 & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE;
+    asm volatile ("movl %0, %%cr0" : : "r"(cr0));
+
+    asm volatile ("fninit");
+}
+
+static void enable_sse(void) {
+    uint32_t cr4;
+
+    asm volatile ("movl %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    asm volatile ("movl %0, %%cr4" : : "r"(cr4));
+
+    // DAZ exists only if the MXCSR mask FXSAVE reports has it (0 = old default)
+    uint32_t mask;
+    cpu_fpu_save(&initial_fpu_state);
+    memcpy(&mask, &initial_fpu_state.data[FXSAVE_MXCSR_MASK], 4);
+    if (mask == 0) mask = 0xFFBF;
+
+    uint32_t mxcsr = (MXCSR_DEFAULT | MXCSR_FTZ | MXCSR_DAZ) & mask;
+    asm volatile ("ldmxcsr %0" : : "m"(mxcsr));
+}
+
+static void detect_features(void) {
+    uint32_t a, b, c, d;
+
+    if (!cpuid_supported()) return;
+
+    cpuid(0, &a, &b, &c, &d);
+    if (a < 1) return;
+
+    cpuid(1, &a, &b, &c, &d);
+    if (d & (1 << 4))  features |= CPU_FEATURE_TSC;
+    if (d & (1 << 24)) features |= CPU_FEATURE_FXSR;
+    // SSE needs FXSR to be enabled through CR4
+    if ((d & (1 << 25)) && (d & (1 << 24))) {
+        features |= CPU_FEATURE_SSE;
+        if (d & (1 << 26)) features |= CPU_FEATURE_SSE2;
+        if (c & (1 << 0))  features |= CPU_FEATURE_SSE3;
+        if (c & (1 << 9))  features |= CPU_FEATURE_SSSE3;
+        if (c & (1 << 19)) features |= CPU_FEATURE_SSE41;
+        enable_sse();
+    }
+}
+
+void cpu_init(void) {
+    features = 0;
+    init_fpu();
+    detect_features();
+    cpu_fpu_save(&initial_fpu_state);
+}
+
+uint32_t cpu_features(void) {
+    return features;
+}
+
+int cpu_has(uint32_t feature) {
+    return (features & feature) == feature;
+}
+
+void cpu_print_features(void) {
+    printf("CPU features:");
+    if (features & CPU_FEATURE_TSC)   printf(" TSC");
+    if (features & CPU_FEATURE_FXSR)  printf(" FXSR");
+    if (features & CPU_FEATURE_SSE)   printf(" SSE");
+    if (features & CPU_FEATURE_SSE2)  printf(" SSE2");
+    if (features & CPU_FEATURE_SSE3)  printf(" SSE3");
+    if (features & CPU_FEATURE_SSSE3) printf(" SSSE3");
+    if (features & CPU_FEATURE_SSE41) printf(" SSE4.1");
+    if (!features) printf(" none");
+    printf("\n");
+}
+
+void cpu_fpu_save(cpu_fpu_state_t* state) {
+    if (features & CPU_FEATURE_FXSR) {
+        asm volatile ("fxsave %0" : "=m"(*state));
+    } else {
+        // FNSAVE reinitializes the FPU: load the state straight back
+        asm volatile ("fnsave %0\n\tfrstor %0" : "+m"(*state));
+    }
+}
+
+void cpu_fpu_restore(const cpu_fpu_state_t* state) {
+    if (features & CPU_FEATURE_FXSR) {
+        asm volatile ("fxrstor %0" : : "m"(*state));
+    } else {
+        asm volatile ("frstor %0" : : "m"(*state));
+    }
+}
+
+void cpu_fpu_reset(void) {
+    cpu_fpu_restore(&initial_fpu_state);
+}
+
+// Counts TSC cycles while PIT channel 2 counts down CALIBRATE_MS
+static uint32_t calibrate_tsc(void) {
+    uint32_t latch = PIT_FREQUENCY * CALIBRATE_MS / 1000;
+
+    // Gate channel 2 on, speaker off; mode 0, lobyte/hibyte
+    outb(0x61, (inb(0x61) & ~0x02) | 0x01);
+    outb(0x43, 0xB0);
+    outb(0x42, latch & 0xFF);
+    outb(0x42, latch >> 8);
+
+    uint64_t start = cpu_read_tsc();
+    uint32_t spins = 0;
+    while (!(inb(0x61) & 0x20)) {
+        if (++spins > 10000000) return 0;  // No PIT: give up
+    }
+    uint64_t cycles = cpu_read_tsc() - start;
+
+    if (cycles > 0xFFFFFFFFULL) return 0;
+    return (uint32_t)cycles / CALIBRATE_MS;
+}
+
+uint32_t cpu_tsc_khz(void) {
+    if (!tsc_calibrated) {
+        tsc_khz = (features & CPU_FEATURE_TSC) ? calibrate_tsc() : 0;
+        tsc_calibrated = 1;
+    }
+    return tsc_khz;
+}
+
+uint32_t cpu_cycles_to_us(uint64_t cycles) {
+    uint32_t mhz = cpu_tsc_khz() / 1000;
+    if (mhz == 0) return 0;
+
+    // divl faults if the quotient does not fit in 32 bits
+    if ((uint32_t)(cycles >> 32) >= mhz) return 0xFFFFFFFF;
+
+    uint32_t quotient, remainder;
+    asm ("divl %4"
+         : "=a"(quotient), "=d"(remainder)
+         : "a"((uint32_t)cycles), "d"((uint32_t)(cycles >> 32)), "r"(mhz));
+    return quotient;
+}
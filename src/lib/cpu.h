@@ -0,0 +1,44 @@
+// src/lib/cpu.h - CPU feature detection, FPU/SSE state and TSC timing
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+// Feature bits reported by cpu_features()
+#define CPU_FEATURE_TSC   0x01
+#define CPU_FEATURE_SSE   0x02
+#define CPU_FEATURE_SSE2  0x04
+#define CPU_FEATURE_SSE3  0x08
+#define CPU_FEATURE_SSSE3 0x10
+#define CPU_FEATURE_SSE41 0x20
+#define CPU_FEATURE_FXSR  0x40
+
+// Detects features, initializes the x87 FPU and turns on SSE (CR0/CR4,
+// MXCSR) when the CPU has it
+void cpu_init(void);
+uint32_t cpu_features(void);
+int cpu_has(uint32_t feature);
+void cpu_print_features(void);
+
+// x87/SSE register image: FXSAVE layout, or FNSAVE's 108 bytes without FXSR
+typedef struct {
+    uint8_t data[512];
+} __attribute__((aligned(16))) cpu_fpu_state_t;
+
+void cpu_fpu_save(cpu_fpu_state_t* state);
+void cpu_fpu_restore(const cpu_fpu_state_t* state);
+// Loads the clean state cpu_init set up (control words, MXCSR, empty stack)
+void cpu_fpu_reset(void);
+
+static inline uint64_t cpu_read_tsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// TSC rate measured against PIT channel 2 (0 if it could not be measured)
+uint32_t cpu_tsc_khz(void);
+// No libgcc: converts with a 64/32 divl instead of __udivdi3
+uint32_t cpu_cycles_to_us(uint64_t cycles);
+
+#endif
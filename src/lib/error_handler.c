@@ -1,5 +1,6 @@
 #include "error_handler.h"
 #include "../drivers/text_output.h"
+#include "format.h"
 
 // Глобальный счетчик ошибок
 static int error_count = 0;
@@ -43,33 +44,8 @@ int safe_execute(int (*func)(), const char* operation_name) {
     if (result != 0) {
         char error_msg[256];
         // Используем безопасную функцию форматирования вместо sprintf
-        const char* failed_str = " failed with code ";
-        const char* continue_str = ", continuing...";
-        
-        // Копируем строки вручную для безопасности
-        int pos = 0;
-        while (operation_name[pos] && pos < 100) {
-            error_msg[pos] = operation_name[pos];
-            pos++;
-        }
-        
-        int i = 0;
-        while (failed_str[i] && pos < 120) {
-            error_msg[pos] = failed_str[i];
-            pos++;
-            i++;
-        }
-        
-        // Добавляем код ошибки (просто цифру)
-        error_msg[pos++] = '0' + (result % 10);
-        
-        i = 0;
-        while (continue_str[i] && pos < 150) {
-            error_msg[pos] = continue_str[i];
-            pos++;
-            i++;
-        }
-        error_msg[pos] = '\0';
+        snprintf(error_msg, sizeof(error_msg), "%s failed with code %d, continuing...",
+                 operation_name, result);
         
         handle_error(error_msg, ERROR_WARNING);
         return result;
@@ -0,0 +1,259 @@
+// src/lib/format.c - printf-style formatting into buffers and output sinks
+#include "format.h"
+#include <stdint.h>
+
+#define FLAG_LEFT  0x01   // '-'
+#define FLAG_PLUS  0x02   // '+'
+#define FLAG_SPACE 0x04   // ' '
+#define FLAG_ALT   0x08   // '#'
+#define FLAG_ZERO  0x10   // '0'
+#define FLAG_POINTER 0x20 // %p: 0x prefix even for zero
+
+enum {
+    LENGTH_INT,
+    LENGTH_CHAR,
+    LENGTH_SHORT,
+    LENGTH_LONG,
+    LENGTH_LONG_LONG,
+    LENGTH_SIZE
+};
+
+static void emit(format_sink_t* sink, char c) {
+    if (sink->length == sink->size && sink->flush) {
+        sink->flush(sink, sink->buffer, sink->length);
+        sink->length = 0;
+    }
+    if (sink->length < sink->size) sink->buffer[sink->length++] = c;
+    sink->total++;
+}
+
+static void emit_repeat(format_sink_t* sink, char c, int count) {
+    while (count-- > 0) emit(sink, c);
+}
+
+void format_sink_flush(format_sink_t* sink) {
+    if (sink->flush && sink->length) sink->flush(sink, sink->buffer, sink->length);
+    sink->length = 0;
+}
+
+// value /= base for base <= 16, returning the remainder. There is no
+// libgcc, so the 64-bit division is done in 16-bit steps.
+static unsigned int divide(uint64_t* value, unsigned int base) {
+    uint32_t high = (uint32_t)(*value >> 32);
+    uint32_t low = (uint32_t)*value;
+
+    if (high == 0) {
+        *value = low / base;
+        return low % base;
+    }
+
+    uint32_t q_high = high / base;
+    uint32_t part = ((high % base) << 16) | (low >> 16);
+    uint32_t q_mid = part / base;
+    part = ((part % base) << 16) | (low & 0xFFFF);
+    uint32_t q_low = part / base;
+
+    *value = ((uint64_t)q_high << 32) | (q_mid << 16) | q_low;
+    return part % base;
+}
+
+static void format_number(format_sink_t* sink, uint64_t value, int negative, unsigned int base,
+                          int uppercase, int flags, int width, int precision) {
+    const char* digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+    char text[24];
+    int count = 0;
+    char prefix[3];
+    int prefix_length = 0;
+
+    if (negative) prefix[prefix_length++] = '-';
+    else if (flags & FLAG_PLUS) prefix[prefix_length++] = '+';
+    else if (flags & FLAG_SPACE) prefix[prefix_length++] = ' ';
+
+    if (((flags & FLAG_ALT) && base == 16 && value != 0) || (flags & FLAG_POINTER)) {
+        prefix[prefix_length++] = '0';
+        prefix[prefix_length++] = uppercase ? 'X' : 'x';
+    }
+
+    // Precision 0 with value 0 prints no digits
+    uint64_t v = value;
+    while (v != 0) text[count++] = digits[divide(&v, base)];
+    if (count == 0 && precision != 0) text[count++] = '0';
+    if ((flags & FLAG_ALT) && base == 8 && (count == 0 || text[count - 1] != '0')) {
+        text[count++] = '0';
+    }
+
+    int zeros = (precision > count) ? precision - count : 0;
+    if ((flags & FLAG_ZERO) && !(flags & FLAG_LEFT) && precision < 0) {
+        int fill = width - prefix_length - count;
+        if (fill > zeros) zeros = fill;
+    }
+    int padding = width - prefix_length - zeros - count;
+
+    if (!(flags & FLAG_LEFT)) emit_repeat(sink, ' ', padding);
+    for (int i = 0; i < prefix_length; i++) emit(sink, prefix[i]);
+    emit_repeat(sink, '0', zeros);
+    while (count > 0) emit(sink, text[--count]);
+    if (flags & FLAG_LEFT) emit_repeat(sink, ' ', padding);
+}
+
+static void format_text(format_sink_t* sink, const char* str, int length, int flags, int width) {
+    int padding = width - length;
+    if (!(flags & FLAG_LEFT)) emit_repeat(sink, ' ', padding);
+    for (int i = 0; i < length; i++) emit(sink, str[i]);
+    if (flags & FLAG_LEFT) emit_repeat(sink, ' ', padding);
+}
+
+static uint64_t fetch_unsigned(va_list* args, int length) {
+    switch (length) {
+        case LENGTH_CHAR:      return (unsigned char)va_arg(*args, unsigned int);
+        case LENGTH_SHORT:     return (unsigned short)va_arg(*args, unsigned int);
+        case LENGTH_LONG:      return va_arg(*args, unsigned long);
+        case LENGTH_LONG_LONG: return va_arg(*args, unsigned long long);
+        case LENGTH_SIZE:      return va_arg(*args, size_t);
+        default:               return va_arg(*args, unsigned int);
+    }
+}
+
+static int64_t fetch_signed(va_list* args, int length) {
+    switch (length) {
+        case LENGTH_CHAR:      return (signed char)va_arg(*args, int);
+        case LENGTH_SHORT:     return (short)va_arg(*args, int);
+        case LENGTH_LONG:      return va_arg(*args, long);
+        case LENGTH_LONG_LONG: return va_arg(*args, long long);
+        case LENGTH_SIZE:      return (int)va_arg(*args, size_t);
+        default:               return va_arg(*args, int);
+    }
+}
+
+int format_to_sink(format_sink_t* sink, const char* format, va_list args) {
+    va_list ap;
+    va_copy(ap, args);
+
+    for (const char* p = format; *p; p++) {
+        if (*p != '%') {
+            emit(sink, *p);
+            continue;
+        }
+        if (*++p == '\0') {
+            emit(sink, '%');
+            break;
+        }
+
+        int flags = 0;
+        for (;; p++) {
+            if (*p == '-') flags |= FLAG_LEFT;
+            else if (*p == '+') flags |= FLAG_PLUS;
+            else if (*p == ' ') flags |= FLAG_SPACE;
+            else if (*p == '#') flags |= FLAG_ALT;
+            else if (*p == '0') flags |= FLAG_ZERO;
+            else break;
+        }
+
+        int width = 0;
+        if (*p == '*') {
+            width = va_arg(ap, int);
+            if (width < 0) {
+                flags |= FLAG_LEFT;
+                width = -width;
+            }
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') width = width * 10 + (*p++ - '0');
+        }
+
+        int precision = -1;
+        if (*p == '.') {
+            p++;
+            precision = 0;
+            if (*p == '*') {
+                precision = va_arg(ap, int);
+                if (precision < 0) precision = -1;
+                p++;
+            } else {
+                while (*p >= '0' && *p <= '9') precision = precision * 10 + (*p++ - '0');
+            }
+        }
+
+        int length = LENGTH_INT;
+        if (*p == 'h') {
+            length = (p[1] == 'h') ? LENGTH_CHAR : LENGTH_SHORT;
+            p += (p[1] == 'h') ? 2 : 1;
+        } else if (*p == 'l') {
+            length = (p[1] == 'l') ? LENGTH_LONG_LONG : LENGTH_LONG;
+            p += (p[1] == 'l') ? 2 : 1;
+        } else if (*p == 'z') {
+            length = LENGTH_SIZE;
+            p++;
+        }
+
+        switch (*p) {
+            case 'd':
+            case 'i': {
+                int64_t value = fetch_signed(&ap, length);
+                uint64_t magnitude = (value < 0) ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+                format_number(sink, magnitude, value < 0, 10, 0, flags, width, precision);
+                break;
+            }
+            case 'u':
+                format_number(sink, fetch_unsigned(&ap, length), 0, 10, 0,
+                              flags & ~(FLAG_PLUS | FLAG_SPACE), width, precision);
+                break;
+            case 'o':
+                format_number(sink, fetch_unsigned(&ap, length), 0, 8, 0,
+                              flags & ~(FLAG_PLUS | FLAG_SPACE), width, precision);
+                break;
+            case 'x':
+            case 'X':
+                format_number(sink, fetch_unsigned(&ap, length), 0, 16, *p == 'X',
+                              flags & ~(FLAG_PLUS | FLAG_SPACE), width, precision);
+                break;
+            case 'p':
+                // Always 0x plus every digit of the address
+                format_number(sink, (uintptr_t)va_arg(ap, void*), 0, 16, 0,
+                              (flags & FLAG_LEFT) | FLAG_POINTER, width, sizeof(void*) * 2);
+                break;
+            case 'c': {
+                char c = (char)va_arg(ap, int);
+                format_text(sink, &c, 1, flags, width);
+                break;
+            }
+            case 's': {
+                const char* str = va_arg(ap, const char*);
+                if (!str) str = "(null)";
+                int n = 0;
+                while (str[n] && (precision < 0 || n < precision)) n++;
+                format_text(sink, str, n, flags, width);
+                break;
+            }
+            case '%':
+                emit(sink, '%');
+                break;
+            case '\0':
+                p--;
+                break;
+            default:
+                emit(sink, '%');
+                emit(sink, *p);
+                break;
+        }
+    }
+
+    va_end(ap);
+    return (int)sink->total;
+}
+
+int vsnprintf(char* buffer, size_t size, const char* format, va_list args) {
+    // The last byte is kept for the terminator
+    format_sink_t sink = {buffer, size ? size - 1 : 0, 0, 0, NULL, NULL};
+    int total = format_to_sink(&sink, format, args);
+    if (size) buffer[sink.length] = '\0';
+    return total;
+}
+
+int snprintf(char* buffer, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int total = vsnprintf(buffer, size, format, args);
+    va_end(args);
+    return total;
+}
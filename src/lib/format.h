@@ -0,0 +1,29 @@
+// src/lib/format.h - printf-style formatting into buffers and output sinks
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdarg.h>
+#include "stddef.h"
+
+// Output is staged in buffer; when it fills up, flush (if set) receives the
+// staged bytes and staging starts over. Without flush, output is truncated.
+typedef struct format_sink {
+    char* buffer;
+    size_t size;
+    size_t length;      // Bytes currently staged
+    size_t total;       // Bytes produced so far, including flushed/dropped ones
+    void (*flush)(struct format_sink* sink, const char* data, size_t length);
+    void* context;
+} format_sink_t;
+
+// Supports flags "-+ #0", width and precision (also as *), length modifiers
+// hh h l ll z, and conversions d i u o x X c s p %
+int format_to_sink(format_sink_t* sink, const char* format, va_list args);
+// Hands any staged bytes to sink->flush
+void format_sink_flush(format_sink_t* sink);
+
+// Always NUL-terminated when size > 0; returns the untruncated length
+int vsnprintf(char* buffer, size_t size, const char* format, va_list args);
+int snprintf(char* buffer, size_t size, const char* format, ...);
+
+#endif
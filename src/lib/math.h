@@ -0,0 +1,43 @@
+// src/lib/math.h - Float math on the x87 FPU (there is no libm in the kernel)
+#ifndef MATH_H
+#define MATH_H
+
+#define M_PI 3.14159265358979323846
+
+static inline float my_sqrtf(float x) {
+    float r;
+    asm ("fsqrt" : "=t"(r) : "0"(x));
+    return r;
+}
+
+// fsin/fcos are exact enough for |x| < 2^63; angles here are small
+static inline float my_sinf(float x) {
+    float r;
+    asm ("fsin" : "=t"(r) : "0"(x));
+    return r;
+}
+
+static inline float my_cosf(float x) {
+    float r;
+    asm ("fcos" : "=t"(r) : "0"(x));
+    return r;
+}
+
+static inline float my_fabsf(float x) {
+    return x < 0.0f ? -x : x;
+}
+
+// For |x| < 2^31
+static inline float my_floorf(float x) {
+    int i = (int)x;
+    return (float)(i - (x < (float)i));
+}
+
+// Compatibility macros for code that uses standard names
+#define sqrtf my_sqrtf
+#define sinf my_sinf
+#define cosf my_cosf
+#define fabsf my_fabsf
+#define floorf my_floorf
+
+#endif
@@ -0,0 +1,330 @@
+// src/lib/matrix.c - 4x4 float matrices with scalar and SSE kernels
+#include "matrix.h"
+#include "cpu.h"
+#include "string.h"
+#include "../drivers/text_output.h"
+
+// GCC vector types: the SSE intrinsic headers need a hosted libc
+typedef float v4sf __attribute__((vector_size(16)));
+typedef float v4sf_u __attribute__((vector_size(16), aligned(4), may_alias));
+typedef int v4si __attribute__((vector_size(16)));
+
+typedef void (*multiply_fn)(float* result, const float* a, const float* b);
+typedef void (*transpose_fn)(float* result, const float* m);
+typedef int (*inverse_fn)(float* result, const float* m);
+typedef void (*transform_fn)(const float* m, const float* in, uint32_t in_stride,
+                             float* out, uint32_t out_stride, uint32_t count);
+
+#define POINT(base, stride, i) ((const float*)((const uint8_t*)(base) + (i) * (stride)))
+#define POINT_OUT(base, stride, i) ((float*)((uint8_t*)(base) + (i) * (stride)))
+
+void matrix_identity(float* m) {
+    m[0] = 1.0f; m[1] = 0.0f; m[2] = 0.0f; m[3] = 0.0f;
+    m[4] = 0.0f; m[5] = 1.0f; m[6] = 0.0f; m[7] = 0.0f;
+    m[8] = 0.0f; m[9] = 0.0f; m[10] = 1.0f; m[11] = 0.0f;
+    m[12] = 0.0f; m[13] = 0.0f; m[14] = 0.0f; m[15] = 1.0f;
+}
+
+// ==================== SCALAR ====================
+
+static void multiply_scalar(float* result, const float* a, const float* b) {
+    float r[16];
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 4; row++) {
+            r[c * 4 + row] = a[row] * b[c * 4] + a[4 + row] * b[c * 4 + 1] +
+                             a[8 + row] * b[c * 4 + 2] + a[12 + row] * b[c * 4 + 3];
+        }
+    }
+    memcpy(result, r, sizeof(r));
+}
+
+static void transpose_scalar(float* result, const float* m) {
+    float r[16];
+    for (int c = 0; c < 4; c++) {
+        for (int row = 0; row < 4; row++) r[row * 4 + c] = m[c * 4 + row];
+    }
+    memcpy(result, r, sizeof(r));
+}
+
+// Adjugate from the 2x2 minors of the first and last two rows. The inverse of
+// the transpose is the transpose of the inverse, so the memory can be read as
+// row-major: a(i, j) = m[i * 4 + j]
+static int inverse_scalar(float* result, const float* m) {
+    float s0 = m[0] * m[5] - m[4] * m[1];
+    float s1 = m[0] * m[6] - m[4] * m[2];
+    float s2 = m[0] * m[7] - m[4] * m[3];
+    float s3 = m[1] * m[6] - m[5] * m[2];
+    float s4 = m[1] * m[7] - m[5] * m[3];
+    float s5 = m[2] * m[7] - m[6] * m[3];
+
+    float c0 = m[8] * m[13] - m[12] * m[9];
+    float c1 = m[8] * m[14] - m[12] * m[10];
+    float c2 = m[8] * m[15] - m[12] * m[11];
+    float c3 = m[9] * m[14] - m[13] * m[10];
+    float c4 = m[9] * m[15] - m[13] * m[11];
+    float c5 = m[10] * m[15] - m[14] * m[11];
+
+    float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (det == 0.0f) return 0;
+    float inv = 1.0f / det;
+
+    float r[16];
+    r[0] = (m[5] * c5 - m[6] * c4 + m[7] * c3) * inv;
+    r[1] = (-m[1] * c5 + m[2] * c4 - m[3] * c3) * inv;
+    r[2] = (m[13] * s5 - m[14] * s4 + m[15] * s3) * inv;
+    r[3] = (-m[9] * s5 + m[10] * s4 - m[11] * s3) * inv;
+
+    r[4] = (-m[4] * c5 + m[6] * c2 - m[7] * c1) * inv;
+    r[5] = (m[0] * c5 - m[2] * c2 + m[3] * c1) * inv;
+    r[6] = (-m[12] * s5 + m[14] * s2 - m[15] * s1) * inv;
+    r[7] = (m[8] * s5 - m[10] * s2 + m[11] * s1) * inv;
+
+    r[8] = (m[4] * c4 - m[5] * c2 + m[7] * c0) * inv;
+    r[9] = (-m[0] * c4 + m[1] * c2 - m[3] * c0) * inv;
+    r[10] = (m[12] * s4 - m[13] * s2 + m[15] * s0) * inv;
+    r[11] = (-m[8] * s4 + m[9] * s2 - m[11] * s0) * inv;
+
+    r[12] = (-m[4] * c3 + m[5] * c1 - m[6] * c0) * inv;
+    r[13] = (m[0] * c3 - m[1] * c1 + m[2] * c0) * inv;
+    r[14] = (-m[12] * s3 + m[13] * s1 - m[14] * s0) * inv;
+    r[15] = (m[8] * s3 - m[9] * s1 + m[10] * s0) * inv;
+    memcpy(result, r, sizeof(r));
+    return 1;
+}
+
+static void transform_scalar(const float* m, const float* in, uint32_t in_stride,
+                             float* out, uint32_t out_stride, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        const float* p = POINT(in, in_stride, i);
+        float* o = POINT_OUT(out, out_stride, i);
+        float x = p[0], y = p[1], z = p[2];
+
+        o[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+        o[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+        o[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+        o[3] = m[3] * x + m[7] * y + m[11] * z + m[15];
+    }
+}
+
+// ==================== SSE ====================
+
+#define SPLAT(v, i) __builtin_shuffle(v, (v4si){i, i, i, i})
+
+// Rows r0..r3 become columns (unpcklps/unpckhps, movlhps/movhlps)
+#define TRANSPOSE4(r0, r1, r2, r3) do {                             \
+    v4sf t0 = __builtin_shuffle(r0, r1, (v4si){0, 4, 1, 5});        \
+    v4sf t1 = __builtin_shuffle(r2, r3, (v4si){0, 4, 1, 5});        \
+    v4sf t2 = __builtin_shuffle(r0, r1, (v4si){2, 6, 3, 7});        \
+    v4sf t3 = __builtin_shuffle(r2, r3, (v4si){2, 6, 3, 7});        \
+    r0 = __builtin_shuffle(t0, t1, (v4si){0, 1, 4, 5});             \
+    r1 = __builtin_shuffle(t0, t1, (v4si){2, 3, 6, 7});             \
+    r2 = __builtin_shuffle(t2, t3, (v4si){0, 1, 4, 5});             \
+    r3 = __builtin_shuffle(t2, t3, (v4si){2, 3, 6, 7});             \
+} while (0)
+
+__attribute__((target("sse")))
+static void multiply_sse(float* result, const float* a, const float* b) {
+    v4sf a0 = *(const v4sf_u*)(a + 0);
+    v4sf a1 = *(const v4sf_u*)(a + 4);
+    v4sf a2 = *(const v4sf_u*)(a + 8);
+    v4sf a3 = *(const v4sf_u*)(a + 12);
+    v4sf r[4];
+
+    // Column c of the result: columns of a weighted by column c of b
+    for (int c = 0; c < 4; c++) {
+        v4sf bc = *(const v4sf_u*)(b + c * 4);
+        r[c] = a0 * SPLAT(bc, 0) + a1 * SPLAT(bc, 1) + a2 * SPLAT(bc, 2) + a3 * SPLAT(bc, 3);
+    }
+    for (int c = 0; c < 4; c++) *(v4sf_u*)(result + c * 4) = r[c];
+}
+
+__attribute__((target("sse")))
+static void transpose_sse(float* result, const float* m) {
+    v4sf r0 = *(const v4sf_u*)(m + 0);
+    v4sf r1 = *(const v4sf_u*)(m + 4);
+    v4sf r2 = *(const v4sf_u*)(m + 8);
+    v4sf r3 = *(const v4sf_u*)(m + 12);
+    TRANSPOSE4(r0, r1, r2, r3);
+    *(v4sf_u*)(result + 0) = r0;
+    *(v4sf_u*)(result + 4) = r1;
+    *(v4sf_u*)(result + 8) = r2;
+    *(v4sf_u*)(result + 12) = r3;
+}
+
+// 2x2 minors of rows a and b over column pairs 01 02 03 12 (lo) and 13 23 (hi)
+#define MINORS(a, b, lo, hi) do {                                                   \
+    lo = __builtin_shuffle(a, (v4si){0, 0, 0, 1}) * __builtin_shuffle(b, (v4si){1, 2, 3, 2}) -  \
+         __builtin_shuffle(b, (v4si){0, 0, 0, 1}) * __builtin_shuffle(a, (v4si){1, 2, 3, 2});   \
+    hi = __builtin_shuffle(a, (v4si){1, 2, 1, 2}) * SPLAT(b, 3) -                   \
+         __builtin_shuffle(b, (v4si){1, 2, 1, 2}) * SPLAT(a, 3);                    \
+} while (0)
+
+// The scalar formulas four lanes at a time: row k of the adjugate is a signed
+// sum of swapped columns weighted by (c, c, s, s) minor pairs
+__attribute__((target("sse")))
+static int inverse_sse(float* result, const float* m) {
+    v4sf r0 = *(const v4sf_u*)(m + 0);
+    v4sf r1 = *(const v4sf_u*)(m + 4);
+    v4sf r2 = *(const v4sf_u*)(m + 8);
+    v4sf r3 = *(const v4sf_u*)(m + 12);
+    v4sf s_lo, s_hi, c_lo, c_hi;
+    MINORS(r0, r1, s_lo, s_hi);
+    MINORS(r2, r3, c_lo, c_hi);
+
+    v4sf v0 = __builtin_shuffle(c_lo, s_lo, (v4si){0, 0, 4, 4});
+    v4sf v1 = __builtin_shuffle(c_lo, s_lo, (v4si){1, 1, 5, 5});
+    v4sf v2 = __builtin_shuffle(c_lo, s_lo, (v4si){2, 2, 6, 6});
+    v4sf v3 = __builtin_shuffle(c_lo, s_lo, (v4si){3, 3, 7, 7});
+    v4sf v4 = __builtin_shuffle(c_hi, s_hi, (v4si){0, 0, 4, 4});
+    v4sf v5 = __builtin_shuffle(c_hi, s_hi, (v4si){1, 1, 5, 5});
+
+    // Columns with lanes swapped in pairs: (a1j, a0j, a3j, a2j)
+    v4sf k0 = r0, k1 = r1, k2 = r2, k3 = r3;
+    TRANSPOSE4(k0, k1, k2, k3);
+    k0 = __builtin_shuffle(k0, (v4si){1, 0, 3, 2});
+    k1 = __builtin_shuffle(k1, (v4si){1, 0, 3, 2});
+    k2 = __builtin_shuffle(k2, (v4si){1, 0, 3, 2});
+    k3 = __builtin_shuffle(k3, (v4si){1, 0, 3, 2});
+
+    v4sf sign = {1.0f, -1.0f, 1.0f, -1.0f};
+    v4sf b0 = (k1 * v5 - k2 * v4 + k3 * v3) * sign;
+    v4sf b1 = (k2 * v2 - k0 * v5 - k3 * v1) * sign;
+    v4sf b2 = (k0 * v4 - k1 * v2 + k3 * v0) * sign;
+    v4sf b3 = (k1 * v1 - k0 * v3 - k2 * v0) * sign;
+
+    // First row of m times the first column of the adjugate
+    float det = r0[0] * b0[0] + r0[1] * b1[0] + r0[2] * b2[0] + r0[3] * b3[0];
+    if (det == 0.0f) return 0;
+    float inv = 1.0f / det;
+    v4sf scale = {inv, inv, inv, inv};
+
+    *(v4sf_u*)(result + 0) = b0 * scale;
+    *(v4sf_u*)(result + 4) = b1 * scale;
+    *(v4sf_u*)(result + 8) = b2 * scale;
+    *(v4sf_u*)(result + 12) = b3 * scale;
+    return 1;
+}
+
+// Four points per iteration, each x * column 0 + y * column 1 + z * column 2
+// + column 3 with the columns kept in registers. Points are stored x, y, z, w,
+// so working on whole vertices avoids transposing in and out of x/y/z/w lanes
+__attribute__((target("sse")))
+static void transform_sse(const float* m, const float* in, uint32_t in_stride,
+                          float* out, uint32_t out_stride, uint32_t count) {
+    v4sf m0 = *(const v4sf_u*)(m + 0);
+    v4sf m1 = *(const v4sf_u*)(m + 4);
+    v4sf m2 = *(const v4sf_u*)(m + 8);
+    v4sf m3 = *(const v4sf_u*)(m + 12);
+    uint32_t i = 0;
+
+#define TRANSFORM_ONE(k) do {                                                       \
+    v4sf p = *(const v4sf_u*)POINT(in, in_stride, i + k);                           \
+    *(v4sf_u*)POINT_OUT(out, out_stride, i + k) =                                   \
+        m0 * SPLAT(p, 0) + m1 * SPLAT(p, 1) + m2 * SPLAT(p, 2) + m3;                \
+} while (0)
+
+    for (; i + 4 <= count; i += 4) {
+        TRANSFORM_ONE(0);
+        TRANSFORM_ONE(1);
+        TRANSFORM_ONE(2);
+        TRANSFORM_ONE(3);
+    }
+    for (; i < count; i++) TRANSFORM_ONE(0);
+
+#undef TRANSFORM_ONE
+}
+
+// ==================== DISPATCH ====================
+
+static multiply_fn multiply_kernel = multiply_scalar;
+static transpose_fn transpose_kernel = transpose_scalar;
+static inverse_fn inverse_kernel = inverse_scalar;
+static transform_fn transform_kernel = transform_scalar;
+static const char* kernel_name = "scalar";
+
+void matrix_init(void) {
+    if (cpu_has(CPU_FEATURE_SSE)) {
+        multiply_kernel = multiply_sse;
+        transpose_kernel = transpose_sse;
+        inverse_kernel = inverse_sse;
+        transform_kernel = transform_sse;
+        kernel_name = "SSE";
+    }
+}
+
+const char* matrix_kernel(void) {
+    return kernel_name;
+}
+
+void matrix_multiply(float* result, const float* a, const float* b) {
+    multiply_kernel(result, a, b);
+}
+
+void matrix_transpose(float* result, const float* m) {
+    transpose_kernel(result, m);
+}
+
+int matrix_inverse(float* result, const float* m) {
+    return inverse_kernel(result, m);
+}
+
+void matrix_transform_points(const float* m, const float* in, uint32_t in_stride,
+                             float* out, uint32_t out_stride, uint32_t count) {
+    transform_kernel(m, in, in_stride, out, out_stride, count);
+}
+
+// ==================== BENCHMARK ====================
+
+#define BENCH_POINTS     4096
+#define BENCH_ROUNDS     16
+#define BENCH_MULTIPLIES 65536
+
+static float bench_in[BENCH_POINTS * 4];
+static float bench_out[BENCH_POINTS * 4];
+
+// Thousands per second
+static uint32_t bench_rate(uint64_t start, uint32_t count) {
+    uint32_t us = cpu_cycles_to_us(cpu_read_tsc() - start);
+    if (us == 0) us = 1;
+    return count * 1000 / us;
+}
+
+static uint32_t bench_transform(transform_fn transform, const float* m) {
+    uint64_t start = cpu_read_tsc();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        transform(m, bench_in, 16, bench_out, 16, BENCH_POINTS);
+    }
+    return bench_rate(start, BENCH_POINTS * BENCH_ROUNDS);
+}
+
+static uint32_t bench_multiply(multiply_fn multiply, const float* m) {
+    float acc[16];
+    matrix_identity(acc);
+    uint64_t start = cpu_read_tsc();
+    for (int i = 0; i < BENCH_MULTIPLIES; i++) multiply(acc, acc, m);
+    return bench_rate(start, BENCH_MULTIPLIES);
+}
+
+void matrix_benchmark(void) {
+    if (!cpu_tsc_khz()) {
+        printf("Matrix: TSC rate unknown\n");
+        return;
+    }
+
+    // A rotation: repeated products stay bounded
+    float m[16] = {0.8f, 0.6f, 0.0f, 0.0f, -0.6f, 0.8f, 0.0f, 0.0f,
+                   0.0f, 0.0f, 1.0f, 0.0f, 0.5f, -0.5f, -3.0f, 1.0f};
+    for (int i = 0; i < BENCH_POINTS * 4; i++) bench_in[i] = (float)(i % 17) * 0.125f - 1.0f;
+
+    uint32_t transform = bench_transform(transform_scalar, m);
+    uint32_t multiply = bench_multiply(multiply_scalar, m);
+    printf("Matrix: scalar %6u Kvertices/s %6u Kmultiplies/s\n", transform, multiply);
+
+    if (!cpu_has(CPU_FEATURE_SSE)) {
+        printf("Matrix: no SSE\n");
+        return;
+    }
+    transform = bench_transform(transform_sse, m);
+    multiply = bench_multiply(multiply_sse, m);
+    printf("Matrix: SSE    %6u Kvertices/s %6u Kmultiplies/s\n", transform, multiply);
+}
@@ -0,0 +1,32 @@
+// src/lib/matrix.h - 4x4 float matrices with scalar and SSE kernels
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stdint.h>
+
+// Column-major, as in OpenGL: element (row r, column c) is m[c * 4 + r].
+// Matrices need no particular alignment
+
+// Selects the SSE kernels when the CPU has SSE; call after cpu_init.
+// Until then (or without SSE) the scalar kernels run
+void matrix_init(void);
+const char* matrix_kernel(void);
+
+void matrix_identity(float* m);
+// result = a * b; result may be a or b
+void matrix_multiply(float* result, const float* a, const float* b);
+// result may be m
+void matrix_transpose(float* result, const float* m);
+// Returns 0 and leaves result untouched if m is singular; result may be m
+int matrix_inverse(float* result, const float* m);
+
+// out = m * (x, y, z, 1) for count points. in and out step by their strides
+// in bytes; each input point is read as 4 floats (the fourth is ignored), so
+// in_stride must be at least 16. out receives x, y, z, w
+void matrix_transform_points(const float* m, const float* in, uint32_t in_stride,
+                             float* out, uint32_t out_stride, uint32_t count);
+
+// Points transformed and matrices multiplied per second, scalar against SSE
+void matrix_benchmark(void);
+
+#endif
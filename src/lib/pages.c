@@ -0,0 +1,107 @@
+// src/lib/pages.c - Physical page frame allocator
+#include "pages.h"
+#include "../multiboot.h"
+
+#define FRAME_COUNT (PAGES_MAX_MEMORY / PAGE_SIZE)
+
+// Set by linker.ld after .bss
+extern uint8_t _kernel_end[];
+
+// One bit per frame, set = used or not RAM
+static uint32_t bitmap[FRAME_COUNT / 32];
+static uint32_t first_frame = 0;
+static uint32_t end_frame = 0;
+static uint32_t free_frames = 0;
+// Where the next search starts: allocations are mostly first-fit from here
+static uint32_t search_hint = 0;
+
+static inline int frame_used(uint32_t frame) {
+    return (bitmap[frame >> 5] >> (frame & 31)) & 1;
+}
+
+void pages_init(void) {
+    for (uint32_t i = 0; i < FRAME_COUNT / 32; i++) bitmap[i] = 0xFFFFFFFF;
+    first_frame = end_frame = free_frames = 0;
+
+    // Without the memory size from the loader nothing is handed out
+    uint32_t upper_kb = multiboot_memory_upper_kb();
+    if (!upper_kb) return;
+
+    uint32_t ram_end = PAGES_MAX_MEMORY;
+    if (upper_kb < (PAGES_MAX_MEMORY - 0x100000) / 1024) ram_end = 0x100000 + upper_kb * 1024;
+
+    // Skip the kernel image and whatever the loader placed after it
+    uint32_t start = (uint32_t)_kernel_end;
+    if (multiboot_reserved_end() > start) start = multiboot_reserved_end();
+
+    first_frame = (start + PAGE_SIZE - 1) / PAGE_SIZE;
+    end_frame = ram_end / PAGE_SIZE;
+    if (first_frame >= end_frame) {
+        first_frame = end_frame = 0;
+        return;
+    }
+
+    for (uint32_t frame = first_frame; frame < end_frame; frame++) {
+        bitmap[frame >> 5] &= ~(1u << (frame & 31));
+    }
+    free_frames = end_frame - first_frame;
+    search_hint = first_frame;
+}
+
+// First frame of count free frames at or after from, or 0
+static uint32_t find_run(uint32_t from, uint32_t count) {
+    uint32_t run = 0;
+    uint32_t frame = from;
+
+    while (frame < end_frame) {
+        // Fully used words are skipped 32 frames at a time
+        if ((frame & 31) == 0 && bitmap[frame >> 5] == 0xFFFFFFFF) {
+            run = 0;
+            frame += 32;
+            continue;
+        }
+        if (frame_used(frame)) {
+            run = 0;
+        } else if (++run == count) {
+            return frame - count + 1;
+        }
+        frame++;
+    }
+    return 0;
+}
+
+void* page_alloc(uint32_t count) {
+    if (count == 0 || count > free_frames) return 0;
+
+    uint32_t frame = find_run(search_hint, count);
+    if (!frame && search_hint > first_frame) frame = find_run(first_frame, count);
+    if (!frame) return 0;
+
+    for (uint32_t f = frame; f < frame + count; f++) {
+        bitmap[f >> 5] |= 1u << (f & 31);
+    }
+    free_frames -= count;
+    search_hint = frame + count;
+    return (void*)(frame * PAGE_SIZE);
+}
+
+void page_free(void* address, uint32_t count) {
+    uint32_t frame = (uint32_t)address / PAGE_SIZE;
+    if (!address || frame < first_frame || frame + count > end_frame) return;
+
+    for (uint32_t f = frame; f < frame + count; f++) {
+        if (frame_used(f)) {
+            bitmap[f >> 5] &= ~(1u << (f & 31));
+            free_frames++;
+        }
+    }
+    if (frame < search_hint) search_hint = frame;
+}
+
+uint32_t pages_total(void) {
+    return end_frame - first_frame;
+}
+
+uint32_t pages_free_count(void) {
+    return free_frames;
+}
@@ -0,0 +1,26 @@
+// src/lib/pages.h - Physical page frame allocator
+#ifndef PAGES_H
+#define PAGES_H
+
+#include <stdint.h>
+
+#define PAGE_SIZE 4096
+
+// Frames above this address are not managed (bitmap size)
+#define PAGES_MAX_MEMORY 0xC0000000u
+
+// Takes the RAM above the kernel image and the boot modules
+void pages_init(void);
+
+// Contiguous, page-aligned frames (addresses are identity mapped), or 0
+void* page_alloc(uint32_t count);
+void page_free(void* address, uint32_t count);
+
+static inline uint32_t pages_for_bytes(uint32_t bytes) {
+    return (bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+uint32_t pages_total(void);
+uint32_t pages_free_count(void);
+
+#endif
@@ -0,0 +1,150 @@
+// src/multiboot.c - Разбор информации, переданной загрузчиком
+#include "multiboot.h"
+#include "drivers/text_output.h"
+
+static uint32_t boot_magic = 0;
+static uint32_t boot_info_addr = 0;
+
+static multiboot_module_t modules[MULTIBOOT_MAX_MODULES];
+static int module_count = 0;
+
+static multiboot_framebuffer_t framebuffer_info;
+static int framebuffer_valid = 0;
+
+static uint32_t memory_upper_kb = 0;
+// Все, что ниже, могут занимать данные загрузчика
+static uint32_t reserved_end = 0;
+
+static void multiboot_reserve(uint32_t end) {
+    if (end > reserved_end) reserved_end = end;
+}
+
+static void multiboot_add_module(uint32_t start, uint32_t end, const char *cmdline) {
+    if (module_count >= MULTIBOOT_MAX_MODULES || end <= start) return;
+
+    modules[module_count].start = start;
+    modules[module_count].end = end;
+    modules[module_count].cmdline = cmdline ? cmdline : "";
+    module_count++;
+    multiboot_reserve(end);
+
+    // Строка параметров тоже может лежать выше 1 МБ
+    if (cmdline) {
+        const char *p = cmdline;
+        while (*p) p++;
+        multiboot_reserve((uint32_t)p + 1);
+    }
+}
+
+// color_info: red pos/size, green pos/size, blue pos/size
+static void multiboot_set_framebuffer(uint64_t addr, uint32_t pitch, uint32_t width, uint32_t height,
+                                      uint8_t bpp, uint8_t type, const uint8_t *color_info) {
+    // Индексные и текстовые режимы не поддерживаются
+    if (type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB || !addr || !width || !height) return;
+
+    framebuffer_info.addr = addr;
+    framebuffer_info.pitch = pitch;
+    framebuffer_info.width = width;
+    framebuffer_info.height = height;
+    framebuffer_info.bpp = bpp;
+    framebuffer_info.red_pos = color_info[0];
+    framebuffer_info.red_size = color_info[1];
+    framebuffer_info.green_pos = color_info[2];
+    framebuffer_info.green_size = color_info[3];
+    framebuffer_info.blue_pos = color_info[4];
+    framebuffer_info.blue_size = color_info[5];
+    framebuffer_valid = 1;
+}
+
+static void multiboot1_parse(const multiboot_info_t *info) {
+    multiboot_reserve((uint32_t)info + sizeof(multiboot_info_t));
+
+    if (info->flags & MULTIBOOT_INFO_MEMORY) {
+        memory_upper_kb = info->mem_upper;
+    }
+
+    if (info->flags & MULTIBOOT_INFO_MODS) {
+        const multiboot_mod_entry_t *mods = (const multiboot_mod_entry_t*)info->mods_addr;
+        for (uint32_t i = 0; i < info->mods_count; i++) {
+            multiboot_add_module(mods[i].mod_start, mods[i].mod_end,
+                                 (const char*)mods[i].cmdline);
+        }
+    }
+
+    if (info->flags & MULTIBOOT_INFO_FRAMEBUFFER) {
+        multiboot_set_framebuffer(info->framebuffer_addr, info->framebuffer_pitch,
+                                  info->framebuffer_width, info->framebuffer_height,
+                                  info->framebuffer_bpp, info->framebuffer_type, info->color_info);
+    }
+}
+
+static void multiboot2_parse(uint32_t info_addr) {
+    // Первые 8 байт: total_size и reserved, затем теги с выравниванием 8
+    uint32_t total_size = *(const uint32_t*)info_addr;
+    uint32_t offset = 8;
+    multiboot_reserve(info_addr + total_size);
+
+    while (offset + sizeof(multiboot2_tag_t) <= total_size) {
+        const multiboot2_tag_t *tag = (const multiboot2_tag_t*)(info_addr + offset);
+        if (tag->type == MULTIBOOT2_TAG_END || tag->size < sizeof(multiboot2_tag_t)) break;
+
+        if (tag->type == MULTIBOOT2_TAG_MODULE) {
+            const multiboot2_tag_module_t *mod = (const multiboot2_tag_module_t*)tag;
+            multiboot_add_module(mod->mod_start, mod->mod_end, mod->cmdline);
+        } else if (tag->type == MULTIBOOT2_TAG_BASIC_MEMINFO &&
+                   tag->size >= sizeof(multiboot2_tag_basic_meminfo_t)) {
+            memory_upper_kb = ((const multiboot2_tag_basic_meminfo_t*)tag)->mem_upper;
+        } else if (tag->type == MULTIBOOT2_TAG_FRAMEBUFFER &&
+                   tag->size >= sizeof(multiboot2_tag_framebuffer_t)) {
+            const multiboot2_tag_framebuffer_t *fb = (const multiboot2_tag_framebuffer_t*)tag;
+            multiboot_set_framebuffer(fb->framebuffer_addr, fb->framebuffer_pitch,
+                                      fb->framebuffer_width, fb->framebuffer_height,
+                                      fb->framebuffer_bpp, fb->framebuffer_type, fb->color_info);
+        }
+
+        offset += (tag->size + 7) & ~7;
+    }
+}
+
+void multiboot_init(uint32_t magic, uint32_t info_addr) {
+    boot_magic = magic;
+    boot_info_addr = info_addr;
+    module_count = 0;
+    framebuffer_valid = 0;
+    memory_upper_kb = 0;
+    reserved_end = 0;
+
+    if (!info_addr) return;
+
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC) {
+        multiboot1_parse((const multiboot_info_t*)info_addr);
+    } else if (magic == MULTIBOOT2_BOOTLOADER_MAGIC) {
+        multiboot2_parse(info_addr);
+    }
+}
+
+int multiboot_is_valid(void) {
+    return boot_info_addr &&
+           (boot_magic == MULTIBOOT_BOOTLOADER_MAGIC || boot_magic == MULTIBOOT2_BOOTLOADER_MAGIC);
+}
+
+int multiboot_module_count(void) {
+    return module_count;
+}
+
+const multiboot_module_t *multiboot_get_module(int index) {
+    if (index < 0 || index >= module_count) return 0;
+    return &modules[index];
+}
+
+const multiboot_framebuffer_t *multiboot_get_framebuffer(void) {
+    return framebuffer_valid ? &framebuffer_info : 0;
+}
+
+uint32_t multiboot_memory_upper_kb(void) {
+    return memory_upper_kb;
+}
+
+uint32_t multiboot_reserved_end(void) {
+    return reserved_end;
+}
@@ -0,0 +1,134 @@
+// src/multiboot.h - Multiboot 1/2 boot information
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include <stdint.h>
+
+// Значения EAX, которые загрузчик передает ядру
+#define MULTIBOOT_BOOTLOADER_MAGIC  0x2BADB002
+#define MULTIBOOT2_BOOTLOADER_MAGIC 0x36D76289
+
+// Multiboot 1 info flags
+#define MULTIBOOT_INFO_MEMORY       0x00000001
+#define MULTIBOOT_INFO_MODS         0x00000008
+#define MULTIBOOT_INFO_FRAMEBUFFER  0x00001000
+
+// Multiboot 2 tag types
+#define MULTIBOOT2_TAG_END          0
+#define MULTIBOOT2_TAG_MODULE       3
+#define MULTIBOOT2_TAG_BASIC_MEMINFO 4
+#define MULTIBOOT2_TAG_FRAMEBUFFER  8
+
+// Framebuffer types (одинаковы для Multiboot 1 и 2)
+#define MULTIBOOT_FRAMEBUFFER_TYPE_INDEXED  0
+#define MULTIBOOT_FRAMEBUFFER_TYPE_RGB      1
+#define MULTIBOOT_FRAMEBUFFER_TYPE_EGA_TEXT 2
+
+#define MULTIBOOT_MAX_MODULES 8
+
+// Модуль, загруженный GRUB (`module`) или QEMU (`-initrd`)
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    const char *cmdline;
+} multiboot_module_t;
+
+// Видеорежим, установленный загрузчиком (только RGB-режимы)
+typedef struct {
+    uint64_t addr;
+    uint32_t pitch;          // Байт на строку
+    uint32_t width;
+    uint32_t height;
+    uint8_t  bpp;
+    uint8_t  red_pos, red_size;
+    uint8_t  green_pos, green_size;
+    uint8_t  blue_pos, blue_size;
+} multiboot_framebuffer_t;
+
+// Multiboot 1 information structure (только используемые поля)
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+    uint32_t drives_length;
+    uint32_t drives_addr;
+    uint32_t config_table;
+    uint32_t boot_loader_name;
+    uint32_t apm_table;
+    uint32_t vbe_control_info;
+    uint32_t vbe_mode_info;
+    uint16_t vbe_mode;
+    uint16_t vbe_interface_seg;
+    uint16_t vbe_interface_off;
+    uint16_t vbe_interface_len;
+    uint64_t framebuffer_addr;
+    uint32_t framebuffer_pitch;
+    uint32_t framebuffer_width;
+    uint32_t framebuffer_height;
+    uint8_t  framebuffer_bpp;
+    uint8_t  framebuffer_type;
+    uint8_t  color_info[6];
+} __attribute__((packed)) multiboot_info_t;
+
+// Multiboot 1 module entry
+typedef struct {
+    uint32_t mod_start;
+    uint32_t mod_end;
+    uint32_t cmdline;
+    uint32_t reserved;
+} __attribute__((packed)) multiboot_mod_entry_t;
+
+// Multiboot 2 generic tag header
+typedef struct {
+    uint32_t type;
+    uint32_t size;
+} __attribute__((packed)) multiboot2_tag_t;
+
+// Multiboot 2 module tag
+typedef struct {
+    uint32_t type;
+    uint32_t size;
+    uint32_t mod_start;
+    uint32_t mod_end;
+    char cmdline[];
+} __attribute__((packed)) multiboot2_tag_module_t;
+
+// Multiboot 2 basic memory information tag (в КБ)
+typedef struct {
+    uint32_t type;
+    uint32_t size;
+    uint32_t mem_lower;
+    uint32_t mem_upper;
+} __attribute__((packed)) multiboot2_tag_basic_meminfo_t;
+
+// Multiboot 2 framebuffer tag
+typedef struct {
+    uint32_t type;
+    uint32_t size;
+    uint64_t framebuffer_addr;
+    uint32_t framebuffer_pitch;
+    uint32_t framebuffer_width;
+    uint32_t framebuffer_height;
+    uint8_t  framebuffer_bpp;
+    uint8_t  framebuffer_type;
+    uint16_t reserved;
+    uint8_t  color_info[6];
+} __attribute__((packed)) multiboot2_tag_framebuffer_t;
+
+// Разбор информации загрузчика
+void multiboot_init(uint32_t magic, uint32_t info_addr);
+int multiboot_is_valid(void);
+int multiboot_module_count(void);
+const multiboot_module_t *multiboot_get_module(int index);
+const multiboot_framebuffer_t *multiboot_get_framebuffer(void);  // 0, если нет RGB-режима
+uint32_t multiboot_memory_upper_kb(void);  // Память выше 1 МБ в КБ, 0 если неизвестно
+uint32_t multiboot_reserved_end(void);     // Конец структуры info и модулей
+
+#endif
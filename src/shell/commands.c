@@ -2,6 +2,14 @@
 #include "../drivers/text_output.h"
 #include "../drivers/screen.h"
 #include "../fs/fat16.h"
+#include "../fs/block_queue.h"
+#include "../drivers/gpu.h"
+#include "../drivers/blit.h"
+#include "../drivers/glyph.h"
+#include "../drivers/raster.h"
+#include "../drivers/opengl.h"
+#include "../drivers/frame.h"
+#include "../lib/cpu.h"
 #include "../lib/string.h"
 #include "../drivers/keyboard/keyboard.h"
 #include "../game/snake/snake.h"
@@ -44,6 +52,16 @@ void cmd_help() {
     printf("  wifi connect name, and, password. - Connect to WiFi\n");
     printf("  wifi disconnect - Disconnect from WiFi\n");
     printf("  hexedit  - Hex editor with assembly support\n");
+    printf("  snapshot - Snapshot disk (snapshot drop - discard)\n");
+    printf("  rollback - Restore disk to snapshot\n");
+    printf("  diff-sectors - Sectors changed since snapshot\n");
+    printf("  iostat   - Block queue statistics (iostat reset)\n");
+    printf("  vmode    - Show or set video mode (vmode 800x600x32)\n");
+    printf("  blitbench - Fill/copy/blend kernel speed\n");
+    printf("  textbench - Text rendering speed\n");
+    printf("  rasterbench - Triangle fill speed\n");
+    printf("  gldemo   - Spinning cube through the software GL pipeline\n");
+    printf("  glbench  - GL vertex rate: immediate mode, buffers, display lists\n");
 }
 
 void cmd_clear() {
@@ -307,12 +325,14 @@ void cmd_shutdown() {
     printf("All data has been preserved.\n");
     printf("System is now safe to power off.\n");
     printf("Goodbye!\n");
+    frame_flush();
     
     // Задержка для отображения сообщения
     for (volatile int i = 0; i < 3000000; i++);
     
     // Упрощенный shutdown - просто останавливаем систему
     printf("System halted. Use Ctrl+Alt+Del to restart.\n");
+    frame_flush();
     
     // Бесконечный цикл с HLT
     while(1) {
@@ -320,6 +340,62 @@ void cmd_shutdown() {
     }
 }
 
+// ============================================================================
+// СНИМКИ ДИСКА
+// ============================================================================
+
+void cmd_snapshot(char *args) {
+    if (strcmp(args, "drop") == 0) {
+        disk_snapshot_drop();
+        printf("Snapshot dropped\n");
+        return;
+    }
+    
+    if (args[0] != '\0') {
+        printf("Usage: snapshot [drop]\n");
+        return;
+    }
+    
+    // Сначала сбрасываем отложенные изменения FAT, чтобы снимок был целостным
+    fat16_sync();
+    disk_snapshot_create();
+    printf("Snapshot created (%d bytes of metadata)\n", disk_snapshot_metadata_size());
+}
+
+void cmd_rollback() {
+    if (!disk_snapshot_active()) {
+        printf("No active snapshot\n");
+        return;
+    }
+    
+    int restored = disk_snapshot_rollback();
+    // FAT и корневой каталог кэшируются в памяти - перечитываем их
+    fat16_load_from_disk();
+    printf("Rolled back %d blocks (%d KB)\n", restored, restored * DISK_CHUNK_SIZE / 1024);
+}
+
+void cmd_diff_sectors() {
+    if (!disk_snapshot_active()) {
+        printf("No active snapshot\n");
+        return;
+    }
+    
+    fat16_sync();
+    printf("Sectors changed since snapshot:\n");
+    int sectors = disk_snapshot_diff();
+    printf("Total: %d sectors in %d copied blocks (%d bytes of metadata)\n",
+           sectors, disk_snapshot_changed_chunks(), disk_snapshot_metadata_size());
+}
+
+void cmd_iostat(char *args) {
+    if (strcmp(args, "reset") == 0) {
+        blk_reset_stats();
+        printf("Block queue statistics reset\n");
+        return;
+    }
+    blk_print_stats();
+}
+
 // ============================================================================
 // НОВЫЕ КОМАНДЫ - ДОБАВИТЬ ОТСЮДА ДО КОНЦА ФАЙЛА
 // ============================================================================
@@ -382,6 +458,11 @@ void cmd_info(char *filename) {
         }
         printf("\n");
         
+        const char *long_name = fat16_get_long_name(filename);
+        if (long_name) {
+            printf("Long name: %s\n", long_name);
+        }
+        
         printf("Size: %d bytes\n", info.file_size);
         printf("Cluster: %d\n", info.starting_cluster);
         printf("Attributes: 0x%02x\n", info.attributes);
@@ -697,6 +778,67 @@ void cmd_textmode(char *args) {
     printf("Теперь PureC OS работает только в графическом режиме.\n");
 }
 
+// Разбирает число и возвращает указатель на следующий символ
+static const char *parse_number(const char *s, int *value) {
+    *value = 0;
+    if (*s < '0' || *s > '9') return 0;
+    while (*s >= '0' && *s <= '9') {
+        *value = *value * 10 + (*s - '0');
+        s++;
+    }
+    return s;
+}
+
+void cmd_vmode(char *args) {
+    gpu_context_t *gpu = gpu_get_context();
+    
+    if (args[0] == '\0') {
+        printf("Video mode: %dx%dx%d, pitch %d, %d page(s)\n",
+               gpu->width, gpu->height, gpu->bpp, gpu->pitch, gpu->pages);
+        return;
+    }
+    
+    int width, height, bpp = gpu->bpp;
+    const char *p = parse_number(args, &width);
+    if (p && *p == 'x') p = parse_number(p + 1, &height);
+    else p = 0;
+    if (p && *p == 'x') p = parse_number(p + 1, &bpp);
+    
+    if (!p || *p != '\0') {
+        printf("Usage: vmode <width>x<height>[x<bpp>]\n");
+        return;
+    }
+    
+    if (!gpu_set_mode(width, height, bpp)) {
+        printf("Mode %dx%dx%d is not supported\n", width, height, bpp);
+        return;
+    }
+    
+    desktop_repaint_now();
+    printf("Video mode set to %dx%dx%d\n", width, height, bpp);
+}
+
+void cmd_blitbench() {
+    cpu_print_features();
+    blit_benchmark();
+}
+
+void cmd_textbench() {
+    glyph_benchmark();
+}
+
+void cmd_rasterbench() {
+    raster_benchmark();
+}
+
+void cmd_gldemo() {
+    opengl_demo();
+}
+
+void cmd_glbench() {
+    opengl_benchmark();
+}
+
 void cmd_desktop(char *args) {
     printf("Оконный интерфейс активен!\n");
     printf("Создано окно рабочего стола.\n");
@@ -1,6 +1,7 @@
 // shell.c - Graphics-based shell for framebuffer GUI
 #include "shell.h"
 #include "../drivers/screen.h"
+#include "../drivers/widget.h"
 #include "../drivers/keyboard/keyboard.h"
 #include "../lib/string.h"
 #include "../fs/fat16.h"
@@ -9,8 +10,7 @@
 // Global desktop reference
 static desktop_t* shell_desktop = 0;
 static window_t* shell_window = 0;
-static int shell_cursor_x = 20;
-static int shell_cursor_y = 50;
+static widget_t* shell_view = 0;
 
 // External function declarations
 extern char keyboard_getchar();
@@ -40,56 +40,33 @@ extern void cmd_edit(char *filename);
 extern void cmd_snake(char *args);
 extern void cmd_wifi(char *args);
 extern void cmd_tetris(char *args);
+extern void cmd_snapshot(char *args);
+extern void cmd_rollback();
+extern void cmd_diff_sectors();
+extern void cmd_iostat(char *args);
 
 extern void cmd_graphics(char *args);
 extern void cmd_textmode(char *args);
 extern void cmd_desktop(char *args);
 extern void cmd_hexedit(char *args);
+extern void cmd_vmode(char *args);
+extern void cmd_blitbench();
+extern void cmd_textbench();
+extern void cmd_rasterbench();
+extern void cmd_gldemo();
+extern void cmd_glbench();
 
 // Shell helper functions
 void shell_print(const char* text) {
-    if (shell_window) {
-        draw_string(shell_cursor_x, shell_cursor_y, text, COLOR_WHITE);
-        shell_cursor_y += 16; // Move to next line
-        
-        // Scroll if needed
-        if (shell_cursor_y > shell_window->height - 30) {
-            // Simple scroll: copy everything up by 16 pixels
-            for (int y = 50; y < shell_window->height - 16; y++) {
-                for (int x = 20; x < shell_window->width - 20; x++) {
-                    uint32_t pixel = framebuffer_get_pixel(shell_window->x + x, shell_window->y + y + 16);
-                    shell_window->buffer[y * shell_window->width + x] = pixel;
-                }
-            }
-            // Clear bottom line
-            for (int y = shell_window->height - 16; y < shell_window->height; y++) {
-                for (int x = 20; x < shell_window->width - 20; x++) {
-                    shell_window->buffer[y * shell_window->width + x] = COLOR_TRANSPARENT;
-                }
-            }
-            shell_cursor_y = shell_window->height - 16;
-            window_paint(shell_window);
-        }
-    }
+    widget_text_print(shell_view, text);
 }
 
 void shell_clear() {
-    if (shell_window) {
-        // Clear window content area
-        for (int y = 50; y < shell_window->height - 20; y++) {
-            for (int x = 20; x < shell_window->width - 20; x++) {
-                shell_window->buffer[y * shell_window->width + x] = COLOR_TRANSPARENT;
-            }
-        }
-        shell_cursor_x = 20;
-        shell_cursor_y = 50;
-        window_paint(shell_window);
-    }
+    widget_text_clear(shell_view);
 }
 
 void shell_prompt() {
-    shell_print("FAT16> ");
-    shell_cursor_x = 20 + 7 * 8; // Position after prompt
+    widget_text_write(shell_view, "FAT16> ", 7);
 }
 
 void execute_command(char *input) {
@@ -117,10 +94,23 @@ void execute_command(char *input) {
     else if (strcmp(input, "snake") == 0) cmd_snake("");
     else if (strncmp(input, "wifi ", 5) == 0) cmd_wifi(input + 5);
     else if (strcmp(input, "tetris") == 0) cmd_tetris("");
+    else if (strcmp(input, "snapshot") == 0) cmd_snapshot("");
+    else if (strncmp(input, "snapshot ", 9) == 0) cmd_snapshot(input + 9);
+    else if (strcmp(input, "rollback") == 0) cmd_rollback();
+    else if (strcmp(input, "diff-sectors") == 0) cmd_diff_sectors();
+    else if (strcmp(input, "iostat") == 0) cmd_iostat("");
+    else if (strncmp(input, "iostat ", 7) == 0) cmd_iostat(input + 7);
 
     else if (strcmp(input, "graphics") == 0) cmd_graphics("");
     else if (strcmp(input, "textmode") == 0) cmd_textmode("");
     else if (strcmp(input, "desktop") == 0) cmd_desktop("");
+    else if (strcmp(input, "vmode") == 0) cmd_vmode("");
+    else if (strncmp(input, "vmode ", 6) == 0) cmd_vmode(input + 6);
+    else if (strcmp(input, "blitbench") == 0) cmd_blitbench();
+    else if (strcmp(input, "textbench") == 0) cmd_textbench();
+    else if (strcmp(input, "rasterbench") == 0) cmd_rasterbench();
+    else if (strcmp(input, "gldemo") == 0) cmd_gldemo();
+    else if (strcmp(input, "glbench") == 0) cmd_glbench();
     else if (strncmp(input, "hexedit", 7) == 0) {
         if (input[7] == ' ') {
             cmd_hexedit(input + 8);
@@ -129,7 +119,7 @@ void execute_command(char *input) {
         }
     }
     else if (input[0] != '\0') {
-        shell_print("Unknown command: ");
+        widget_text_write(shell_view, "Unknown command: ", 17);
         shell_print(input);
     }
 }
@@ -147,12 +137,16 @@ void init_shell() {
         return;
     }
     
-    // Show welcome message
-    draw_string(20, 30, "MyOS Shell - Graphics Mode", COLOR_WHITE);
-    draw_string(20, 40, "================================", COLOR_WHITE);
+    // Header labels above the scrolling text view
+    widget_create_label(shell_window, 20, 30, shell_window->width - 40, 8,
+                        "MyOS Shell - Graphics Mode", COLOR_BLACK, COLOR_LIGHT_GRAY);
+    widget_create_label(shell_window, 20, 40, shell_window->width - 40, 8,
+                        "================================", COLOR_BLACK, COLOR_LIGHT_GRAY);
+    shell_view = widget_create_text_view(shell_window, 20, 50, shell_window->width - 40,
+                                         shell_window->height - 70, COLOR_WHITE, COLOR_BLACK);
     shell_prompt();
     
-    window_paint(shell_window);
+    widget_flush();
 }
 
 void shell_run() {
@@ -164,22 +158,19 @@ void shell_run() {
         if (key) {
             if (key == '\n') {
                 input_buffer[input_pos] = '\0';
-                shell_cursor_x = 20;
-                shell_print(""); // New line
+                widget_text_write(shell_view, "\n", 1);
                 execute_command(input_buffer);
                 input_pos = 0;
                 shell_prompt();
             } else if (key == '\b' && input_pos > 0) {
                 input_pos--;
-                // Simple backspace - redraw line
-                shell_cursor_x = 20 + 7 * 8 + input_pos * 8;
-                draw_char(shell_cursor_x, shell_cursor_y, ' ', COLOR_WHITE);
+                widget_text_write(shell_view, "\b", 1);
             } else if (key >= 32 && key <= 126 && input_pos < 255) {
                 input_buffer[input_pos++] = key;
-                draw_char(shell_cursor_x, shell_cursor_y, key, COLOR_WHITE);
-                shell_cursor_x += 8;
+                widget_text_write(shell_view, &key, 1);
             }
-            window_paint(shell_window);
+            // Only the cells that changed reach the screen
+            widget_flush();
         }
     }
 }
\ No newline at end of file
@@ -35,11 +35,21 @@ void cmd_space();
 void cmd_edit(char *filename);
 void cmd_snake(char *args);
 void cmd_tetris(char *args);
+void cmd_snapshot(char *args);
+void cmd_rollback();
+void cmd_diff_sectors();
+void cmd_iostat(char *args);
 
 void cmd_wifi(char *args);
 void cmd_graphics(char *args);
 void cmd_textmode(char *args);
 void cmd_desktop(char *args);
 void cmd_hexedit(char *args);
+void cmd_vmode(char *args);
+void cmd_blitbench();
+void cmd_textbench();
+void cmd_rasterbench();
+void cmd_gldemo();
+void cmd_glbench();
 
 #endif
\ No newline at end of file
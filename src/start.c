@@ -12,7 +12,7 @@ __attribute__((externally_visible))  // Делаем видимым для ли
 // Multiboot2 заголовок для UEFI
 #define MULTIBOOT2_HEADER_MAGIC 0xe85250d6
 #define MULTIBOOT2_HEADER_ARCHITECTURE 0  // i386
-#define MULTIBOOT2_HEADER_LENGTH 32  // Длина с консольным тегом
+#define MULTIBOOT2_HEADER_LENGTH 64  // Длина с консольным тегом и тегом framebuffer
 #define MULTIBOOT2_HEADER_CHECKSUM -(MULTIBOOT2_HEADER_MAGIC + MULTIBOOT2_HEADER_ARCHITECTURE + MULTIBOOT2_HEADER_LENGTH)
 
 // Multiboot заголовок - byte-packed
@@ -43,12 +43,20 @@ const unsigned char multiboot2_header[] = {
     // Header
     0xd6, 0x50, 0x52, 0xe8, // magic (0xe85250d6)
     0x00, 0x00, 0x00, 0x00, // architecture (0)
-    0x20, 0x00, 0x00, 0x00, // header_length (32)
-    0x2a, 0xaf, 0xad, 0x17, // checksum (-(magic+arch+length))
+    0x40, 0x00, 0x00, 0x00, // header_length (64)
+    0xea, 0xae, 0xad, 0x17, // checksum (-(magic+arch+length))
     // Console tag (type 2, size 12, flags 3)
     0x02, 0x00, 0x00, 0x00, // tag_type = 2
     0x0c, 0x00, 0x00, 0x00, // tag_size = 12
     0x03, 0x00, 0x00, 0x00, // flags = 3
+    0x00, 0x00, 0x00, 0x00, // padding (теги выровнены на 8)
+    // Framebuffer tag (type 5, optional, size 20): 1024x768x32
+    0x05, 0x00, 0x01, 0x00, // tag_type = 5, flags = optional
+    0x14, 0x00, 0x00, 0x00, // tag_size = 20
+    0x00, 0x04, 0x00, 0x00, // width (1024)
+    0x00, 0x03, 0x00, 0x00, // height (768)
+    0x20, 0x00, 0x00, 0x00, // depth (32)
+    0x00, 0x00, 0x00, 0x00, // padding
     // End tag (type 0, size 8)
     0x00, 0x00, 0x00, 0x00, // tag_type = 0
     0x08, 0x00, 0x00, 0x00  // tag_size = 8
@@ -56,7 +64,7 @@ const unsigned char multiboot2_header[] = {
 
 // Точка входа для ядра ОС
 
-extern void kernel_main(void);
+extern void kernel_main(unsigned int magic, unsigned int multiboot_info);
 
 // Функция _start - точка входа, требуемая линковщиком
 void _start(void) {
@@ -67,13 +75,13 @@ void _start(void) {
         "movl $0x100000, %esp\n"  // Устанавливаем стек
         "movl %esp, %ebp\n"        // Устанавливаем базовый указатель стека
         "pushl $0\n"               // Выравнивание стека
-        "pushl %ebx\n"              // Сохраняем Multiboot magic
-        "pushl %eax\n"              // Сохраняем Multiboot info
+        "pushl %ebx\n"              // Адрес Multiboot info (2-й аргумент)
+        "pushl %eax\n"              // Multiboot magic (1-й аргумент)
+        // Вызываем основную функцию ядра прямо отсюда, чтобы компилятор
+        // не трогал подготовленный стек с аргументами
+        "call kernel_main\n"
     );
     
-    // Вызываем основную функцию ядра
-    kernel_main();
-    
     // Бесконечный цикл после завершения kernel_main
     while(1) {
         // Остановка процессора
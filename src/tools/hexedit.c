@@ -15,9 +15,17 @@ void clear_screen(void);
 
 static unsigned char hex_buffer[HEXEDIT_BUFFER_SIZE];
 static unsigned int buffer_size = 0;
+
+// Existing files are edited in place through the FAT16 page cache;
+// hex_buffer holds new files and files the cache cannot map (volumes
+// whose clusters are not FAT16_PAGE_SIZE)
+static file_t *mapped_file = 0;
+static unsigned char *mapped_page = 0;
+static unsigned int mapped_page_index = 0;
+static int mapped_page_dirty = 0;
 static unsigned int cursor_pos = 0;
 static unsigned int file_offset = 0;
-static char filename[32] = "";
+static char filename[FAT16_MAX_NAME + 1] = "";
 static int modified = 0;
 static int mode = 0; // 0=hex, 1=ascii, 2=assembly
 
@@ -38,6 +46,74 @@ static asm_instruction_t asm_table[] = {
     {0xA0, "MOV AL,[", 3}, {0xA2, "MOV [,AL", 3}, {0xF4, "HLT", 1}
 };
 
+// Long file names are up to FAT16_MAX_NAME bytes; longer ones are rejected
+static int hexedit_set_filename(const char *name) {
+    if (strlen(name) > FAT16_MAX_NAME) {
+        printf("Error: File name longer than %d bytes\n", FAT16_MAX_NAME);
+        return 0;
+    }
+    strcpy(filename, name);
+    return 1;
+}
+
+static void hexedit_unmap_page() {
+    if (mapped_page) {
+        fat16_unmap(mapped_file, mapped_page, mapped_page_dirty);
+        mapped_page = 0;
+        mapped_page_dirty = 0;
+    }
+}
+
+static unsigned int hexedit_capacity() {
+    return mapped_file ? buffer_size : HEXEDIT_BUFFER_SIZE;
+}
+
+// Returns the byte at pos, mapping its page on demand (0 if out of range)
+static unsigned char *hexedit_byte(unsigned int pos) {
+    if (pos >= hexedit_capacity()) return 0;
+    if (!mapped_file) return &hex_buffer[pos];
+
+    unsigned int index = pos / FAT16_PAGE_SIZE;
+    if (!mapped_page || index != mapped_page_index) {
+        hexedit_unmap_page();
+
+        unsigned int page_start = index * FAT16_PAGE_SIZE;
+        unsigned int length = buffer_size - page_start;
+        if (length > FAT16_PAGE_SIZE) length = FAT16_PAGE_SIZE;
+
+        mapped_page = fat16_map(mapped_file, page_start, length);
+        if (!mapped_page) return 0;
+        mapped_page_index = index;
+    }
+
+    return mapped_page + pos % FAT16_PAGE_SIZE;
+}
+
+static unsigned char hex_get(unsigned int pos) {
+    unsigned char *byte = hexedit_byte(pos);
+    return byte ? *byte : 0;
+}
+
+static void hex_set(unsigned int pos, unsigned char value) {
+    unsigned char *byte = hexedit_byte(pos);
+    if (!byte) return;
+
+    *byte = value;
+    if (mapped_file) mapped_page_dirty = 1;
+}
+
+// Drops the mapping; unsaved page-cache edits are discarded
+static void hexedit_release_file() {
+    if (!mapped_file) return;
+
+    hexedit_unmap_page();
+    if (modified) {
+        fat16_discard_pages(mapped_file);
+    }
+    fat16_close(mapped_file);
+    mapped_file = 0;
+}
+
 void hexedit_display_help() {
     printf("=== Hex Editor Commands ===\n");
     printf("F1 - Help\n");
@@ -100,9 +176,9 @@ void hexedit_display_hex_line(int line) {
             printf("   ");
         } else {
             if (pos == cursor_pos) {
-                printf("[%02X", hex_buffer[pos]);
+                printf("[%02X", hex_get(pos));
             } else {
-                printf(" %02X", hex_buffer[pos]);
+                printf(" %02X", hex_get(pos));
             }
         }
     }
@@ -115,7 +191,7 @@ void hexedit_display_hex_line(int line) {
         if (pos >= buffer_size) {
             printf(" ");
         } else {
-            unsigned char c = hex_buffer[pos];
+            unsigned char c = hex_get(pos);
             if (c >= 32 && c < 127) {
                 if (pos == cursor_pos) {
                     printf("[%c", c);
@@ -146,7 +222,7 @@ void hexedit_display_assembly_line(int line) {
     
     while (instructions_displayed < 8 && current_offset < buffer_size) {
         // Simple disassembly
-        unsigned char opcode = hex_buffer[current_offset];
+        unsigned char opcode = hex_get(current_offset);
         const char *mnemonic = "DB";
         int length = 1;
         
@@ -165,9 +241,9 @@ void hexedit_display_assembly_line(int line) {
         // Display operands for multi-byte instructions
         if (length > 1 && current_offset + 1 < buffer_size) {
             if (length == 2) {
-                printf(" %02X", hex_buffer[current_offset + 1]);
+                printf(" %02X", hex_get(current_offset + 1));
             } else if (length == 3 && current_offset + 2 < buffer_size) {
-                unsigned short word = (hex_buffer[current_offset + 2] << 8) | hex_buffer[current_offset + 1];
+                unsigned short word = (hex_get(current_offset + 2) << 8) | hex_get(current_offset + 1);
                 printf(" %04X", word);
             }
         }
@@ -206,6 +282,8 @@ int hexedit_load_file(const char *name) {
         return 1;
     }
     
+    if (!hexedit_set_filename(name)) return 0;
+    
     file_t *file = fat16_open(name, 0);
     if (!file) {
         printf("Error: Cannot open file %s\n", name);
@@ -213,28 +291,53 @@ int hexedit_load_file(const char *name) {
     }
     
     buffer_size = file->size;
+    
+    if (buffer_size == 0) {
+        fat16_close(file);
+        printf("Loaded %s (empty)\n", filename);
+        return 1;
+    }
+    
+    // No copy: pages are read from disk as the editor touches them
+    unsigned int probe_length = buffer_size < FAT16_PAGE_SIZE ? buffer_size : FAT16_PAGE_SIZE;
+    unsigned char *probe = fat16_map(file, 0, probe_length);
+    if (probe) {
+        fat16_unmap(file, probe, 0);
+        mapped_file = file;
+        printf("Mapped %s (%d bytes)\n", filename, buffer_size);
+        return 1;
+    }
+    
+    // Mapping unavailable: copy the file as before
     if (buffer_size > HEXEDIT_BUFFER_SIZE) {
         buffer_size = HEXEDIT_BUFFER_SIZE;
         printf("Warning: File truncated to %d bytes\n", HEXEDIT_BUFFER_SIZE);
     }
     
     int bytes_read = fat16_read(file, (char*)hex_buffer, buffer_size);
+    fat16_close(file);
     if (bytes_read != buffer_size) {
         printf("Error reading file\n");
-        fat16_close(file);
         return 0;
     }
     
-    strcpy(filename, name);
-    fat16_close(file);
     printf("Loaded %s (%d bytes)\n", filename, buffer_size);
     return 1;
 }
 
 int hexedit_save_file() {
+    if (mapped_file) {
+        // Write back only the pages that were patched
+        hexedit_unmap_page();
+        fat16_msync(mapped_file);
+        modified = 0;
+        printf("Saved %s (%d bytes)\n", filename, buffer_size);
+        return 1;
+    }
+    
     if (filename[0] == '\0') {
         printf("Enter filename: ");
-        char newname[32];
+        char newname[FAT16_MAX_NAME + 1];
         readline(newname, sizeof(newname));
         
         if (newname[0] == '\0') {
@@ -324,7 +427,7 @@ void hexedit_find_bytes() {
     for (unsigned int i = cursor_pos + 1; i <= buffer_size - search_len; i++) {
         int found = 1;
         for (int j = 0; j < search_len; j++) {
-            if (hex_buffer[i + j] != search_bytes[j]) {
+            if (hex_get(i + j) != search_bytes[j]) {
                 found = 0;
                 break;
             }
@@ -349,15 +452,15 @@ void hexedit_assemble_code() {
     
     // Simple assembler
     if (strncmp(input, "NOP", 3) == 0) {
-        hex_buffer[cursor_pos++] = 0x90;
+        hex_set(cursor_pos++, 0x90);
         modified = 1;
     }
     else if (strncmp(input, "RET", 3) == 0) {
-        hex_buffer[cursor_pos++] = 0xC3;
+        hex_set(cursor_pos++, 0xC3);
         modified = 1;
     }
     else if (strncmp(input, "HLT", 3) == 0) {
-        hex_buffer[cursor_pos++] = 0xF4;
+        hex_set(cursor_pos++, 0xF4);
         modified = 1;
     }
     else if (strncmp(input, "INT", 3) == 0) {
@@ -373,8 +476,8 @@ void hexedit_assemble_code() {
             }
         }
         
-        hex_buffer[cursor_pos++] = 0xCD;
-        hex_buffer[cursor_pos++] = int_num;
+        hex_set(cursor_pos++, 0xCD);
+        hex_set(cursor_pos++, int_num);
         modified = 1;
     }
     else if (strncmp(input, "MOV AX,", 7) == 0) {
@@ -389,9 +492,9 @@ void hexedit_assemble_code() {
             else if (param[i] >= 'a' && param[i] <= 'f') value |= param[i] - 'a' + 10;
         }
         
-        hex_buffer[cursor_pos++] = 0xB8;
-        hex_buffer[cursor_pos++] = value & 0xFF;
-        hex_buffer[cursor_pos++] = (value >> 8) & 0xFF;
+        hex_set(cursor_pos++, 0xB8);
+        hex_set(cursor_pos++, value & 0xFF);
+        hex_set(cursor_pos++, (value >> 8) & 0xFF);
         modified = 1;
     }
     else {
@@ -413,7 +516,7 @@ void hexedit_fill_pattern() {
         else if (c >= 'a' && c <= 'f') end_offset += c - 'a' + 10;
     }
     
-    if (end_offset <= cursor_pos || end_offset >= HEXEDIT_BUFFER_SIZE) {
+    if (end_offset <= cursor_pos || end_offset >= hexedit_capacity()) {
         printf("Invalid range\n");
         return;
     }
@@ -430,8 +533,8 @@ void hexedit_fill_pattern() {
     else if (input[1] >= 'A' && input[1] <= 'F') fill_byte |= input[1] - 'A' + 10;
     else if (input[1] >= 'a' && input[1] <= 'f') fill_byte |= input[1] - 'a' + 10;
     
-    for (unsigned int i = cursor_pos; i <= end_offset && i < HEXEDIT_BUFFER_SIZE; i++) {
-        hex_buffer[i] = fill_byte;
+    for (unsigned int i = cursor_pos; i <= end_offset && i < hexedit_capacity(); i++) {
+        hex_set(i, fill_byte);
     }
     
     if (end_offset >= buffer_size) {
@@ -521,7 +624,7 @@ void hexedit_handle_input() {
                 
             case 's': // Down  
             case 'S':
-                if (cursor_pos + BYTES_PER_LINE < HEXEDIT_BUFFER_SIZE) {
+                if (cursor_pos + BYTES_PER_LINE < hexedit_capacity()) {
                     cursor_pos += BYTES_PER_LINE;
                     if (cursor_pos >= file_offset + (DISPLAY_LINES * BYTES_PER_LINE)) {
                         file_offset += BYTES_PER_LINE;
@@ -549,15 +652,15 @@ void hexedit_handle_input() {
                         // Toggle between high and low nibble
                         static int high_nibble = 1;
                         if (high_nibble) {
-                            hex_buffer[cursor_pos] = nibble << 4;
+                            hex_set(cursor_pos, nibble << 4);
                         } else {
-                            hex_buffer[cursor_pos] |= nibble;
+                            hex_set(cursor_pos, hex_get(cursor_pos) | nibble);
                             if (cursor_pos < buffer_size - 1) cursor_pos++;
                         }
                         high_nibble = !high_nibble;
                         modified = 1;
                     } else if (mode == 1) { // ASCII mode
-                        hex_buffer[cursor_pos] = c;
+                        hex_set(cursor_pos, c);
                         if (cursor_pos < buffer_size - 1) cursor_pos++;
                         modified = 1;
                     }
@@ -572,9 +675,9 @@ void cmd_hexedit(char *args) {
     printf("Machine Code & Assembly Editor\n");
     
     if (args[0] != '\0') {
+        if (!hexedit_set_filename(args)) return;
         if (!hexedit_load_file(args)) {
             printf("Creating new file: %s\n", args);
-            strcpy(filename, args);
             buffer_size = 0;
         }
     } else {
@@ -589,5 +692,6 @@ void cmd_hexedit(char *args) {
     mode = 0;
     
     hexedit_handle_input();
+    hexedit_release_file();
     printf("Hex editor closed\n");
 }
\ No newline at end of file